@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tweets_corpus.h"
+#include "markov_io.h"
+
+#define NUM_ARGS_ERROR "Usage: chain_merge [-z | -m <megabytes>] <output_chain> <input>..."
+#define FILE_PATH_ERROR "Error: incorrect file path"
+
+/**
+ * Merge one input into the chain: chain files are loaded, anything else is
+ * read as a text corpus and trained on.
+ * @param path input file path
+ * @param markov_chain chain to merge into
+ * @param index_ptr index of the chain's states, kept up to date
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int merge_input(const char *path, MarkovChain *markov_chain, StateIndex **index_ptr) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stdout, "%s: %s\n", FILE_PATH_ERROR, path);
+        return EXIT_FAILURE;
+    }
+
+    int result;
+    if (is_chain_file(fp)) {
+        result = load_chain(markov_chain, *index_ptr, fp, read_string);
+    } else {
+        // Training adds states behind the index's back, index them afterwards
+        result = fill_database(fp, -1, markov_chain);
+        free_state_index(index_ptr);
+        *index_ptr = build_state_index(markov_chain, hash_string);
+        if (*index_ptr == NULL) {
+            result = 1;
+        }
+    }
+    fclose(fp);
+
+    if (result != 0) {
+        fprintf(stdout, "Error: could not merge %s\n", path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Build the chain of text corpora too large for RAM: the inputs are
+ * streamed into an external build, which keeps only the vocabulary in
+ * memory and spills the transitions to sorted run files in the system
+ * temporary directory. The output is what the in-memory merge writes.
+ * @param output output chain file path
+ * @param inputs text corpora, in order
+ * @param num_inputs number of corpora
+ * @param memory_budget bytes of transition buffering
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int merge_external(const char *output, char *inputs[], int num_inputs,
+                          size_t memory_budget) {
+    MarkovChain *markov_chain = create_tweets_chain();
+    ExternalBuilder *builder = NULL;
+    if (markov_chain == NULL ||
+        (builder = create_external_builder(markov_chain, hash_string, memory_budget,
+                                           NULL)) == NULL) {
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < num_inputs; i++) {
+        FILE *fp = fopen(inputs[i], "rb");
+        if (fp == NULL) {
+            fprintf(stdout, "%s: %s\n", FILE_PATH_ERROR, inputs[i]);
+            free_external_builder(&builder);
+            free_database(&markov_chain);
+            return EXIT_FAILURE;
+        }
+        // Chain files would have to be loaded into memory whole
+        int result = is_chain_file(fp) ? 1 : fill_external(fp, -1, builder);
+        fclose(fp);
+        if (result != 0) {
+            fprintf(stdout, "Error: could not merge %s\n", inputs[i]);
+            free_external_builder(&builder);
+            free_database(&markov_chain);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *out = fopen(output, "wb");
+    if (out == NULL) {
+        fprintf(stdout, "%s: %s\n", FILE_PATH_ERROR, output);
+        free_external_builder(&builder);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+    int result = external_write_chain(builder, out, write_string);
+    free_external_builder(&builder);
+    free_database(&markov_chain);
+    if (fclose(out) != 0 || result != 0) {
+        fprintf(stdout, "Error: could not write %s\n", output);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Merge trained chains (and/or raw corpus parts) into one chain file.
+ * Inputs are merged in the given order, so merging the chains of
+ * consecutive corpus parts gives the chain of the whole corpus.
+ * @param argc num of arguments
+ * @param argv 1) Optional -z, write the compact format, or -m and a memory
+ *                budget in megabytes, build externally from text corpora
+ *             2) Output chain file
+ *             3...) Input chain files (either format) or text corpora
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char *argv[]) {
+    bool compressed = argc >= 2 && strcmp(argv[1], "-z") == 0;
+    if (compressed) {
+        argc--;
+        argv++;
+    }
+    long megabytes = 0;
+    if (argc >= 2 && strcmp(argv[1], "-m") == 0) {
+        // The external build only writes the plain format
+        if (compressed || argc < 3) {
+            fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+            return EXIT_FAILURE;
+        }
+        char *end;
+        megabytes = strtol(argv[2], &end, 10);
+        if (*end != '\0' || megabytes <= 0) {
+            fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+            return EXIT_FAILURE;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 3) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+    if (megabytes > 0) {
+        return merge_external(argv[1], argv + 2, argc - 2, (size_t)megabytes << 20);
+    }
+
+    MarkovChain *markov_chain = create_tweets_chain();
+    if (markov_chain == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return EXIT_FAILURE;
+    }
+    StateIndex *index = build_state_index(markov_chain, hash_string);
+    if (index == NULL) {
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (merge_input(argv[i], markov_chain, &index) != EXIT_SUCCESS) {
+            free_state_index(&index);
+            free_database(&markov_chain);
+            return EXIT_FAILURE;
+        }
+    }
+    free_state_index(&index);
+
+    FILE *out = fopen(argv[1], "wb");
+    if (out == NULL) {
+        fprintf(stdout, "%s: %s\n", FILE_PATH_ERROR, argv[1]);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+    int result = compressed ? save_chain_compressed(markov_chain, out, write_string)
+                            : save_chain(markov_chain, out, write_string);
+    if (fclose(out) != 0 || result != 0) {
+        fprintf(stdout, "Error: could not write %s\n", argv[1]);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    free_database(&markov_chain);
+    return EXIT_SUCCESS;
+}
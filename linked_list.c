@@ -7,19 +7,49 @@ int add(LinkedList *link_list, void *data)
     {
         return 1;
     }
-    *new_node = (Node) {data, NULL};
+    new_node->data = data;
+    append_node(link_list, new_node);
+    return 0;
+}
 
+void append_node(LinkedList *link_list, Node *node)
+{
+    node->next = NULL;
     if (link_list->first == NULL)
     {
-        link_list->first = new_node;
-        link_list->last = new_node;
+        link_list->first = node;
+        link_list->last = node;
     }
     else
     {
-        link_list->last->next = new_node;
-        link_list->last = new_node;
+        link_list->last->next = node;
+        link_list->last = node;
     }
 
     link_list->size++;
-    return 0;
+}
+
+Node *unlink_after(LinkedList *link_list, Node *previous)
+{
+    Node *removed = previous != NULL ? previous->next : link_list->first;
+    if (removed == NULL)
+    {
+        return NULL;
+    }
+
+    if (previous != NULL)
+    {
+        previous->next = removed->next;
+    }
+    else
+    {
+        link_list->first = removed->next;
+    }
+    if (link_list->last == removed)
+    {
+        link_list->last = previous;
+    }
+
+    link_list->size--;
+    return removed;
 }
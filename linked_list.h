@@ -21,4 +21,20 @@ typedef struct LinkedList {
  */
 int add (LinkedList *link_list, void *data);
 
+/**
+ * Link an already allocated node at the end of the given link list.
+ * @param link_list Link list to add to
+ * @param node node to link, its data set by the caller
+ */
+void append_node (LinkedList *link_list, Node *node);
+
+/**
+ * Unlink the node that follows previous in the given link list, leaving it
+ * to the caller to free.
+ * @param link_list Link list to remove from
+ * @param previous node before the one to remove, NULL to remove the first
+ * @return the removed node, NULL if there is no such node
+ */
+Node *unlink_after (LinkedList *link_list, Node *previous);
+
 #endif //_LINKEDLIST_H_
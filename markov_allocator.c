@@ -0,0 +1,176 @@
+#include "markov_allocator.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Prefix of every markov_data_alloc() block: where it came from and its
+ * full size, padded so the data after it stays aligned for any type.
+ */
+typedef union DataHeader {
+    struct {
+        ChainAllocator *allocator;
+        size_t size;
+    } block;
+    long double align_float;
+    uint64_t align_integer;
+    void *align_pointer;
+} DataHeader;
+
+// Allocator markov_data_alloc() draws from, set around copy_func calls
+static __thread ChainAllocator *data_allocator = NULL;
+
+/**
+ * Default allocation callback, malloc().
+ */
+static void *default_alloc(void *context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+/**
+ * Default resize callback, realloc().
+ */
+static void *default_realloc(void *context, void *ptr, size_t old_size, size_t new_size) {
+    (void)context;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+/**
+ * Default release callback, free().
+ */
+static void default_dealloc(void *context, void *ptr, size_t size) {
+    (void)context;
+    (void)size;
+    free(ptr);
+}
+
+void init_chain_allocator(ChainAllocator *allocator, alloc_func alloc_func,
+                          realloc_func realloc_func, dealloc_func dealloc_func,
+                          void *context) {
+    *allocator = (ChainAllocator) {0};
+    if (alloc_func == NULL) {
+        allocator->alloc_func = default_alloc;
+        allocator->realloc_func = default_realloc;
+        allocator->dealloc_func = default_dealloc;
+        return;
+    }
+    allocator->alloc_func = alloc_func;
+    allocator->realloc_func = realloc_func;
+    allocator->dealloc_func = dealloc_func;
+    allocator->context = context;
+}
+
+/**
+ * Check that growing by the given bytes stays under the limit.
+ * @param allocator allocator to check
+ * @param growth additional bytes
+ * @return 0 if allowed, 1 otherwise (counted as a failure)
+ */
+static int check_limit(ChainAllocator *allocator, size_t growth) {
+    if (allocator->limit != 0 && (growth > allocator->limit ||
+                                  allocator->total_live_bytes > allocator->limit - growth)) {
+        allocator->failures++;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Count allocated bytes and update the peaks.
+ */
+static void count_growth(ChainAllocator *allocator, MemoryCategory category, size_t growth) {
+    allocator->live_bytes[category] += growth;
+    if (allocator->live_bytes[category] > allocator->peak_bytes[category]) {
+        allocator->peak_bytes[category] = allocator->live_bytes[category];
+    }
+    allocator->total_live_bytes += growth;
+    if (allocator->total_live_bytes > allocator->total_peak_bytes) {
+        allocator->total_peak_bytes = allocator->total_live_bytes;
+    }
+}
+
+/**
+ * Count released bytes.
+ */
+static void count_release(ChainAllocator *allocator, MemoryCategory category, size_t size) {
+    allocator->live_bytes[category] -= size;
+    allocator->total_live_bytes -= size;
+}
+
+void *chain_alloc(ChainAllocator *allocator, MemoryCategory category, size_t size) {
+    if (size == 0 || check_limit(allocator, size) != 0) {
+        return NULL;
+    }
+    void *ptr = allocator->alloc_func(allocator->context, size);
+    if (ptr == NULL) {
+        allocator->failures++;
+        return NULL;
+    }
+    count_growth(allocator, category, size);
+    return ptr;
+}
+
+void *chain_realloc(ChainAllocator *allocator, MemoryCategory category, void *ptr,
+                    size_t old_size, size_t new_size) {
+    if (new_size == 0) {
+        return NULL;
+    }
+    if (new_size > old_size && check_limit(allocator, new_size - old_size) != 0) {
+        return NULL;
+    }
+    void *resized = allocator->realloc_func(allocator->context, ptr, old_size, new_size);
+    if (resized == NULL) {
+        allocator->failures++;
+        return NULL;
+    }
+    if (new_size > old_size) {
+        count_growth(allocator, category, new_size - old_size);
+    } else {
+        count_release(allocator, category, old_size - new_size);
+    }
+    return resized;
+}
+
+void chain_free(ChainAllocator *allocator, MemoryCategory category, void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    allocator->dealloc_func(allocator->context, ptr, size);
+    count_release(allocator, category, size);
+}
+
+ChainAllocator *swap_data_allocator(ChainAllocator *allocator) {
+    ChainAllocator *previous = data_allocator;
+    data_allocator = allocator;
+    return previous;
+}
+
+void *markov_data_alloc(size_t size) {
+    if (size > SIZE_MAX - sizeof(DataHeader)) {
+        return NULL;
+    }
+    size_t full_size = sizeof(DataHeader) + size;
+    DataHeader *header = data_allocator != NULL
+                         ? chain_alloc(data_allocator, MEMORY_DATA, full_size)
+                         : malloc(full_size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->block.allocator = data_allocator;
+    header->block.size = full_size;
+    return header + 1;
+}
+
+void markov_data_free(void *data) {
+    if (data == NULL) {
+        return;
+    }
+    DataHeader *header = (DataHeader *)data - 1;
+    if (header->block.allocator != NULL) {
+        chain_free(header->block.allocator, MEMORY_DATA, header, header->block.size);
+    } else {
+        free(header);
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef _MARKOV_ALLOCATOR_H
+#define _MARKOV_ALLOCATOR_H
+
+#include <stddef.h> // for size_t
+
+/**
+ * What a chain's memory is spent on, counted separately.
+ */
+typedef enum MemoryCategory {
+    // MarkovNode structs and the database links holding them
+    MEMORY_NODES,
+    // successor lists and their counters
+    MEMORY_EDGES,
+    // state copies made with markov_data_alloc()
+    MEMORY_DATA,
+    NUM_MEMORY_CATEGORIES
+} MemoryCategory;
+
+/**
+ * Function pointer type for allocating memory
+ * @param context the allocator's context pointer
+ * @param size number of bytes, positive
+ * @return the memory, NULL on failure
+ */
+typedef void *(*alloc_func)(void *context, size_t size);
+
+/**
+ * Function pointer type for resizing memory, like realloc()
+ * @param context the allocator's context pointer
+ * @param ptr memory to resize, NULL to allocate
+ * @param old_size current size of ptr, 0 if ptr is NULL
+ * @param new_size number of bytes wanted, positive
+ * @return the memory, possibly moved; NULL on failure, ptr being left as is.
+ * Shrinking must not fail.
+ */
+typedef void *(*realloc_func)(void *context, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * Function pointer type for releasing memory
+ * @param context the allocator's context pointer
+ * @param ptr memory to release, never NULL
+ * @param size its size, as last allocated or resized
+ */
+typedef void (*dealloc_func)(void *context, void *ptr, size_t size);
+
+/**
+ * Allocation callbacks of one chain and the accounting of what went through
+ * them. Every request is checked against limit before reaching the
+ * callbacks, so a capped chain fails its allocations cleanly, like a
+ * failing malloc(), instead of running the process out of memory.
+ */
+typedef struct ChainAllocator {
+    alloc_func alloc_func;
+    realloc_func realloc_func;
+    dealloc_func dealloc_func;
+    void *context;
+    // bytes currently allocated, and the most ever at once, per category
+    size_t live_bytes[NUM_MEMORY_CATEGORIES];
+    size_t peak_bytes[NUM_MEMORY_CATEGORIES];
+    // the same over all categories
+    size_t total_live_bytes;
+    size_t total_peak_bytes;
+    // cap on total_live_bytes, 0 for none; may be changed at any time
+    size_t limit;
+    // requests refused by the cap or failed by the callbacks
+    size_t failures;
+} ChainAllocator;
+
+/**
+ * Set up an allocator with the given callbacks and empty accounting.
+ * @param allocator allocator to set up
+ * @param alloc_func how to allocate, NULL for malloc() (then all three
+ * callbacks must be NULL)
+ * @param realloc_func how to resize
+ * @param dealloc_func how to release
+ * @param context passed to every callback
+ */
+void init_chain_allocator(ChainAllocator *allocator, alloc_func alloc_func,
+                          realloc_func realloc_func, dealloc_func dealloc_func,
+                          void *context);
+
+/**
+ * Allocate memory of a category.
+ * @param allocator allocator to use
+ * @param category what the memory is for
+ * @param size number of bytes, positive
+ * @return the memory, NULL if over the limit or the callback failed
+ */
+void *chain_alloc(ChainAllocator *allocator, MemoryCategory category, size_t size);
+
+/**
+ * Resize memory of a category, like realloc().
+ * @param allocator allocator the memory came from
+ * @param category what the memory is for
+ * @param ptr memory to resize, NULL to allocate
+ * @param old_size current size of ptr, 0 if ptr is NULL
+ * @param new_size number of bytes wanted, positive
+ * @return the memory, possibly moved; NULL if over the limit or the callback
+ * failed, ptr being left as is
+ */
+void *chain_realloc(ChainAllocator *allocator, MemoryCategory category, void *ptr,
+                    size_t old_size, size_t new_size);
+
+/**
+ * Release memory of a category.
+ * @param allocator allocator the memory came from
+ * @param category what the memory was for
+ * @param ptr memory to release, may be NULL
+ * @param size its size, as last allocated or resized
+ */
+void chain_free(ChainAllocator *allocator, MemoryCategory category, void *ptr, size_t size);
+
+/**
+ * Make allocator the one markov_data_alloc() draws from on this thread,
+ * around a chain's copy_func.
+ * @param allocator allocator of the chain copying, NULL for none
+ * @return the previous one, to be restored afterwards
+ */
+ChainAllocator *swap_data_allocator(ChainAllocator *allocator);
+
+/**
+ * Allocate a state copy. Called from a chain's copy_func, it draws from the
+ * chain's allocator as MEMORY_DATA; called anywhere else, from malloc().
+ * Copy functions that allocate with malloc() still work, their copies just
+ * go uncounted.
+ * @param size number of bytes
+ * @return the memory, NULL on failure
+ */
+void *markov_data_alloc(size_t size);
+
+/**
+ * Release memory from markov_data_alloc(), wherever it was called.
+ * @param data memory to release, may be NULL
+ */
+void markov_data_free(void *data);
+
+#endif /* _MARKOV_ALLOCATOR_H */
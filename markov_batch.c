@@ -0,0 +1,521 @@
+#include "markov_batch.h"
+
+#include <stdint.h> // for SIZE_MAX, uintptr_t
+#include <string.h>
+
+#define DEFAULT_MAX_ATTEMPTS 1000
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/**
+ * Make sure the batch arena can hold the requested number of entries.
+ * @param batch batch to grow
+ * @param states_needed number of state slots needed
+ * @param offsets_needed number of offset slots needed
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int reserve_batch(SequenceBatch *batch, size_t states_needed,
+                         size_t offsets_needed) {
+    if (batch->states_capacity < states_needed) {
+        MarkovNode **states = realloc(batch->states, states_needed * sizeof(MarkovNode *));
+        if (states == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return 1;
+        }
+        batch->states = states;
+        batch->states_capacity = states_needed;
+    }
+
+    if (batch->offsets_capacity < offsets_needed) {
+        size_t *offsets = realloc(batch->offsets, offsets_needed * sizeof(size_t));
+        if (offsets == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return 1;
+        }
+        batch->offsets = offsets;
+        batch->offsets_capacity = offsets_needed;
+    }
+    return 0;
+}
+
+/**
+ * Reset the batch and reserve the worst case once, so the walk loop never
+ * allocates.
+ * @param batch batch to prepare
+ * @param max_length maximum length of each sequence
+ * @param num_sequences number of sequences to come
+ * @return 0 on success, 1 on overflow or allocation error
+ */
+static int prepare_batch(SequenceBatch *batch, int max_length, size_t num_sequences) {
+    batch->num_sequences = 0;
+    batch->max_length = max_length;
+    if (num_sequences > (SIZE_MAX - 1) / (size_t)max_length) {
+        return 1;
+    }
+    if (reserve_batch(batch, num_sequences * (size_t)max_length, num_sequences + 1) != 0) {
+        return 1;
+    }
+    batch->offsets[0] = 0;
+    return 0;
+}
+
+/**
+ * Finish a fingerprint: mix the bits of the running hash and the length,
+ * and keep 0 free for empty slots.
+ * @param hash running hash of the states
+ * @param length number of states
+ * @return fingerprint of the sequence, never 0
+ */
+static uint64_t finish_fingerprint(uint64_t hash, size_t length) {
+    uint64_t z = hash ^ ((uint64_t)length * 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z != 0 ? z : 1;
+}
+
+/**
+ * Double the set of the filter.
+ * @param filter filter to grow
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int grow_filter(SequenceFilter *filter) {
+    size_t capacity = filter->capacity * 2;
+    uint64_t *fingerprints = calloc(capacity, sizeof(uint64_t));
+    if (fingerprints == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    for (size_t i = 0; i < filter->capacity; i++) {
+        uint64_t fingerprint = filter->fingerprints[i];
+        if (fingerprint == 0) {
+            continue;
+        }
+        size_t slot = (size_t)fingerprint & (capacity - 1);
+        while (fingerprints[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        fingerprints[slot] = fingerprint;
+    }
+    free(filter->fingerprints);
+    filter->fingerprints = fingerprints;
+    filter->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Add a fingerprint to the filter unless it is already there.
+ * @param filter filter to add to
+ * @param fingerprint fingerprint of a sequence
+ * @param added output, whether the fingerprint was new
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int filter_insert(SequenceFilter *filter, uint64_t fingerprint, bool *added) {
+    // Keep the load factor at most 1/2
+    if ((filter->size + 1) * 2 > filter->capacity && grow_filter(filter) != 0) {
+        return 1;
+    }
+    size_t slot = (size_t)fingerprint & (filter->capacity - 1);
+    while (filter->fingerprints[slot] != 0) {
+        if (filter->fingerprints[slot] == fingerprint) {
+            *added = false;
+            return 0;
+        }
+        slot = (slot + 1) & (filter->capacity - 1);
+    }
+    filter->fingerprints[slot] = fingerprint;
+    filter->size++;
+    *added = true;
+    return 0;
+}
+
+/**
+ * Walk from the given node and write the sequence after the last one of
+ * the batch. This is the walk of generate_random_sequence(), recorded
+ * instead of printed.
+ * @param markov_chain chain to walk
+ * @param batch prepared batch with room for the sequence
+ * @param current_node first state of the sequence
+ * @param random stream to draw from, NULL to use rand()
+ * @return fingerprint of the walk
+ */
+static uint64_t walk_sequence(MarkovChain *markov_chain, SequenceBatch *batch,
+                              MarkovNode *current_node, MarkovRandom *random) {
+    size_t first = batch->offsets[batch->num_sequences];
+    size_t used = first;
+    uint64_t hash = 0;
+    int word_count = 0;
+    while (word_count < batch->max_length) {
+        batch->states[used++] = current_node;
+        hash = (hash ^ (uint64_t)(uintptr_t)current_node) * 0x100000001B3ULL;
+        word_count++;
+
+        if (markov_chain->is_last(current_node->data)) {
+            break;
+        }
+
+        current_node = random == NULL ? get_next_random_node(current_node)
+                                      : get_next_random_node_r(current_node, random);
+        if (current_node == NULL) {
+            break;
+        }
+    }
+
+    batch->offsets[batch->num_sequences + 1] = used;
+    return finish_fingerprint(hash, used - first);
+}
+
+/**
+ * Walk from the given node and append the sequence to the batch.
+ * @param markov_chain chain to walk
+ * @param batch prepared batch with room for the sequence
+ * @param current_node first state of the sequence
+ * @param random stream to draw from, NULL to use rand()
+ */
+static void append_walk(MarkovChain *markov_chain, SequenceBatch *batch,
+                        MarkovNode *current_node, MarkovRandom *random) {
+    walk_sequence(markov_chain, batch, current_node, random);
+    batch->num_sequences++;
+}
+
+/**
+ * Walk until the filter accepts a sequence, then keep it in the batch.
+ * @param markov_chain chain to walk
+ * @param batch prepared batch with room for the sequence
+ * @param start_states pool to draw first states from, NULL for random starts
+ * @param num_start_states size of the pool
+ * @param random stream to draw from, NULL to use rand()
+ * @param filter sequences to avoid
+ * @param added output, false if the filter gave up
+ * @return 0 on success, 1 if no first state or in case of allocation error
+ */
+static int append_unique_walk(MarkovChain *markov_chain, SequenceBatch *batch,
+                              MarkovNode *const *start_states, int num_start_states,
+                              MarkovRandom *random, SequenceFilter *filter, bool *added) {
+    *added = false;
+    for (int attempt = 0; attempt < filter->max_attempts && !*added; attempt++) {
+        MarkovNode *current_node;
+        if (start_states == NULL) {
+            current_node = get_first_random_node(markov_chain);
+        } else if (num_start_states > 1 && random != NULL) {
+            current_node = start_states[next_random(random) % (uint64_t)num_start_states];
+        } else {
+            current_node = start_states[0];
+        }
+        if (current_node == NULL) {
+            return 1;
+        }
+
+        uint64_t fingerprint = walk_sequence(markov_chain, batch, current_node, random);
+        if (filter_insert(filter, fingerprint, added) != 0) {
+            return 1;
+        }
+        filter->rejected += !*added;
+    }
+    batch->num_sequences += *added;
+    return 0;
+}
+
+int generate_sequence_batch(MarkovChain *markov_chain, MarkovNode *first_node,
+                            int max_length, size_t num_sequences,
+                            SequenceBatch *batch) {
+    if (markov_chain == NULL || batch == NULL || max_length <= 0) {
+        return 1;
+    }
+    if (prepare_batch(batch, max_length, num_sequences) != 0) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < num_sequences; i++) {
+        MarkovNode *current_node = first_node;
+        if (current_node == NULL) {
+            current_node = get_first_random_node(markov_chain);
+            if (current_node == NULL) {
+                return 1;
+            }
+        }
+        append_walk(markov_chain, batch, current_node, NULL);
+    }
+
+    return 0;
+}
+
+int collect_start_states(MarkovChain *markov_chain, MarkovNode ***start_states,
+                         int *num_start_states) {
+    if (markov_chain == NULL || markov_chain->database == NULL ||
+        start_states == NULL || num_start_states == NULL) {
+        return 1;
+    }
+
+    MarkovNode **states = malloc(((size_t)markov_chain->database->size + 1) *
+                                 sizeof(MarkovNode *));
+    if (states == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+
+    int count = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        if (!markov_chain->is_last(current->data->data)) {
+            states[count++] = current->data;
+        }
+    }
+
+    *start_states = states;
+    *num_start_states = count;
+    return 0;
+}
+
+int generate_sequence_batch_r(MarkovChain *markov_chain,
+                              MarkovNode *const *start_states, int num_start_states,
+                              int max_length, size_t num_sequences,
+                              SequenceBatch *batch, MarkovRandom *random) {
+    if (markov_chain == NULL || start_states == NULL || num_start_states <= 0 ||
+        batch == NULL || random == NULL || max_length <= 0) {
+        return 1;
+    }
+    if (prepare_batch(batch, max_length, num_sequences) != 0) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < num_sequences; i++) {
+        MarkovNode *current_node = start_states[0];
+        if (num_start_states > 1) {
+            current_node = start_states[next_random(random) % (uint64_t)num_start_states];
+        }
+        append_walk(markov_chain, batch, current_node, random);
+    }
+
+    return 0;
+}
+
+/**
+ * One walk in flight of generate_lockstep_batch_r().
+ */
+typedef struct Walker {
+    MarkovNode *current_node;
+    // states so far, max_length slots of the scratch rows
+    MarkovNode **states;
+    int length;
+    // whether what the next step of current_node reads was prefetched
+    bool ready;
+} Walker;
+
+/**
+ * Draw a first state from the pool and start a walker on it, prefetching
+ * the state for the next round.
+ * @param walker walker to start
+ * @param start_states pool to draw from
+ * @param num_start_states size of the pool
+ * @param random stream to draw from
+ */
+static void start_walker(Walker *walker, MarkovNode *const *start_states,
+                         int num_start_states, MarkovRandom *random) {
+    walker->current_node = start_states[0];
+    if (num_start_states > 1) {
+        walker->current_node = start_states[next_random(random) % (uint64_t)num_start_states];
+    }
+    walker->length = 0;
+    walker->ready = false;
+    PREFETCH(walker->current_node);
+    PREFETCH((char *)walker->current_node + sizeof(MarkovNode) - 1);
+}
+
+int generate_lockstep_batch_r(MarkovChain *markov_chain,
+                              MarkovNode *const *start_states, int num_start_states,
+                              int max_length, size_t num_sequences, int num_walkers,
+                              SequenceBatch *batch, MarkovRandom *random) {
+    if (markov_chain == NULL || start_states == NULL || num_start_states <= 0 ||
+        batch == NULL || random == NULL || max_length <= 0 || num_walkers <= 0) {
+        return 1;
+    }
+    if (prepare_batch(batch, max_length, num_sequences) != 0) {
+        return 1;
+    }
+    if ((size_t)num_walkers > num_sequences) {
+        num_walkers = (int)num_sequences;
+    }
+    if (num_walkers == 0) {
+        return 0;
+    }
+
+    Walker *walkers = malloc((size_t)num_walkers * sizeof(Walker));
+    MarkovNode **rows = malloc((size_t)num_walkers * (size_t)max_length * sizeof(MarkovNode *));
+    if (walkers == NULL || rows == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(walkers);
+        free(rows);
+        return 1;
+    }
+    for (int w = 0; w < num_walkers; w++) {
+        walkers[w].states = rows + (size_t)w * (size_t)max_length;
+        start_walker(&walkers[w], start_states, num_start_states, random);
+    }
+
+    // Every walk takes two rounds per step: one to prefetch what the step
+    // reads once its state has arrived, one to take the step and prefetch
+    // the next state. Each prefetch thus has a whole round of the other
+    // walks to complete in.
+    size_t started = (size_t)num_walkers;
+    int active = num_walkers;
+    while (active > 0) {
+        for (int w = 0; w < active;) {
+            Walker *walker = &walkers[w];
+            MarkovNode *current_node = walker->current_node;
+            if (!walker->ready) {
+                // Long successor lists span more lines, fetch their ends too
+                int last = current_node->frequency_list_size - 1;
+                PREFETCH(current_node->data);
+                PREFETCH(current_node->frequencies);
+                PREFETCH(current_node->frequency_list);
+                if (last > 0) {
+                    PREFETCH((char *)current_node->frequencies +
+                             (size_t)last * current_node->frequency_width);
+                    PREFETCH(&current_node->frequency_list[last]);
+                }
+                walker->ready = true;
+                w++;
+                continue;
+            }
+
+            // The step of walk_sequence()
+            walker->states[walker->length++] = current_node;
+            MarkovNode *next_node = NULL;
+            if (walker->length < max_length && !markov_chain->is_last(current_node->data)) {
+                next_node = get_next_random_node_r(current_node, random);
+            }
+            if (next_node != NULL) {
+                walker->current_node = next_node;
+                walker->ready = false;
+                PREFETCH(next_node);
+                PREFETCH((char *)next_node + sizeof(MarkovNode) - 1);
+                w++;
+                continue;
+            }
+
+            // The walk ended: keep it, then start the next one or retire
+            // the walker by moving the last active one in its place
+            size_t first = batch->offsets[batch->num_sequences];
+            memcpy(batch->states + first, walker->states,
+                   (size_t)walker->length * sizeof(MarkovNode *));
+            batch->offsets[++batch->num_sequences] = first + (size_t)walker->length;
+            if (started < num_sequences) {
+                start_walker(walker, start_states, num_start_states, random);
+                started++;
+                w++;
+            } else {
+                MarkovNode **states = walker->states;
+                *walker = walkers[--active];
+                walkers[active].states = states;
+            }
+        }
+    }
+
+    free(walkers);
+    free(rows);
+    return 0;
+}
+
+int init_sequence_filter(SequenceFilter *filter, size_t expected_sequences) {
+    if (filter == NULL) {
+        return 1;
+    }
+    size_t capacity = 16;
+    while (capacity < 2 * expected_sequences && capacity < SIZE_MAX / 4) {
+        capacity *= 2;
+    }
+    *filter = (SequenceFilter) {calloc(capacity, sizeof(uint64_t)), capacity, 0,
+                                DEFAULT_MAX_ATTEMPTS, 0};
+    if (filter->fingerprints == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    return 0;
+}
+
+int generate_unique_batch(MarkovChain *markov_chain, MarkovNode *first_node,
+                          int max_length, size_t num_sequences,
+                          SequenceBatch *batch, SequenceFilter *filter) {
+    if (markov_chain == NULL || batch == NULL || filter == NULL || max_length <= 0) {
+        return 1;
+    }
+    if (prepare_batch(batch, max_length, num_sequences) != 0) {
+        return 1;
+    }
+
+    bool added = true;
+    for (size_t i = 0; i < num_sequences && added; i++) {
+        if (append_unique_walk(markov_chain, batch, first_node != NULL ? &first_node : NULL,
+                               1, NULL, filter, &added) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int generate_unique_batch_r(MarkovChain *markov_chain,
+                            MarkovNode *const *start_states, int num_start_states,
+                            int max_length, size_t num_sequences,
+                            SequenceBatch *batch, MarkovRandom *random,
+                            SequenceFilter *filter) {
+    if (markov_chain == NULL || start_states == NULL || num_start_states <= 0 ||
+        batch == NULL || random == NULL || filter == NULL || max_length <= 0) {
+        return 1;
+    }
+    if (prepare_batch(batch, max_length, num_sequences) != 0) {
+        return 1;
+    }
+
+    bool added = true;
+    for (size_t i = 0; i < num_sequences && added; i++) {
+        if (append_unique_walk(markov_chain, batch, start_states, num_start_states,
+                               random, filter, &added) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void free_sequence_filter(SequenceFilter *filter) {
+    if (filter == NULL) {
+        return;
+    }
+    free(filter->fingerprints);
+    *filter = (SequenceFilter) {NULL, 0, 0, 0, 0};
+}
+
+size_t get_sequence_length(const SequenceBatch *batch, size_t index) {
+    return batch->offsets[index + 1] - batch->offsets[index];
+}
+
+void print_sequence(MarkovChain *markov_chain, const SequenceBatch *batch,
+                    size_t index) {
+    for (size_t i = batch->offsets[index]; i < batch->offsets[index + 1]; i++) {
+        if (i != batch->offsets[index]) {
+            printf(" ");
+        }
+        markov_chain->print_func(batch->states[i]->data);
+    }
+
+    // generate_random_sequence() prints the separator before it notices the
+    // length limit, so a walk cut short while it could go on ends with a space
+    MarkovNode *last = batch->states[batch->offsets[index + 1] - 1];
+    if (get_sequence_length(batch, index) == (size_t)batch->max_length &&
+        !markov_chain->is_last(last->data) && last->frequency_list_size > 0) {
+        printf(" ");
+    }
+}
+
+void free_sequence_batch(SequenceBatch *batch) {
+    if (batch == NULL) {
+        return;
+    }
+    free(batch->states);
+    free(batch->offsets);
+    *batch = (SequenceBatch) {NULL, NULL, 0, 0, 0, 0};
+}
@@ -0,0 +1,197 @@
+#ifndef _MARKOV_BATCH_H
+#define _MARKOV_BATCH_H
+
+#include "markov_chain.h"
+#include <stddef.h> // for size_t
+
+/**
+ * Many generated sequences stored back to back in one arena. Sequence i is
+ * states[offsets[i]] .. states[offsets[i + 1] - 1].
+ * Zero-initialize before first use; a batch can be reused across calls and
+ * only grows its arena when a call needs more room.
+ */
+typedef struct SequenceBatch {
+    MarkovNode **states;
+    size_t *offsets;
+    size_t num_sequences;
+    // max_length the batch was generated with
+    int max_length;
+    // allocated entries of states and offsets
+    size_t states_capacity;
+    size_t offsets_capacity;
+} SequenceBatch;
+
+/**
+ * Set of the sequences generated so far, for jobs that need distinct
+ * sequences. Each sequence is reduced to a 64-bit fingerprint of its states,
+ * hashed incrementally during the walk, and kept in an open addressing set,
+ * so memory is 16 bytes per distinct sequence at most. Two different
+ * sequences share a fingerprint with probability about n^2 / 2^65; that only
+ * drops a sequence, a duplicate is never let through.
+ * A filter can span several batches to keep a whole job distinct.
+ */
+typedef struct SequenceFilter {
+    // fingerprints, 0 marks an empty slot
+    uint64_t *fingerprints;
+    // power of two
+    size_t capacity;
+    size_t size;
+    // consecutive duplicates after which generation gives up
+    int max_attempts;
+    // duplicates thrown away so far
+    size_t rejected;
+} SequenceFilter;
+
+/**
+ * Generate num_sequences random sequences in one call, without printing.
+ * Each sequence is built exactly like generate_random_sequence() builds it,
+ * consuming random numbers in the same order, so a seeded run produces the
+ * same sequences as the print-as-you-go loop.
+ * @param markov_chain chain to walk
+ * @param first_node state every sequence starts with, if NULL - choose a
+ * random start state per sequence with get_first_random_node()
+ * @param max_length maximum length of each sequence
+ * @param num_sequences number of sequences to generate
+ * @param batch batch to fill, its previous content is discarded
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int generate_sequence_batch(MarkovChain *markov_chain, MarkovNode *first_node,
+                            int max_length, size_t num_sequences,
+                            SequenceBatch *batch);
+
+/**
+ * Collect every state that is not a "last state" - the states
+ * get_first_random_node() picks from - into one array, so random starts
+ * can be drawn in O(1) instead of walking the database.
+ * @param markov_chain chain to collect from
+ * @param start_states output, newly allocated array, free with free()
+ * @param num_start_states output, number of collected states
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int collect_start_states(MarkovChain *markov_chain, MarkovNode ***start_states,
+                         int *num_start_states);
+
+/**
+ * Reentrant version of generate_sequence_batch(): draws from the given
+ * stream instead of rand(), so threads can generate from one shared,
+ * unmodified chain in parallel.
+ * @param markov_chain chain to walk
+ * @param start_states pool every sequence draws its first state from
+ * uniformly, e.g. from collect_start_states(), or a single fixed state
+ * @param num_start_states size of the pool, positive
+ * @param max_length maximum length of each sequence
+ * @param num_sequences number of sequences to generate
+ * @param batch batch to fill, its previous content is discarded
+ * @param random stream to draw from
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int generate_sequence_batch_r(MarkovChain *markov_chain,
+                              MarkovNode *const *start_states, int num_start_states,
+                              int max_length, size_t num_sequences,
+                              SequenceBatch *batch, MarkovRandom *random);
+
+/**
+ * Lockstep version of generate_sequence_batch_r() for throughput: up to
+ * num_walkers walks advance together, one step each per round, and the
+ * state, counters, successors and data every walker reads next round are
+ * prefetched meanwhile, so the cache misses of different walks overlap
+ * instead of stalling each walk hop by hop. A walk that ends is written to
+ * the batch and its walker starts the next sequence on the spot.
+ * Sequences come out in the order they end, each drawn from the same
+ * distribution as with generate_sequence_batch_r(), but the walks share
+ * the stream in lockstep, so a seed gives different sequences than there.
+ * @param markov_chain chain to walk
+ * @param start_states pool every sequence draws its first state from
+ * @param num_start_states size of the pool, positive
+ * @param max_length maximum length of each sequence
+ * @param num_sequences number of sequences to generate
+ * @param num_walkers number of walks in flight, positive; 8 to 32 hide
+ * most memory latency on chains larger than the cache
+ * @param batch batch to fill, its previous content is discarded
+ * @param random stream to draw from
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int generate_lockstep_batch_r(MarkovChain *markov_chain,
+                              MarkovNode *const *start_states, int num_start_states,
+                              int max_length, size_t num_sequences, int num_walkers,
+                              SequenceBatch *batch, MarkovRandom *random);
+
+/**
+ * Prepare an empty filter.
+ * @param filter filter to initialize
+ * @param expected_sequences number of distinct sequences expected, to size
+ * the set; it grows past it as needed
+ * @return 0 on success, 1 in case of allocation error
+ */
+int init_sequence_filter(SequenceFilter *filter, size_t expected_sequences);
+
+/**
+ * Like generate_sequence_batch(), but only keeps sequences the filter has
+ * not seen, walking again on a duplicate. If filter->max_attempts walks in a
+ * row are duplicates the chain is taken to have no more distinct sequences
+ * to give, and the batch is returned with fewer sequences.
+ * @param markov_chain chain to walk
+ * @param first_node state every sequence starts with, NULL for random starts
+ * @param max_length maximum length of each sequence
+ * @param num_sequences number of distinct sequences to generate
+ * @param batch batch to fill, its previous content is discarded
+ * @param filter sequences to avoid, the new ones are added to it
+ * @return 0 on success (check batch->num_sequences), 1 on invalid arguments
+ * or allocation error
+ */
+int generate_unique_batch(MarkovChain *markov_chain, MarkovNode *first_node,
+                          int max_length, size_t num_sequences,
+                          SequenceBatch *batch, SequenceFilter *filter);
+
+/**
+ * Reentrant version of generate_unique_batch(), see
+ * generate_sequence_batch_r(). The filter must not be shared between
+ * threads.
+ * @param markov_chain chain to walk
+ * @param start_states pool every sequence draws its first state from
+ * @param num_start_states size of the pool, positive
+ * @param max_length maximum length of each sequence
+ * @param num_sequences number of distinct sequences to generate
+ * @param batch batch to fill, its previous content is discarded
+ * @param random stream to draw from
+ * @param filter sequences to avoid, the new ones are added to it
+ * @return 0 on success (check batch->num_sequences), 1 on invalid arguments
+ * or allocation error
+ */
+int generate_unique_batch_r(MarkovChain *markov_chain,
+                            MarkovNode *const *start_states, int num_start_states,
+                            int max_length, size_t num_sequences,
+                            SequenceBatch *batch, MarkovRandom *random,
+                            SequenceFilter *filter);
+
+/**
+ * Free the set of the filter (not the filter struct itself) and reset it.
+ * @param filter filter to free
+ */
+void free_sequence_filter(SequenceFilter *filter);
+
+/**
+ * Get the length of the sequence at the given index.
+ * @param batch generated batch
+ * @param index sequence index, smaller than batch->num_sequences
+ * @return number of states in the sequence
+ */
+size_t get_sequence_length(const SequenceBatch *batch, size_t index);
+
+/**
+ * Print one sequence of the batch, states separated by spaces, byte for byte
+ * the way generate_random_sequence() prints it.
+ * @param markov_chain chain the batch was generated from
+ * @param batch generated batch
+ * @param index sequence index, smaller than batch->num_sequences
+ */
+void print_sequence(MarkovChain *markov_chain, const SequenceBatch *batch,
+                    size_t index);
+
+/**
+ * Free the arena of the batch (not the batch struct itself) and reset it.
+ * @param batch batch to free
+ */
+void free_sequence_batch(SequenceBatch *batch);
+
+#endif /* _MARKOV_BATCH_H */
@@ -0,0 +1,1396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "tweets_corpus.h"
+#include "tweets_score.h"
+#include "markov_batch.h"
+#include "markov_layout.h"
+#include "markov_index.h"
+#include "markov_cache.h"
+#include "tokenizer.h"
+
+#define NUM_ARGS_ERROR "Usage: markov_bench <benchmark> <args>...\n" \
+        "  tokenizer <corpus> [repeat]\n" \
+        "  score <corpus> [threads]\n" \
+        "  window <corpus> <sentences> [decay]\n" \
+        "  walk [states] [successors]\n" \
+        "  lockstep [states] [successors]\n" \
+        "  lookup [states] [lookups]\n" \
+        "  sketch <corpus> [epsilon] [top_k]\n" \
+        "  shared <corpus> [chains]\n" \
+        "  memory <corpus> [limit_kb]\n" \
+        "  cache <corpus> [threads] [requests]"
+#define FILE_PATH_ERROR "Error: incorrect file path"
+
+/**
+ * Current monotonic time.
+ * @return seconds
+ */
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/**
+ * Read a whole file into memory, repeated the given number of times.
+ * @param path file to read
+ * @param repeat number of copies
+ * @param length output, number of bytes read
+ * @return NUL-terminated buffer, NULL on error
+ */
+static char *read_corpus(const char *path, int repeat, size_t *length) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *text = malloc((size_t)size * (size_t)repeat + 1);
+    if (text == NULL || size <= 0 || fread(text, 1, (size_t)size, fp) != (size_t)size) {
+        free(text);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    for (int i = 1; i < repeat; i++) {
+        memcpy(text + (size_t)size * (size_t)i, text, (size_t)size);
+    }
+    *length = (size_t)size * (size_t)repeat;
+    text[*length] = '\0';
+    return text;
+}
+
+/**
+ * Tokenize the corpus line by line like fill_database() did, with strtok.
+ * @param text corpus
+ * @param length corpus size
+ * @param sentences output, number of words ending with '.'
+ * @return number of words
+ */
+static size_t count_words_strtok(const char *text, size_t length, size_t *sentences) {
+    char line[MAX_LINE_LENGTH];
+    size_t words = 0;
+    *sentences = 0;
+    for (size_t offset = 0; offset < length;) {
+        // Same chunks as fgets(line, MAX_LINE_LENGTH, fp)
+        size_t line_length = 0;
+        while (offset + line_length < length && line_length < MAX_LINE_LENGTH - 1) {
+            if (text[offset + line_length++] == '\n') {
+                break;
+            }
+        }
+        memcpy(line, text + offset, line_length);
+        line[line_length] = '\0';
+        offset += line_length;
+
+        for (char *word = strtok(line, DELIMITERS); word != NULL;
+             word = strtok(NULL, DELIMITERS)) {
+            size_t word_length = strlen(word);
+            words++;
+            *sentences += word[word_length - 1] == '.';
+        }
+    }
+    return words;
+}
+
+/**
+ * Tokenize the corpus line by line like fill_database() does now.
+ * @param text corpus
+ * @param length corpus size
+ * @param sentences output, number of words ending with '.'
+ * @return number of words
+ */
+static size_t count_words_tokenizer(const char *text, size_t length, size_t *sentences) {
+    char line[MAX_LINE_LENGTH];
+    size_t words = 0;
+    *sentences = 0;
+    for (size_t offset = 0; offset < length;) {
+        size_t line_length = 0;
+        while (offset + line_length < length && line_length < MAX_LINE_LENGTH - 1) {
+            if (text[offset + line_length++] == '\n') {
+                break;
+            }
+        }
+        memcpy(line, text + offset, line_length);
+        line[line_length] = '\0';
+        offset += line_length;
+
+        Tokenizer tokenizer;
+        TokenSpan token;
+        init_tokenizer(&tokenizer, line, line_length);
+        while (next_token(&tokenizer, &token)) {
+            words++;
+            *sentences += token.ends_sentence;
+        }
+    }
+    return words;
+}
+
+/**
+ * Compare the strtok loop with the SIMD tokenizer on the same data.
+ * @param argc num of benchmark arguments
+ * @param argv 1) Corpus file
+ *             2) Optional number of in-memory copies (default 200)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_tokenizer(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+    int repeat = argc == 3 ? atoi(argv[2]) : 200;
+    size_t length;
+    char *text = read_corpus(argv[1], repeat > 0 ? repeat : 1, &length);
+    if (text == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    size_t strtok_sentences, tokenizer_sentences;
+    double start = now_seconds();
+    size_t strtok_words = count_words_strtok(text, length, &strtok_sentences);
+    double strtok_time = now_seconds() - start;
+
+    start = now_seconds();
+    size_t tokenizer_words = count_words_tokenizer(text, length, &tokenizer_sentences);
+    double tokenizer_time = now_seconds() - start;
+
+    double megabytes = (double)length / 1e6;
+    printf("corpus: %.1f MB, %zu words, %zu sentence ends\n",
+           megabytes, tokenizer_words, tokenizer_sentences);
+    printf("strtok:    %8.1f MB/s\n", megabytes / strtok_time);
+    printf("tokenizer: %8.1f MB/s (%.2fx)\n", megabytes / tokenizer_time,
+           strtok_time / tokenizer_time);
+    free(text);
+
+    if (strtok_words != tokenizer_words || strtok_sentences != tokenizer_sentences) {
+        printf("Error: tokenizers disagree\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Split a corpus into its lines, in place.
+ * @param text corpus, newlines are replaced by NULs
+ * @param num_lines output, number of lines
+ * @return array of line starts, NULL in case of allocation error
+ */
+static const char **split_lines(char *text, size_t *num_lines) {
+    size_t count = 1;
+    for (char *c = text; *c != '\0'; c++) {
+        count += *c == '\n';
+    }
+    const char **lines = malloc(count * sizeof(char *));
+    if (lines == NULL) {
+        return NULL;
+    }
+    *num_lines = 0;
+    for (char *line = text; line != NULL;) {
+        char *end = strchr(line, '\n');
+        if (end != NULL) {
+            *end = '\0';
+        }
+        lines[(*num_lines)++] = line;
+        line = end != NULL ? end + 1 : NULL;
+    }
+    return lines;
+}
+
+/**
+ * Log-likelihood of a text with the chain's own linear lookups, the way a
+ * caller without the scorer would compute it, unsmoothed.
+ * @param markov_chain word chain
+ * @param text text to score
+ * @param unseen log-probability of unseen transitions
+ * @return the log-likelihood
+ */
+static double naive_log_likelihood(MarkovChain *markov_chain, const char *text, double unseen) {
+    char line[MAX_LINE_LENGTH];
+    snprintf(line, sizeof(line), "%s", text);
+    double log_likelihood = 0;
+    MarkovNode *previous = NULL;
+    bool in_sentence = false;
+    for (char *word = strtok(line, DELIMITERS); word != NULL;
+         word = strtok(NULL, DELIMITERS)) {
+        Node *node = get_node_from_database(markov_chain, word);
+        MarkovNode *current = node != NULL ? node->data : NULL;
+        if (in_sentence) {
+            double log_probability = unseen;
+            for (int i = 0; previous != NULL && current != NULL &&
+                            i < previous->frequency_list_size; i++) {
+                if (previous->frequency_list[i] == current) {
+                    log_probability = log((double)get_frequency(previous, i) /
+                                          (double)previous->total_frequency);
+                    break;
+                }
+            }
+            log_likelihood += log_probability;
+        }
+        in_sentence = word[strlen(word) - 1] != '.';
+        previous = current;
+    }
+    return log_likelihood;
+}
+
+/**
+ * Score every line of a corpus against the chain trained on it, with the
+ * linear lookups and with the scorer on one and on several threads.
+ * @param argc num of benchmark arguments
+ * @param argv 1) Corpus file
+ *             2) Optional number of threads (default one per CPU)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_score(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+    FILE *fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return EXIT_FAILURE;
+    }
+    MarkovChain *markov_chain = create_tweets_chain();
+    if (markov_chain == NULL || fill_database(fp, -1, markov_chain) != 0) {
+        fclose(fp);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+    fclose(fp);
+
+    size_t length, num_lines;
+    char *text = read_corpus(argv[1], 1, &length);
+    const char **lines = text != NULL ? split_lines(text, &num_lines) : NULL;
+    TweetScorer *scorer = create_tweet_scorer(markov_chain);
+    SequenceScore *scores = lines != NULL ? malloc(num_lines * sizeof(SequenceScore)) : NULL;
+    if (scores == NULL || scorer == NULL) {
+        free(text);
+        free(lines);
+        free(scores);
+        free_tweet_scorer(&scorer);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    ScoringOptions options = default_scoring_options();
+    options.alpha = 0;
+    double start = now_seconds();
+    double naive_total = 0;
+    for (size_t i = 0; i < num_lines; i++) {
+        naive_total += naive_log_likelihood(markov_chain, lines[i],
+                                            options.unseen_log_probability);
+    }
+    double naive_time = now_seconds() - start;
+
+    options.num_threads = 1;
+    start = now_seconds();
+    score_tweets(scorer, lines, num_lines, &options, scores);
+    double single_time = now_seconds() - start;
+    double single_total = 0;
+    for (size_t i = 0; i < num_lines; i++) {
+        single_total += scores[i].log_likelihood;
+    }
+
+    options.num_threads = argc == 3 ? atoi(argv[2]) : 0;
+    start = now_seconds();
+    score_tweets(scorer, lines, num_lines, &options, scores);
+    double threaded_time = now_seconds() - start;
+
+    printf("%zu texts, %d states, log-likelihood %.3f\n",
+           num_lines, scorer->num_states, single_total);
+    printf("linear lookups: %8.1f texts/ms\n", (double)num_lines / naive_time / 1e3);
+    printf("scorer:         %8.1f texts/ms (%.1fx)\n",
+           (double)num_lines / single_time / 1e3, naive_time / single_time);
+    printf("scorer threads: %8.1f texts/ms (%.1fx)\n",
+           (double)num_lines / threaded_time / 1e3, naive_time / threaded_time);
+
+    int status = fabs(naive_total - single_total) <= 1e-6 * fabs(naive_total) + 1e-6
+                 ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (status != EXIT_SUCCESS) {
+        printf("Error: scores disagree (%.3f)\n", naive_total);
+    }
+    free(text);
+    free(lines);
+    free(scores);
+    free_tweet_scorer(&scorer);
+    free_database(&markov_chain);
+    return status;
+}
+
+/**
+ * Count the states and transitions of a chain.
+ * @param markov_chain chain to measure
+ * @param edges output, number of distinct transitions
+ * @param total output, sum of all transition counts
+ * @return number of states
+ */
+static int chain_size(MarkovChain *markov_chain, size_t *edges, uint64_t *total) {
+    *edges = 0;
+    *total = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        *edges += (size_t)current->data->frequency_list_size;
+        *total += current->data->total_frequency;
+    }
+    return markov_chain->database->size;
+}
+
+/**
+ * Count the transitions of a chain that a second chain holds too.
+ * @param markov_chain chain whose transitions to look up
+ * @param index index of the states of the chain to look in
+ * @param kept output, number of transitions the other chain holds
+ * @return number of transitions of markov_chain
+ */
+static size_t count_kept_transitions(MarkovChain *markov_chain, const StateIndex *index,
+                                     size_t *kept) {
+    size_t edges = 0;
+    *kept = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *from = index_lookup(index, current->data->data);
+        for (int i = 0; i < current->data->frequency_list_size; i++) {
+            edges++;
+            MarkovNode *to = index_lookup(index, current->data->frequency_list[i]->data);
+            for (int j = 0; from != NULL && to != NULL && j < from->frequency_list_size; j++) {
+                if (from->frequency_list[j] == to) {
+                    (*kept)++;
+                    break;
+                }
+            }
+        }
+    }
+    return edges;
+}
+
+/**
+ * Check that a decaying window still holds every transition of its last
+ * half-life of sentences, by streaming the corpus again through an exact
+ * window of that length.
+ * @param fp the corpus the window was filled from
+ * @param window decaying window
+ * @param sentences its half-life
+ * @return EXIT_SUCCESS if every recent transition was kept, else EXIT_FAILURE
+ */
+static int check_recent_kept(FILE *fp, ChainWindow *window, size_t sentences) {
+    MarkovChain *recent_chain = create_tweets_chain();
+    ChainWindow *recent = recent_chain != NULL
+                          ? create_chain_window(recent_chain, hash_string, WINDOW_SLIDING,
+                                                sentences) : NULL;
+    int status = EXIT_FAILURE;
+    rewind(fp);
+    if (recent != NULL && fill_window(fp, -1, recent) == 0) {
+        size_t kept;
+        size_t edges = count_kept_transitions(recent_chain, window->index, &kept);
+        printf("last %zu sentences: %zu of %zu transitions kept after %zu rescales\n",
+               sentences, kept, edges, window->rescales);
+        status = kept == edges ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    free_chain_window(&recent);
+    free_database(&recent_chain);
+    return status;
+}
+
+/**
+ * Stream a corpus through a windowed chain and compare its size with the
+ * chain trained on the whole corpus. A decaying chain is also checked
+ * against the exact window of its half-life: every transition of those most
+ * recent sentences must have survived the rescales.
+ * @param argc num of benchmark arguments
+ * @param argv 1) Corpus file
+ *             2) Window length, or half-life with "decay", in sentences
+ *             3) Optional "decay" to decay counts instead of sliding
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_window(int argc, char *argv[]) {
+    long sentences = argc >= 3 ? strtol(argv[2], NULL, 10) : 0;
+    if ((argc != 3 && argc != 4) || sentences <= 0 ||
+        (argc == 4 && strcmp(argv[3], "decay") != 0)) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+    WindowMode mode = argc == 4 ? WINDOW_DECAY : WINDOW_SLIDING;
+
+    FILE *fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return EXIT_FAILURE;
+    }
+    MarkovChain *full_chain = create_tweets_chain();
+    MarkovChain *windowed_chain = create_tweets_chain();
+    ChainWindow *window = windowed_chain != NULL
+                          ? create_chain_window(windowed_chain, hash_string, mode,
+                                                (size_t)sentences) : NULL;
+    int status = EXIT_FAILURE;
+    double start = now_seconds();
+    if (full_chain != NULL && window != NULL && fill_database(fp, -1, full_chain) == 0) {
+        double full_time = now_seconds() - start;
+        rewind(fp);
+        start = now_seconds();
+        if (fill_window(fp, -1, window) == 0) {
+            double window_time = now_seconds() - start;
+            size_t edges;
+            uint64_t total;
+            int states = chain_size(full_chain, &edges, &total);
+            printf("full chain: %6d states, %7zu transitions, %8llu counts, %.3f s\n",
+                   states, edges, (unsigned long long)total, full_time);
+            states = chain_size(windowed_chain, &edges, &total);
+            printf("%s %ld:  %6d states, %7zu transitions, %8llu counts, %.3f s "
+                   "(%zu sentences)\n", mode == WINDOW_SLIDING ? "window" : "decay ",
+                   sentences, states, edges, (unsigned long long)total, window_time,
+                   window->total_sentences);
+            status = mode == WINDOW_DECAY ? check_recent_kept(fp, window, (size_t)sentences)
+                                          : EXIT_SUCCESS;
+        }
+    }
+    fclose(fp);
+    free_chain_window(&window);
+    free_database(&windowed_chain);
+    free_database(&full_chain);
+    return status;
+}
+
+/**
+ * Build a large synthetic word chain with skewed, scattered popularity: the
+ * successors of each state are drawn log-uniformly over a random ranking of
+ * all states, so a few states get most of the traffic but sit anywhere in
+ * memory, like the first-seen order of a real corpus leaves them.
+ * @param num_states number of states
+ * @param num_successors successor draws per state
+ * @param random stream to draw from
+ * @return the chain, NULL in case of allocation error
+ */
+static MarkovChain *build_synthetic_chain(int num_states, int num_successors,
+                                          MarkovRandom *random) {
+    MarkovChain *markov_chain = create_tweets_chain();
+    MarkovNode **nodes = malloc((size_t)num_states * sizeof(MarkovNode *));
+    int *ranking = malloc((size_t)num_states * sizeof(int));
+    if (markov_chain == NULL || nodes == NULL || ranking == NULL) {
+        free(nodes);
+        free(ranking);
+        free_database(&markov_chain);
+        return NULL;
+    }
+
+    char word[32];
+    for (int i = 0; i < num_states; i++) {
+        snprintf(word, sizeof(word), "s%d", i);
+        Node *node = append_to_database(markov_chain, word);
+        if (node == NULL) {
+            free(nodes);
+            free(ranking);
+            free_database(&markov_chain);
+            return NULL;
+        }
+        nodes[i] = node->data;
+        ranking[i] = i;
+    }
+    for (int i = num_states - 1; i > 0; i--) {
+        int j = (int)(next_random(random) % (uint64_t)(i + 1));
+        int swap = ranking[i];
+        ranking[i] = ranking[j];
+        ranking[j] = swap;
+    }
+
+    for (int i = 0; i < num_states; i++) {
+        for (int j = 0; j < num_successors; j++) {
+            double u = (double)(next_random(random) >> 11) / 9007199254740992.0;
+            int rank = (int)pow((double)num_states, u) - 1;
+            uint64_t count = 1 + next_random(random) % 8;
+            if (add_transition_count(markov_chain, nodes[i], nodes[ranking[rank]], count) != 0) {
+                free(nodes);
+                free(ranking);
+                free_database(&markov_chain);
+                return NULL;
+            }
+        }
+    }
+    free(nodes);
+    free(ranking);
+    return markov_chain;
+}
+
+/**
+ * Measure walk throughput on the chain's current layout.
+ * @param markov_chain chain to walk
+ * @param batch reusable batch
+ * @param total_steps output, number of states visited
+ * @return elapsed seconds, negative on error
+ */
+static double time_walks(MarkovChain *markov_chain, SequenceBatch *batch, size_t *total_steps) {
+    MarkovNode **start_states;
+    int num_start_states;
+    if (collect_start_states(markov_chain, &start_states, &num_start_states) != 0) {
+        return -1;
+    }
+    MarkovRandom random;
+    seed_random(&random, 7);
+    *total_steps = 0;
+    double start = now_seconds();
+    for (int round = 0; round < 20; round++) {
+        if (generate_sequence_batch_r(markov_chain, start_states, num_start_states, 64,
+                                      20000, batch, &random) != 0) {
+            free(start_states);
+            return -1;
+        }
+        *total_steps += batch->offsets[batch->num_sequences];
+    }
+    double elapsed = now_seconds() - start;
+    free(start_states);
+    return elapsed;
+}
+
+/**
+ * Compare walk throughput on a large chain in first-seen order and after
+ * relayout_chain() in both orders.
+ * @param argc num of benchmark arguments
+ * @param argv 1) Optional number of states (default 1000000)
+ *             2) Optional successor draws per state (default 4)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_walk(int argc, char *argv[]) {
+    int num_states = argc >= 2 ? atoi(argv[1]) : 1000000;
+    int num_successors = argc >= 3 ? atoi(argv[2]) : 4;
+    if (argc > 3 || num_states <= 0 || num_successors <= 0) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    MarkovRandom random;
+    seed_random(&random, 1);
+    MarkovChain *markov_chain = build_synthetic_chain(num_states, num_successors, &random);
+    if (markov_chain == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    const char *names[] = {"first-seen order", "visit frequency", "BFS order"};
+    const LayoutOrder orders[] = {LAYOUT_VISIT_FREQUENCY, LAYOUT_VISIT_FREQUENCY, LAYOUT_BFS};
+    SequenceBatch batch = {NULL, NULL, 0, 0, 0, 0};
+    double baseline = 0;
+    int status = EXIT_SUCCESS;
+    for (int i = 0; i < 3 && status == EXIT_SUCCESS; i++) {
+        double start = now_seconds();
+        if (i > 0 && relayout_chain(markov_chain, orders[i]) != 0) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        double relayout_time = now_seconds() - start;
+        size_t steps;
+        double elapsed = time_walks(markov_chain, &batch, &steps);
+        if (elapsed < 0) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        double rate = (double)steps / elapsed / 1e6;
+        if (i == 0) {
+            baseline = rate;
+            printf("%d states, %d successor draws each\n", num_states, num_successors);
+        }
+        printf("%-17s %7.1f M steps/s (%.2fx)", names[i], rate, rate / baseline);
+        if (i > 0) {
+            printf(", relayout %.2f s", relayout_time);
+        }
+        printf("\n");
+    }
+
+    free_sequence_batch(&batch);
+    free_database(&markov_chain);
+    return status;
+}
+
+/**
+ * Compare walks run one at a time with generate_sequence_batch_r() against
+ * generate_lockstep_batch_r() with growing numbers of walkers in flight.
+ * @param argc num of benchmark arguments
+ * @param argv 1) Optional number of states (default 1000000)
+ *             2) Optional successor draws per state (default 4)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_lockstep(int argc, char *argv[]) {
+    int num_states = argc >= 2 ? atoi(argv[1]) : 1000000;
+    int num_successors = argc >= 3 ? atoi(argv[2]) : 4;
+    if (argc > 3 || num_states <= 0 || num_successors <= 0) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    MarkovRandom random;
+    seed_random(&random, 1);
+    MarkovChain *markov_chain = build_synthetic_chain(num_states, num_successors, &random);
+    MarkovNode **start_states = NULL;
+    int num_start_states;
+    if (markov_chain == NULL ||
+        collect_start_states(markov_chain, &start_states, &num_start_states) != 0) {
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    const int walkers[] = {0, 4, 8, 16, 32, 64};
+    const size_t num_sequences = 100000;
+    SequenceBatch batch = {NULL, NULL, 0, 0, 0, 0};
+    double baseline = 0;
+    int status = EXIT_SUCCESS;
+    printf("%d states, %d successor draws each, %zu sequences of 64 states\n", num_states,
+           num_successors, num_sequences);
+    for (size_t i = 0; i < sizeof(walkers) / sizeof(walkers[0]); i++) {
+        seed_random(&random, 7);
+        double start = now_seconds();
+        int result = walkers[i] == 0
+                     ? generate_sequence_batch_r(markov_chain, start_states, num_start_states,
+                                                 64, num_sequences, &batch, &random)
+                     : generate_lockstep_batch_r(markov_chain, start_states, num_start_states,
+                                                 64, num_sequences, walkers[i], &batch,
+                                                 &random);
+        double elapsed = now_seconds() - start;
+        if (result != 0) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        double rate = (double)batch.num_sequences / elapsed / 1e3;
+        if (walkers[i] == 0) {
+            baseline = rate;
+            printf("single walks  ");
+        } else {
+            printf("%2d walkers    ", walkers[i]);
+        }
+        printf("%8.1f K sequences/s (%.2fx)\n", rate, rate / baseline);
+    }
+
+    free_sequence_batch(&batch);
+    free(start_states);
+    free_database(&markov_chain);
+    return status;
+}
+
+/**
+ * Compare single-key index lookups with index_lookup_batch() on a large
+ * index, with keys drawn uniformly so most probes miss the cache, and time
+ * building the same chain through index_add_batch().
+ * @param argc num of benchmark arguments
+ * @param argv 1) Optional number of states (default 1000000)
+ *             2) Optional number of lookups (default 4000000)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_lookup(int argc, char *argv[]) {
+    int num_states = argc >= 2 ? atoi(argv[1]) : 1000000;
+    long num_lookups = argc >= 3 ? atol(argv[2]) : 4000000;
+    if (argc > 3 || num_states <= 0 || num_lookups <= 0) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    // Keys as the tokens of a stream would arrive: strings in one buffer
+    size_t count = (size_t)num_lookups;
+    char *words = malloc(count * 16);
+    void **keys = malloc(count * sizeof(void *));
+    MarkovNode **results = malloc(count * sizeof(MarkovNode *));
+    MarkovChain *markov_chain = create_tweets_chain();
+    if (words == NULL || keys == NULL || results == NULL || markov_chain == NULL) {
+        free(words);
+        free(keys);
+        free(results);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+    MarkovRandom random;
+    seed_random(&random, 3);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = words + i * 16;
+        snprintf(keys[i], 16, "s%d", (int)(next_random(&random) % (uint64_t)num_states));
+    }
+
+    // Build: every state through the batch insert, in key order
+    StateIndex *index = build_state_index(markov_chain, hash_string);
+    int status = index == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+    double start = now_seconds();
+    if (status == EXIT_SUCCESS &&
+        index_add_batch(index, markov_chain, keys, count, results) != 0) {
+        status = EXIT_FAILURE;
+    }
+    double build_time = now_seconds() - start;
+
+    if (status == EXIT_SUCCESS) {
+        start = now_seconds();
+        size_t found = 0;
+        for (size_t i = 0; i < count; i++) {
+            found += index_lookup(index, keys[i]) == results[i];
+        }
+        double single_time = now_seconds() - start;
+
+        start = now_seconds();
+        index_lookup_batch(index, keys, count, results);
+        double batch_time = now_seconds() - start;
+
+        printf("%d states indexed, %zu lookups\n", markov_chain->database->size, count);
+        printf("index_add_batch:    %7.2f M keys/s\n", (double)count / build_time / 1e6);
+        printf("index_lookup:       %7.2f M lookups/s\n", (double)count / single_time / 1e6);
+        printf("index_lookup_batch: %7.2f M lookups/s (%.2fx)\n",
+               (double)count / batch_time / 1e6, single_time / batch_time);
+        if (found != count) {
+            printf("Error: lookups disagree\n");
+            status = EXIT_FAILURE;
+        }
+    }
+
+    free_state_index(&index);
+    free(words);
+    free(keys);
+    free(results);
+    free_database(&markov_chain);
+    return status;
+}
+
+/**
+ * Index of the most counted successor of a state, the first one on ties.
+ * @param markov_node state
+ * @return position in its frequency list, -1 without successors
+ */
+static int heaviest_successor(const MarkovNode *markov_node) {
+    int heaviest = -1;
+    for (int i = 0; i < markov_node->frequency_list_size; i++) {
+        if (heaviest == -1 || get_frequency(markov_node, i) > get_frequency(markov_node, heaviest)) {
+            heaviest = i;
+        }
+    }
+    return heaviest;
+}
+
+/**
+ * Train a corpus exactly and with a count-min sketch, then compare: the
+ * overestimate of every transition against the error bound, and how often
+ * the sketch's top-k list keeps a state's heaviest successor.
+ * @param argc 2 to 4
+ * @param argv corpus path, optional epsilon (0.001), optional top_k (8)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_sketch(int argc, char *argv[]) {
+    double epsilon = argc >= 3 ? strtod(argv[2], NULL) : 0.001;
+    long top_k = argc >= 4 ? strtol(argv[3], NULL, 10) : 8;
+    if (argc < 2 || argc > 4 || !(epsilon > 0 && epsilon < 1) || top_k <= 0) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    FILE *fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return EXIT_FAILURE;
+    }
+    MarkovChain *exact_chain = create_tweets_chain();
+    MarkovChain *sketched_chain = create_tweets_chain();
+    SketchChain *sketch_chain = sketched_chain != NULL
+                                ? create_sketch_chain(sketched_chain, hash_string, epsilon,
+                                                      0.01, (int)top_k) : NULL;
+    int status = EXIT_FAILURE;
+    double start = now_seconds();
+    if (exact_chain != NULL && sketch_chain != NULL && fill_database(fp, -1, exact_chain) == 0) {
+        double exact_time = now_seconds() - start;
+        rewind(fp);
+        start = now_seconds();
+        if (fill_sketch(fp, -1, sketch_chain) == 0) {
+            double sketch_time = now_seconds() - start;
+            uint64_t bound = sketch_error_bound(sketch_chain);
+            size_t edges = 0, over_bound = 0, exact_edges = 0;
+            uint64_t max_error = 0;
+            double total_error = 0;
+            int states = 0, heaviest_kept = 0;
+
+            // Both chains list the states in first-seen order
+            Node *sketched = sketched_chain->database->first;
+            for (Node *exact = exact_chain->database->first; exact != NULL && sketched != NULL;
+                 exact = exact->next, sketched = sketched->next) {
+                MarkovNode *exact_node = exact->data, *sketched_node = sketched->data;
+                edges += (size_t)sketched_node->frequency_list_size;
+                for (int i = 0; i < exact_node->frequency_list_size; i++) {
+                    uint64_t count = get_frequency(exact_node, i);
+                    MarkovNode *successor = index_lookup(sketch_chain->index,
+                                                         exact_node->frequency_list[i]->data);
+                    uint64_t error = sketch_estimate(sketch_chain, sketched_node, successor) - count;
+                    total_error += (double)error;
+                    max_error = error > max_error ? error : max_error;
+                    over_bound += error > bound;
+                    exact_edges++;
+                }
+
+                int heaviest = heaviest_successor(exact_node);
+                if (heaviest != -1) {
+                    states++;
+                    void *data = exact_node->frequency_list[heaviest]->data;
+                    for (int i = 0; i < sketched_node->frequency_list_size; i++) {
+                        if (exact_chain->comp_func(sketched_node->frequency_list[i]->data,
+                                                   data) == 0) {
+                            heaviest_kept++;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            size_t sketch_bytes = sketch_chain->sketch.width *
+                                  (size_t)sketch_chain->sketch.depth * sizeof(uint32_t);
+            printf("exact:  %7zu transitions, %.3f s\n", exact_edges, exact_time);
+            printf("sketch: %7zu transitions kept (top %ld), %zu x %d counters (%zu KB), "
+                   "%.3f s\n", edges, top_k, sketch_chain->sketch.width,
+                   sketch_chain->sketch.depth, sketch_bytes >> 10, sketch_time);
+            printf("overestimate: mean %.3f, max %llu, bound %llu (%zu over), "
+                   "heaviest successor kept for %.2f%% of %d states\n",
+                   exact_edges > 0 ? total_error / (double)exact_edges : 0.0,
+                   (unsigned long long)max_error, (unsigned long long)bound, over_bound,
+                   states > 0 ? 100.0 * heaviest_kept / states : 0.0, states);
+            status = EXIT_SUCCESS;
+        }
+    }
+    fclose(fp);
+    free_sketch_chain(&sketch_chain);
+    free_database(&sketched_chain);
+    free_database(&exact_chain);
+    return status;
+}
+
+/**
+ * Bytes of word data held by a chain's states.
+ * @param markov_chain word chain
+ * @return the total of the string sizes
+ */
+static size_t state_bytes(MarkovChain *markov_chain) {
+    size_t bytes = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        bytes += strlen(current->data->data) + 1;
+    }
+    return bytes;
+}
+
+/**
+ * Bytes a chain's structures request: its database, nodes and successor
+ * arrays, without the states' data and allocator overhead.
+ * @param markov_chain chain to measure
+ * @return the total
+ */
+static size_t structure_bytes(MarkovChain *markov_chain) {
+    size_t bytes = sizeof(MarkovChain) + sizeof(LinkedList);
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *markov_node = current->data;
+        bytes += sizeof(Node) + sizeof(MarkovNode) +
+                 (size_t)markov_node->frequency_capacity *
+                 (sizeof(MarkovNode *) + markov_node->frequency_width);
+    }
+    return bytes;
+}
+
+/**
+ * Bytes of one chain over a shared vocabulary: its structures and its
+ * tables relating its states to vocabulary ids.
+ * @param shared_chain chain to measure
+ * @return the total, without the vocabulary
+ */
+static size_t shared_chain_bytes(SharedChain *shared_chain) {
+    return sizeof(SharedChain) + structure_bytes(shared_chain->markov_chain) +
+           shared_chain->slots_capacity * sizeof(MarkovNode *) +
+           shared_chain->ids_capacity * sizeof(uint32_t) +
+           shared_chain->sentence_capacity * sizeof(MarkovNode *);
+}
+
+/**
+ * Bytes of a vocabulary: its states with their data, index and id table.
+ * @param vocabulary vocabulary to measure
+ * @return the total
+ */
+static size_t vocabulary_bytes(Vocabulary *vocabulary) {
+    return sizeof(Vocabulary) + structure_bytes(vocabulary->states) +
+           state_bytes(vocabulary->states) + sizeof(StateIndex) +
+           vocabulary->index->capacity * (sizeof(MarkovNode *) + sizeof(uint64_t)) +
+           vocabulary->capacity * sizeof(void *);
+}
+
+/**
+ * Merge word chains by value, the way chains with their own states have to
+ * be merged: every state is hashed, compared, and copied when new.
+ * @param into chain to merge into
+ * @param index index of into's states
+ * @param from chain to merge
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int merge_by_value(MarkovChain *into, StateIndex *index, MarkovChain *from) {
+    for (Node *current = from->database->first; current != NULL; current = current->next) {
+        MarkovNode *from_node = current->data;
+        MarkovNode *nodes[2] = {NULL, NULL};
+        for (int i = -1; i < from_node->frequency_list_size; i++) {
+            void *data = i < 0 ? from_node->data : from_node->frequency_list[i]->data;
+            MarkovNode *node = index_lookup(index, data);
+            if (node == NULL) {
+                Node *added = append_to_database(into, data);
+                if (added == NULL || index_insert(index, added->data) != 0) {
+                    return 1;
+                }
+                node = added->data;
+            }
+            nodes[i < 0 ? 0 : 1] = node;
+            if (i >= 0 && add_transition_count(into, nodes[0], nodes[1],
+                                               get_frequency(from_node, i)) != 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Train one chain per contiguous part of a corpus, once with private
+ * states and once over a shared vocabulary, then compare the memory held
+ * per chain (the vocabulary counted once), merging all parts by value and
+ * by id, and comparing the
+ * successor distributions of the first two parts.
+ * @param argc 2 or 3
+ * @param argv corpus path, optional number of chains (8)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_shared(int argc, char *argv[]) {
+    long num_chains = argc >= 3 ? strtol(argv[2], NULL, 10) : 8;
+    if (argc < 2 || argc > 3 || num_chains < 2) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    size_t length;
+    char *text = read_corpus(argv[1], 1, &length);
+    if (text == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    MarkovChain **private_chains = calloc((size_t)num_chains, sizeof(MarkovChain *));
+    SharedChain **shared_chains = calloc((size_t)num_chains, sizeof(SharedChain *));
+    MarkovChain *states = create_tweets_chain();
+    Vocabulary *vocabulary = states != NULL ? create_vocabulary(states, hash_string) : NULL;
+    if (vocabulary == NULL) {
+        free_database(&states);
+    }
+    int status = private_chains != NULL && shared_chains != NULL && vocabulary != NULL
+                 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    // Each chain gets a contiguous run of lines
+    size_t start = 0, private_states = 0, private_words = 0, private_bytes = 0;
+    size_t shared_states = 0, shared_bytes = 0;
+    for (long c = 0; c < num_chains && status == EXIT_SUCCESS; c++) {
+        size_t end = length * (size_t)(c + 1) / (size_t)num_chains;
+        while (end < length && text[end - 1] != '\n') {
+            end++;
+        }
+        private_chains[c] = create_tweets_chain();
+        shared_chains[c] = create_shared_chain(vocabulary);
+        FILE *part = end > start ? fmemopen(text + start, end - start, "r") : NULL;
+        FILE *shared_part = end > start ? fmemopen(text + start, end - start, "r") : NULL;
+        if (private_chains[c] == NULL || shared_chains[c] == NULL || part == NULL ||
+            shared_part == NULL || fill_database(part, -1, private_chains[c]) != 0 ||
+            fill_shared(shared_part, -1, shared_chains[c]) != 0) {
+            status = EXIT_FAILURE;
+        }
+        if (part != NULL) {
+            fclose(part);
+        }
+        if (shared_part != NULL) {
+            fclose(shared_part);
+        }
+        if (status == EXIT_SUCCESS) {
+            private_states += (size_t)private_chains[c]->database->size;
+            private_words += state_bytes(private_chains[c]);
+            private_bytes += structure_bytes(private_chains[c]) + state_bytes(private_chains[c]);
+            shared_states += (size_t)shared_chains[c]->markov_chain->database->size;
+            shared_bytes += shared_chain_bytes(shared_chains[c]);
+        }
+        start = end;
+    }
+
+    if (status == EXIT_SUCCESS) {
+        size_t shared_vocabulary = vocabulary_bytes(vocabulary);
+        printf("private: %ld chains, %zu states, %zu bytes per chain (%zu of words)\n",
+               num_chains, private_states, private_bytes / (size_t)num_chains,
+               private_words / (size_t)num_chains);
+        printf("shared:  %ld chains, %zu states, %zu bytes per chain "
+               "(%zu with its share of the vocabulary)\n", num_chains, shared_states,
+               shared_bytes / (size_t)num_chains,
+               (shared_bytes + shared_vocabulary) / (size_t)num_chains);
+        printf("vocabulary: %d states, %zu bytes (%zu of words)\n",
+               vocabulary->states->database->size, shared_vocabulary,
+               state_bytes(vocabulary->states));
+
+        MarkovChain *merged = create_tweets_chain();
+        StateIndex *index = merged != NULL ? build_state_index(merged, hash_string) : NULL;
+        SharedChain *shared_merged = create_shared_chain(vocabulary);
+        double start_time = now_seconds();
+        for (long c = 0; c < num_chains && index != NULL; c++) {
+            if (merge_by_value(merged, index, private_chains[c]) != 0) {
+                status = EXIT_FAILURE;
+            }
+        }
+        double value_time = now_seconds() - start_time;
+        start_time = now_seconds();
+        for (long c = 0; c < num_chains && shared_merged != NULL; c++) {
+            if (merge_shared_chains(shared_merged, shared_chains[c]) != 0) {
+                status = EXIT_FAILURE;
+            }
+        }
+        double id_time = now_seconds() - start_time;
+        if (index == NULL || shared_merged == NULL) {
+            status = EXIT_FAILURE;
+        }
+
+        if (status == EXIT_SUCCESS) {
+            size_t edges, shared_edges;
+            uint64_t total, shared_total;
+            int merged_states = chain_size(merged, &edges, &total);
+            chain_size(shared_merged->markov_chain, &shared_edges, &shared_total);
+            printf("merge by value: %d states, %zu transitions, %.2f ms\n", merged_states,
+                   edges, value_time * 1e3);
+            printf("merge by id:    %d states, %zu transitions, %.2f ms (%.1fx)%s\n",
+                   shared_merged->markov_chain->database->size, shared_edges, id_time * 1e3,
+                   value_time / id_time,
+                   edges == shared_edges && total == shared_total ? "" : " MISMATCH");
+
+            start_time = now_seconds();
+            double distance = 0;
+            int compared = 0;
+            for (int id = 0; id < vocabulary->states->database->size; id++) {
+                double d = shared_successor_distance(shared_chains[0], shared_chains[1],
+                                                     (uint32_t)id);
+                if (d > 0 && d < 1) {
+                    distance += d;
+                    compared++;
+                }
+            }
+            printf("parts 1 and 2: %d states with successors in both and different, "
+                   "mean distance %.3f, %.2f ms\n", compared,
+                   compared > 0 ? distance / compared : 0.0, (now_seconds() - start_time) * 1e3);
+        }
+        free_shared_chain(&shared_merged);
+        free_state_index(&index);
+        free_database(&merged);
+    }
+
+    for (long c = 0; c < num_chains; c++) {
+        if (private_chains != NULL) {
+            free_database(&private_chains[c]);
+        }
+        if (shared_chains != NULL) {
+            free_shared_chain(&shared_chains[c]);
+        }
+    }
+    free(private_chains);
+    free(shared_chains);
+    release_vocabulary(&vocabulary);
+    free(text);
+    return status;
+}
+
+/**
+ * Calls seen by a counting allocator.
+ */
+typedef struct CallCounts {
+    size_t allocs;
+    size_t reallocs;
+    size_t frees;
+    // blocks handed out and not released yet
+    size_t blocks;
+} CallCounts;
+
+/**
+ * Allocation callback counting its calls, then malloc().
+ */
+static void *counting_alloc(void *context, size_t size) {
+    ((CallCounts *)context)->allocs++;
+    ((CallCounts *)context)->blocks++;
+    return malloc(size);
+}
+
+/**
+ * Resize callback counting its calls, then realloc().
+ */
+static void *counting_realloc(void *context, void *ptr, size_t old_size, size_t new_size) {
+    (void)old_size;
+    ((CallCounts *)context)->reallocs++;
+    ((CallCounts *)context)->blocks += ptr == NULL;
+    return realloc(ptr, new_size);
+}
+
+/**
+ * Release callback counting its calls, then free().
+ */
+static void counting_dealloc(void *context, void *ptr, size_t size) {
+    (void)size;
+    ((CallCounts *)context)->frees++;
+    ((CallCounts *)context)->blocks--;
+    free(ptr);
+}
+
+/**
+ * Train a chain on a corpus through a counting allocator and report what
+ * its nodes, edges and data cost, live and at peak. With a limit, training
+ * stops cleanly at the cap instead.
+ * @param argc 2 or 3
+ * @param argv corpus path, optional limit in KB (none)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_memory(int argc, char *argv[]) {
+    long limit_kb = argc >= 3 ? strtol(argv[2], NULL, 10) : 0;
+    if (argc < 2 || argc > 3 || limit_kb < 0) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    FILE *fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return EXIT_FAILURE;
+    }
+    MarkovChain *markov_chain = create_tweets_chain();
+    CallCounts calls = {0};
+    if (markov_chain == NULL ||
+        set_chain_allocator(markov_chain, counting_alloc, counting_realloc, counting_dealloc,
+                            &calls) != 0) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        fclose(fp);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+    markov_chain->allocator.limit = (size_t)limit_kb << 10;
+
+    double start = now_seconds();
+    int result = fill_database(fp, -1, markov_chain);
+    double seconds = now_seconds() - start;
+    fclose(fp);
+    size_t edges = 0;
+    uint64_t total = 0;
+    chain_size(markov_chain, &edges, &total);
+    const ChainAllocator *allocator = &markov_chain->allocator;
+    printf("%s after %d states, %zu transitions, %.3f s\n",
+           result == 0 ? "trained" : "stopped at the limit", markov_chain->database->size,
+           edges, seconds);
+
+    const char *names[NUM_MEMORY_CATEGORIES] = {"nodes", "edges", "data"};
+    for (int category = 0; category < NUM_MEMORY_CATEGORIES; category++) {
+        printf("%-6s live %8zu KB, peak %8zu KB\n", names[category],
+               allocator->live_bytes[category] >> 10, allocator->peak_bytes[category] >> 10);
+    }
+    printf("total  live %8zu KB, peak %8zu KB, limit %ld KB, %zu refused or failed\n",
+           allocator->total_live_bytes >> 10, allocator->total_peak_bytes >> 10, limit_kb,
+           allocator->failures);
+    printf("calls: %zu alloc, %zu realloc, %zu free\n", calls.allocs, calls.reallocs,
+           calls.frees);
+    free_database(&markov_chain);
+    printf("after free: %zu blocks left\n", calls.blocks);
+    return result == 0 || limit_kb > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Cached first words of the cache benchmark, and the gap between requests
+#define CACHE_BENCH_FIRST_WORDS 8
+#define CACHE_BENCH_GAP_NANOSECONDS 20000
+#define CACHE_BENCH_MAX_LENGTH 20
+
+/**
+ * Order doubles ascending.
+ */
+static int compare_doubles(const void *first, const void *second) {
+    double a = *(const double *)first, b = *(const double *)second;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Print the latency distribution of a run.
+ * @param name run name
+ * @param latencies seconds per request, sorted in place
+ * @param count number of requests
+ */
+static void print_latencies(const char *name, double *latencies, size_t count) {
+    qsort(latencies, count, sizeof(double), compare_doubles);
+    printf("%-7s p50 %6.2f us, p99 %6.2f us, p99.9 %7.2f us, max %8.2f us\n", name,
+           latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6,
+           latencies[count * 999 / 1000] * 1e6, latencies[count - 1] * 1e6);
+}
+
+/**
+ * Time paced requests, a quarter of them for a popular first word and the
+ * rest for random starts, answered by walking on the spot or by a cache.
+ * @param markov_chain chain to walk
+ * @param cache cache to take from, NULL to walk every request
+ * @param first_words popular first words
+ * @param latencies output, seconds per request
+ * @param count number of requests
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int time_requests(MarkovChain *markov_chain, SequenceCache *cache,
+                         MarkovNode *const *first_words, double *latencies, size_t count) {
+    MarkovNode **start_states;
+    int num_start_states;
+    if (collect_start_states(markov_chain, &start_states, &num_start_states) != 0) {
+        return 1;
+    }
+    SequenceBatch batch = {NULL, NULL, 0, 0, 0, 0};
+    MarkovNode *sequence[CACHE_BENCH_MAX_LENGTH];
+    MarkovRandom random;
+    seed_random(&random, 11);
+    struct timespec gap = {0, CACHE_BENCH_GAP_NANOSECONDS};
+
+    int result = 0;
+    for (size_t i = 0; i < count && result == 0; i++) {
+        nanosleep(&gap, NULL);
+        MarkovNode *first_node = i % 4 == 0 ? first_words[i / 4 % CACHE_BENCH_FIRST_WORDS]
+                                            : NULL;
+        double start = now_seconds();
+        if (cache != NULL) {
+            result = cache_take(cache, first_node, sequence, &random) == 0;
+        } else if (first_node != NULL) {
+            result = generate_sequence_batch_r(markov_chain, &first_node, 1,
+                                               CACHE_BENCH_MAX_LENGTH, 1, &batch, &random);
+        } else {
+            result = generate_sequence_batch_r(markov_chain, start_states, num_start_states,
+                                               CACHE_BENCH_MAX_LENGTH, 1, &batch, &random);
+        }
+        latencies[i] = now_seconds() - start;
+    }
+    free_sequence_batch(&batch);
+    free(start_states);
+    return result;
+}
+
+/**
+ * Compare the request latency of walking on the spot with taking from a
+ * sequence cache, for paced requests like an interactive consumer sends.
+ * @param argc 2 to 4
+ * @param argv corpus path, optional refill threads (2), optional number of
+ * requests (20000)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int bench_cache(int argc, char *argv[]) {
+    long num_threads = argc >= 3 ? strtol(argv[2], NULL, 10) : 2;
+    long count = argc >= 4 ? strtol(argv[3], NULL, 10) : 20000;
+    if (argc < 2 || argc > 4 || num_threads <= 0 || num_threads > 256 || count < 1000) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    FILE *fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return EXIT_FAILURE;
+    }
+    MarkovChain *markov_chain = create_tweets_chain();
+    int result = markov_chain == NULL || fill_database(fp, -1, markov_chain) != 0;
+    fclose(fp);
+    double *latencies = malloc((size_t)count * sizeof(double));
+    if (result != 0 || latencies == NULL) {
+        free(latencies);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    // The popular first words are the start states seen most often
+    MarkovNode *first_words[CACHE_BENCH_FIRST_WORDS] = {NULL};
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *candidate = current->data;
+        if (markov_chain->is_last(candidate->data)) {
+            continue;
+        }
+        for (int i = 0; i < CACHE_BENCH_FIRST_WORDS && candidate != NULL; i++) {
+            if (first_words[i] == NULL ||
+                candidate->total_frequency > first_words[i]->total_frequency) {
+                MarkovNode *swap = first_words[i];
+                first_words[i] = candidate;
+                candidate = swap;
+            }
+        }
+    }
+    if (first_words[CACHE_BENCH_FIRST_WORDS - 1] == NULL) {
+        fprintf(stdout, "Error: corpus too small\n");
+        free(latencies);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d states, %ld requests every %d us, max length %d\n",
+           markov_chain->database->size, count, CACHE_BENCH_GAP_NANOSECONDS / 1000,
+           CACHE_BENCH_MAX_LENGTH);
+    result = time_requests(markov_chain, NULL, first_words, latencies, (size_t)count);
+    if (result == 0) {
+        print_latencies("walk", latencies, (size_t)count);
+    }
+
+    SequenceCache *cache = result == 0
+                           ? create_sequence_cache(markov_chain, first_words,
+                                                   CACHE_BENCH_FIRST_WORDS,
+                                                   CACHE_BENCH_MAX_LENGTH, 1024,
+                                                   (int)num_threads, 1)
+                           : NULL;
+    if (cache != NULL) {
+        // Let the refill threads fill the rings first
+        struct timespec warm_up = {0, 100000000};
+        nanosleep(&warm_up, NULL);
+        result = time_requests(markov_chain, cache, first_words, latencies, (size_t)count);
+        if (result == 0) {
+            CacheStats stats;
+            read_cache_stats(cache, &stats);
+            print_latencies("cache", latencies, (size_t)count);
+            printf("%ld refill threads: %zu hits, %zu misses (%.2f%% hit rate), "
+                   "%zu generated, %zu dropped\n", num_threads, stats.hits, stats.misses,
+                   100.0 * (double)stats.hits / (double)(stats.hits + stats.misses),
+                   stats.generated, stats.dropped);
+        }
+    } else {
+        result = 1;
+    }
+
+    free_sequence_cache(&cache);
+    free(latencies);
+    free_database(&markov_chain);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Micro-benchmarks of the library's hot paths.
+ * @param argc num of arguments
+ * @param argv 1) Benchmark name
+ *             2...) Benchmark arguments
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "tokenizer") == 0) {
+        return bench_tokenizer(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "score") == 0) {
+        return bench_score(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "window") == 0) {
+        return bench_window(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "walk") == 0) {
+        return bench_walk(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "lockstep") == 0) {
+        return bench_lockstep(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "lookup") == 0) {
+        return bench_lookup(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "sketch") == 0) {
+        return bench_sketch(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "shared") == 0) {
+        return bench_shared(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "memory") == 0) {
+        return bench_memory(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "cache") == 0) {
+        return bench_cache(argc - 1, argv + 1);
+    }
+    fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,357 @@
+#include "markov_cache.h"
+#include "markov_batch.h"
+
+#include <string.h>
+#include <time.h>
+
+// How long a refill thread sleeps after a pass that found every ring full
+#define REFILL_IDLE_NANOSECONDS 100000
+
+/**
+ * Walk from the given node like generate_sequence_batch_r() does.
+ * @param cache cache of the chain to walk
+ * @param current_node first state of the sequence
+ * @param random stream to draw from
+ * @param sequence output, room for max_length states
+ * @return number of states written
+ */
+static int walk_sequence(const SequenceCache *cache, MarkovNode *current_node,
+                         MarkovRandom *random, MarkovNode **sequence) {
+    int length = 0;
+    while (length < cache->max_length) {
+        sequence[length++] = current_node;
+        if (cache->markov_chain->is_last(current_node->data)) {
+            break;
+        }
+        current_node = get_next_random_node_r(current_node, random);
+        if (current_node == NULL) {
+            break;
+        }
+    }
+    return length;
+}
+
+/**
+ * First state of a ring's next sequence.
+ * @param cache cache of the ring
+ * @param ring ring to generate for
+ * @param random stream to draw from
+ * @return the state
+ */
+static MarkovNode *first_state(const SequenceCache *cache, const CacheRing *ring,
+                               MarkovRandom *random) {
+    if (ring->first_node != NULL) {
+        return ring->first_node;
+    }
+    if (cache->num_start_states == 1) {
+        return cache->start_states[0];
+    }
+    return cache->start_states[next_random(random) % (uint64_t)cache->num_start_states];
+}
+
+/**
+ * Add a sequence at the tail of a ring.
+ * @param ring ring to add to
+ * @param max_length states per slot
+ * @param sequence states of the sequence
+ * @param length number of states
+ * @return 0 on success, 1 if the ring is full
+ */
+static int ring_put(CacheRing *ring, int max_length, MarkovNode *const *sequence, int length) {
+    size_t position = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    size_t slot;
+    while (true) {
+        slot = position & (ring->capacity - 1);
+        size_t sequence_number = __atomic_load_n(&ring->sequences[slot], __ATOMIC_ACQUIRE);
+        if (sequence_number == position) {
+            // Free for this position: claim it, or retry with the new tail
+            if (__atomic_compare_exchange_n(&ring->tail, &position, position + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (sequence_number < position) {
+            return 1; // Still holds the sequence of the previous lap
+        } else {
+            position = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(ring->states + slot * (size_t)max_length, sequence,
+           (size_t)length * sizeof(MarkovNode *));
+    ring->lengths[slot] = length;
+    __atomic_store_n(&ring->sequences[slot], position + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Take the sequence at the head of a ring.
+ * @param ring ring to take from
+ * @param max_length states per slot
+ * @param sequence output, room for max_length states
+ * @return number of states written, 0 if the ring is empty
+ */
+static int ring_take(CacheRing *ring, int max_length, MarkovNode **sequence) {
+    size_t position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    size_t slot;
+    while (true) {
+        slot = position & (ring->capacity - 1);
+        size_t sequence_number = __atomic_load_n(&ring->sequences[slot], __ATOMIC_ACQUIRE);
+        if (sequence_number == position + 1) {
+            // Filled for this position: claim it, or retry with the new head
+            if (__atomic_compare_exchange_n(&ring->head, &position, position + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (sequence_number < position + 1) {
+            return 0; // Not filled yet
+        } else {
+            position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    int length = ring->lengths[slot];
+    memcpy(sequence, ring->states + slot * (size_t)max_length,
+           (size_t)length * sizeof(MarkovNode *));
+    __atomic_store_n(&ring->sequences[slot], position + ring->capacity, __ATOMIC_RELEASE);
+    return length;
+}
+
+/**
+ * Whether a ring looks full. Racy, only a hint to skip generating.
+ * @param ring ring to check
+ * @return true if every slot seemed filled
+ */
+static bool ring_full(CacheRing *ring) {
+    // Head first, so a concurrent take can only make the ring look emptier
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    return tail - head >= ring->capacity;
+}
+
+/**
+ * Refill thread: go around the rings adding a sequence to each one that is
+ * not full, and sleep a little after a pass that added nothing.
+ * @param arg RefillThread of this thread
+ * @return NULL
+ */
+static void *refill_main(void *arg) {
+    RefillThread *self = arg;
+    SequenceCache *cache = self->cache;
+    MarkovNode **sequence = malloc((size_t)cache->max_length * sizeof(MarkovNode *));
+    if (sequence == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    MarkovRandom random;
+    seed_random(&random, cache->seed ^ ((uint64_t)(self->id + 1) << 48));
+    struct timespec idle = {0, REFILL_IDLE_NANOSECONDS};
+
+    while (!__atomic_load_n(&cache->stopping, __ATOMIC_ACQUIRE)) {
+        bool added = false;
+        for (int k = 0; k < cache->num_rings; k++) {
+            // Threads start their passes on different rings
+            CacheRing *ring = &cache->rings[(self->id + k) % cache->num_rings];
+            if (ring_full(ring)) {
+                continue;
+            }
+            int length = walk_sequence(cache, first_state(cache, ring, &random), &random,
+                                       sequence);
+            __atomic_fetch_add(&self->generated, 1, __ATOMIC_RELAXED);
+            if (ring_put(ring, cache->max_length, sequence, length) == 0) {
+                added = true;
+            } else {
+                __atomic_fetch_add(&self->dropped, 1, __ATOMIC_RELAXED);
+            }
+        }
+        if (!added) {
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    free(sequence);
+    return NULL;
+}
+
+/**
+ * Allocate the slots of a ring.
+ * @param ring zeroed ring to set up
+ * @param capacity number of slots, a power of two
+ * @param max_length states per slot
+ * @param first_node state every sequence starts with, NULL for random starts
+ * @return 0 on success, 1 on overflow or allocation error
+ */
+static int init_ring(CacheRing *ring, size_t capacity, int max_length,
+                     MarkovNode *first_node) {
+    if (capacity > SIZE_MAX / sizeof(MarkovNode *) / (size_t)max_length) {
+        return 1;
+    }
+    ring->capacity = capacity;
+    ring->first_node = first_node;
+    ring->sequences = malloc(capacity * sizeof(size_t));
+    ring->lengths = malloc(capacity * sizeof(int));
+    ring->states = malloc(capacity * (size_t)max_length * sizeof(MarkovNode *));
+    if (ring->sequences == NULL || ring->lengths == NULL || ring->states == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    for (size_t slot = 0; slot < capacity; slot++) {
+        ring->sequences[slot] = slot;
+    }
+    return 0;
+}
+
+/**
+ * Stop and join the first num_started refill threads.
+ * @param cache cache of the threads
+ * @param num_started number of threads running
+ */
+static void stop_refill(SequenceCache *cache, int num_started) {
+    __atomic_store_n(&cache->stopping, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < num_started; i++) {
+        pthread_join(cache->threads[i].thread, NULL);
+    }
+    cache->num_threads = 0;
+}
+
+SequenceCache *create_sequence_cache(MarkovChain *markov_chain,
+                                     MarkovNode *const *first_states, int num_first_states,
+                                     int max_length, size_t ring_capacity, int num_threads,
+                                     uint64_t seed) {
+    if (markov_chain == NULL || markov_chain->database == NULL || num_first_states < 0 ||
+        (num_first_states > 0 && first_states == NULL) || max_length <= 0 ||
+        ring_capacity == 0 || ring_capacity > SIZE_MAX / 4 || num_threads <= 0) {
+        return NULL;
+    }
+    int num_states = markov_chain->database->size;
+    for (int i = 0; i < num_first_states; i++) {
+        if (first_states[i] == NULL || first_states[i]->id < 0 ||
+            first_states[i]->id >= num_states) {
+            return NULL;
+        }
+    }
+
+    SequenceCache *cache = calloc(1, sizeof(SequenceCache));
+    if (cache == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    cache->markov_chain = markov_chain;
+    cache->max_length = max_length;
+    cache->num_states = num_states;
+    cache->seed = seed;
+    if (collect_start_states(markov_chain, &cache->start_states,
+                             &cache->num_start_states) != 0 ||
+        cache->num_start_states == 0) {
+        free_sequence_cache(&cache);
+        return NULL;
+    }
+
+    size_t capacity = 1;
+    while (capacity < ring_capacity) {
+        capacity *= 2;
+    }
+    cache->ring_of_state = malloc(((size_t)num_states + 1) * sizeof(int));
+    cache->rings = calloc((size_t)num_first_states + 1, sizeof(CacheRing));
+    cache->threads = calloc((size_t)num_threads, sizeof(RefillThread));
+    if (cache->ring_of_state == NULL || cache->rings == NULL || cache->threads == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free_sequence_cache(&cache);
+        return NULL;
+    }
+    for (int id = 0; id < num_states; id++) {
+        cache->ring_of_state[id] = -1;
+    }
+
+    // Ring 0 for random starts, then one per distinct first state
+    int result = init_ring(&cache->rings[0], capacity, max_length, NULL);
+    cache->num_rings = 1;
+    for (int i = 0; result == 0 && i < num_first_states; i++) {
+        if (cache->ring_of_state[first_states[i]->id] != -1) {
+            continue;
+        }
+        result = init_ring(&cache->rings[cache->num_rings], capacity, max_length,
+                           first_states[i]);
+        cache->ring_of_state[first_states[i]->id] = cache->num_rings++;
+    }
+    if (result != 0) {
+        free_sequence_cache(&cache);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        cache->threads[i].cache = cache;
+        cache->threads[i].id = i;
+        if (pthread_create(&cache->threads[i].thread, NULL, refill_main,
+                           &cache->threads[i]) != 0) {
+            stop_refill(cache, i);
+            free_sequence_cache(&cache);
+            return NULL;
+        }
+    }
+    cache->num_threads = num_threads;
+    return cache;
+}
+
+int cache_take(SequenceCache *cache, MarkovNode *first_node, MarkovNode **sequence,
+               MarkovRandom *random) {
+    if (cache == NULL || sequence == NULL || random == NULL) {
+        return 0;
+    }
+
+    CacheRing *ring = &cache->rings[0];
+    if (first_node != NULL) {
+        int id = first_node->id;
+        int ring_index = id >= 0 && id < cache->num_states ? cache->ring_of_state[id] : -1;
+        if (ring_index == -1 || cache->rings[ring_index].first_node != first_node) {
+            __atomic_fetch_add(&cache->uncached, 1, __ATOMIC_RELAXED);
+            return walk_sequence(cache, first_node, random, sequence);
+        }
+        ring = &cache->rings[ring_index];
+    }
+
+    int length = ring_take(ring, cache->max_length, sequence);
+    if (length > 0) {
+        __atomic_fetch_add(&ring->hits, 1, __ATOMIC_RELAXED);
+        return length;
+    }
+    __atomic_fetch_add(&ring->misses, 1, __ATOMIC_RELAXED);
+    return walk_sequence(cache, first_state(cache, ring, random), random, sequence);
+}
+
+void read_cache_stats(SequenceCache *cache, CacheStats *stats) {
+    *stats = (CacheStats) {0, 0, 0, 0, 0};
+    if (cache == NULL) {
+        return;
+    }
+    for (int i = 0; i < cache->num_rings; i++) {
+        stats->hits += __atomic_load_n(&cache->rings[i].hits, __ATOMIC_RELAXED);
+        stats->misses += __atomic_load_n(&cache->rings[i].misses, __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < cache->num_threads; i++) {
+        stats->generated += __atomic_load_n(&cache->threads[i].generated, __ATOMIC_RELAXED);
+        stats->dropped += __atomic_load_n(&cache->threads[i].dropped, __ATOMIC_RELAXED);
+    }
+    stats->uncached = __atomic_load_n(&cache->uncached, __ATOMIC_RELAXED);
+}
+
+void free_sequence_cache(SequenceCache **cache_ptr) {
+    if (cache_ptr == NULL || *cache_ptr == NULL) {
+        return;
+    }
+
+    SequenceCache *cache = *cache_ptr;
+    stop_refill(cache, cache->num_threads);
+    if (cache->rings != NULL) {
+        for (int i = 0; i < cache->num_rings; i++) {
+            free(cache->rings[i].sequences);
+            free(cache->rings[i].lengths);
+            free(cache->rings[i].states);
+        }
+    }
+    free(cache->rings);
+    free(cache->ring_of_state);
+    free(cache->threads);
+    free(cache->start_states);
+    free(cache);
+    *cache_ptr = NULL;
+}
@@ -0,0 +1,144 @@
+#ifndef _MARKOV_CACHE_H
+#define _MARKOV_CACHE_H
+
+#include "markov_chain.h"
+#include <pthread.h>
+#include <stddef.h> // for size_t
+
+// Bytes kept between fields written by different threads, or written and
+// read-mostly, so they never share a cache line
+#define CACHE_LINE_SIZE 64
+
+/**
+ * Bounded ring of pre-generated sequences of one start condition. Any
+ * number of threads may add and take at once without locking: every slot
+ * carries a sequence number telling whether it is free for the position a
+ * producer claimed, or filled for the position a consumer claimed.
+ */
+typedef struct CacheRing {
+    // next position to take, then next position to fill; both only grow
+    size_t head;
+    char head_padding[CACHE_LINE_SIZE - sizeof(size_t)];
+    size_t tail;
+    char tail_padding[CACHE_LINE_SIZE - sizeof(size_t)];
+    // number of slots, a power of two
+    size_t capacity;
+    // per slot: position + 1 once filled, position + capacity once taken
+    size_t *sequences;
+    int *lengths;
+    // max_length states per slot
+    MarkovNode **states;
+    // state every sequence starts with, NULL for random starts
+    MarkovNode *first_node;
+    char fields_padding[CACHE_LINE_SIZE];
+    // requests answered from the ring, and answered by walking on the spot
+    // because the ring was empty; the padding keeps them off the next
+    // ring's head
+    size_t hits;
+    size_t misses;
+    char counters_padding[CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+} CacheRing;
+
+/**
+ * One background thread of a cache.
+ */
+typedef struct RefillThread {
+    pthread_t thread;
+    struct SequenceCache *cache;
+    int id;
+    // sequences this thread generated, and those it could not add because
+    // their ring filled up meanwhile; only it writes them, and the padding
+    // keeps them off the next thread's
+    size_t generated;
+    size_t dropped;
+    char counters_padding[CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+} RefillThread;
+
+/**
+ * Generation front-end for latency-sensitive consumers. Background threads
+ * keep one ring of sequences per start condition full, so a request is a
+ * copy out of a ring instead of a walk of unpredictable length. The chain
+ * must not change while the cache is alive. Cached sequences come from the
+ * refill threads' own streams, so unlike generate_sequence_batch_r() the
+ * sequences a consumer gets do not depend on its stream alone.
+ */
+typedef struct SequenceCache {
+    MarkovChain *markov_chain;
+    // pool random starts are drawn from, see collect_start_states()
+    MarkovNode **start_states;
+    int num_start_states;
+    int max_length;
+    // ring 0 holds random starts, the others one given first state each
+    CacheRing *rings;
+    int num_rings;
+    // state id -> ring of sequences starting with it, -1 for none
+    int *ring_of_state;
+    int num_states;
+    RefillThread *threads;
+    int num_threads;
+    uint64_t seed;
+    int stopping;
+    char fields_padding[CACHE_LINE_SIZE];
+    // requests for a first state without a ring, always walked on the spot;
+    // written by consumers, so kept off the fields every request reads
+    size_t uncached;
+} SequenceCache;
+
+/**
+ * Totals of a cache's counters.
+ */
+typedef struct CacheStats {
+    size_t hits;
+    size_t misses;
+    size_t uncached;
+    size_t generated;
+    size_t dropped;
+} CacheStats;
+
+/**
+ * Create a cache over a trained chain and start its refill threads.
+ * @param markov_chain chain to generate from, not changed while cached;
+ * state ids must be database positions
+ * @param first_states states to keep a ring of their own for, besides the
+ * ring of random starts; may be NULL if num_first_states is 0
+ * @param num_first_states number of first_states
+ * @param max_length maximum length of each sequence
+ * @param ring_capacity sequences per ring, rounded up to a power of two
+ * @param num_threads number of refill threads, positive
+ * @param seed seed of the refill threads' streams
+ * @return the cache, NULL on invalid arguments, a chain without start
+ * states, allocation error or thread creation failure
+ */
+SequenceCache *create_sequence_cache(MarkovChain *markov_chain,
+                                     MarkovNode *const *first_states, int num_first_states,
+                                     int max_length, size_t ring_capacity, int num_threads,
+                                     uint64_t seed);
+
+/**
+ * Get one sequence: the oldest one of the ring of its start condition, or
+ * on a miss one walked on the spot like generate_sequence_batch_r() walks.
+ * Safe to call from many threads at once; never blocks.
+ * @param cache cache to take from
+ * @param first_node state to start with, NULL for a random start
+ * @param sequence output, room for max_length states
+ * @param random the caller's stream, used on a miss only
+ * @return number of states written, 0 on invalid arguments
+ */
+int cache_take(SequenceCache *cache, MarkovNode *first_node, MarkovNode **sequence,
+               MarkovRandom *random);
+
+/**
+ * Read the counters of all rings, summed.
+ * @param cache cache to read
+ * @param stats output
+ */
+void read_cache_stats(SequenceCache *cache, CacheStats *stats);
+
+/**
+ * Stop the refill threads, free the cache and set the pointer to NULL.
+ * No consumer may be using it.
+ * @param cache_ptr cache to free
+ */
+void free_sequence_cache(SequenceCache **cache_ptr);
+
+#endif /* _MARKOV_CACHE_H */
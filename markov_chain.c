@@ -1,5 +1,6 @@
 #include "markov_chain.h"
 
+#include <limits.h> // for INT_MAX
 #include <string.h>
 
 /**
@@ -12,6 +13,48 @@ int get_random_number(int max_number)
     return rand() % max_number;
 }
 
+MarkovChain *create_markov_chain(print_func print_func, comp_func comp_func,
+                                 free_data free_data, copy_func copy_func,
+                                 is_last is_last) {
+    MarkovChain *markov_chain = malloc(sizeof(MarkovChain));
+    if (markov_chain == NULL) {
+        return NULL;
+    }
+
+    markov_chain->database = malloc(sizeof(LinkedList));
+    if (markov_chain->database == NULL) {
+        free(markov_chain);
+        return NULL;
+    }
+    *markov_chain->database = (LinkedList) {NULL, NULL, 0};
+
+    markov_chain->print_func = print_func;
+    markov_chain->comp_func = comp_func;
+    markov_chain->free_data = free_data;
+    markov_chain->copy_func = copy_func;
+    markov_chain->is_last = is_last;
+    init_chain_allocator(&markov_chain->allocator, NULL, NULL, NULL, NULL);
+    return markov_chain;
+}
+
+int set_chain_allocator(MarkovChain *markov_chain, alloc_func alloc_func,
+                        realloc_func realloc_func, dealloc_func dealloc_func,
+                        void *context) {
+    if (markov_chain == NULL || markov_chain->database->size != 0) {
+        return 1;
+    }
+    init_chain_allocator(&markov_chain->allocator, alloc_func, realloc_func, dealloc_func,
+                         context);
+    return 0;
+}
+
+void *copy_chain_data(MarkovChain *markov_chain, void *data) {
+    ChainAllocator *previous = swap_data_allocator(&markov_chain->allocator);
+    void *copy = markov_chain->copy_func(data);
+    swap_data_allocator(previous);
+    return copy;
+}
+
 Node* get_node_from_database(MarkovChain *markov_chain, void *data_ptr) {
     // Check for NULL inputs
     if (markov_chain == NULL || data_ptr == NULL || markov_chain->database == NULL) {
@@ -56,109 +99,540 @@ Node* add_to_database(MarkovChain *markov_chain, void *data_ptr) {
         return existing_node;
     }
 
-    // Create a new MarkovNode for the data
-    MarkovNode *new_markov_node = malloc(sizeof(MarkovNode));
-    if (new_markov_node == NULL) {
+    return append_to_database(markov_chain, data_ptr);
+}
+
+Node* append_to_database(MarkovChain *markov_chain, void *data_ptr) {
+    if (markov_chain == NULL || data_ptr == NULL) {
+        return NULL;
+    }
+
+    // Create a new MarkovNode for the data, and the link holding it
+    ChainAllocator *allocator = &markov_chain->allocator;
+    MarkovNode *new_markov_node = chain_alloc(allocator, MEMORY_NODES, sizeof(MarkovNode));
+    Node *new_node = chain_alloc(allocator, MEMORY_NODES, sizeof(Node));
+    if (new_markov_node == NULL || new_node == NULL) {
         // Memory allocation failed
         fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        chain_free(allocator, MEMORY_NODES, new_markov_node, sizeof(MarkovNode));
+        chain_free(allocator, MEMORY_NODES, new_node, sizeof(Node));
         return NULL;
     }
 
     // Allocate memory for the string data and copy it
-    new_markov_node->data = markov_chain->copy_func(data_ptr);
+    new_markov_node->data = copy_chain_data(markov_chain, data_ptr);
     if (new_markov_node->data == NULL) {
         // Memory allocation failed
         fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
-        free(new_markov_node); // Clean up the previously allocated memory
+        chain_free(allocator, MEMORY_NODES, new_markov_node, sizeof(MarkovNode));
+        chain_free(allocator, MEMORY_NODES, new_node, sizeof(Node));
         return NULL;
     }
 
-    // Initialize frequency list to NULL (empty) and size to 0
+    // Initialize frequency list to NULL (empty) and size to 0, counters
+    // start at the narrowest width
     new_markov_node->frequency_list = NULL;
+    new_markov_node->frequencies = NULL;
+    new_markov_node->total_frequency = 0;
     new_markov_node->frequency_list_size = 0;
+    new_markov_node->frequency_capacity = 0;
+    new_markov_node->id = markov_chain->database->size;
+    new_markov_node->frequency_width = 1;
+
+    // Add the new MarkovNode to the end of the linked list
+    new_node->data = new_markov_node;
+    append_node(markov_chain->database, new_node);
+    return new_node;
+}
 
-    // Add the new MarkovNode to the linked list
-    int add_result = add(markov_chain->database, new_markov_node);
 
-    if (add_result != 0) {
-        // Failed to add the node to the database
-        free(new_markov_node->data);  // Clean up allocated memory
-        free(new_markov_node);
-        return NULL;
+/**
+ * Largest value a counter of the given byte width can hold.
+ * @param width counter width in bytes: 1, 2, 4 or 8
+ * @return maximal counter value
+ */
+static uint64_t max_frequency(unsigned char width) {
+    switch (width) {
+        case 1: return UINT8_MAX;
+        case 2: return UINT16_MAX;
+        case 4: return UINT32_MAX;
+        default: return UINT64_MAX;
     }
+}
 
-    // Return the newly added node
-    return markov_chain->database->last; // Assuming the node was added at the end
+/**
+ * Read one counter out of a packed counter array.
+ * @param frequencies packed counters
+ * @param width counter width in bytes
+ * @param index counter to read
+ * @return the counter's value
+ */
+static uint64_t read_frequency(const void *frequencies, unsigned char width, int index) {
+    switch (width) {
+        case 1: return ((const uint8_t *)frequencies)[index];
+        case 2: return ((const uint16_t *)frequencies)[index];
+        case 4: return ((const uint32_t *)frequencies)[index];
+        default: return ((const uint64_t *)frequencies)[index];
+    }
 }
 
+/**
+ * Write one counter into a packed counter array. The value must fit width.
+ * @param frequencies packed counters
+ * @param width counter width in bytes
+ * @param index counter to write
+ * @param value new value of the counter
+ */
+static void write_frequency(void *frequencies, unsigned char width, int index, uint64_t value) {
+    switch (width) {
+        case 1: ((uint8_t *)frequencies)[index] = (uint8_t)value; break;
+        case 2: ((uint16_t *)frequencies)[index] = (uint16_t)value; break;
+        case 4: ((uint32_t *)frequencies)[index] = (uint32_t)value; break;
+        default: ((uint64_t *)frequencies)[index] = value; break;
+    }
+}
 
-int add_node_to_frequency_list(MarkovNode *first_node, MarkovNode *second_node) {
-    // Check for NULL inputs
-    if (first_node == NULL || second_node == NULL) {
+/**
+ * Re-encode all counters of the node with a wider counter width.
+ * @param allocator allocator of the node's chain
+ * @param markov_node node whose counters to widen
+ * @param width the new width, larger than the current one
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int widen_frequencies(ChainAllocator *allocator, MarkovNode *markov_node,
+                             unsigned char width) {
+    // Only reached once a counter exists, so the capacity is never 0
+    size_t count = (size_t)markov_node->frequency_capacity;
+    void *widened = chain_alloc(allocator, MEMORY_EDGES, count * width);
+    if (widened == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
         return 1;
     }
 
-    // Case 1: first_node has no frequency list yet (empty list)
-    if (first_node->frequency_list == NULL) {
-        // Allocate memory for the first item in frequency list
-        first_node->frequency_list = malloc(sizeof(MarkovNodeFrequency));
-        if (first_node->frequency_list == NULL) {
-            // Memory allocation failed
-            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
-            return 1;
-        }
+    for (int i = 0; i < markov_node->frequency_list_size; i++) {
+        write_frequency(widened, width, i,
+                        read_frequency(markov_node->frequencies,
+                                       markov_node->frequency_width, i));
+    }
 
-        // Initialize the first entry
-        first_node->frequency_list[0].markov_node = second_node;
-        first_node->frequency_list[0].frequency = 1;
+    chain_free(allocator, MEMORY_EDGES, markov_node->frequencies,
+               count * markov_node->frequency_width);
+    markov_node->frequencies = widened;
+    markov_node->frequency_width = width;
+    return 0;
+}
 
-        // We need to track how many items are in the frequency list
-        // You might want to add a field to MarkovNode for this, for example:
-        // first_node->frequency_list_size = 1;
-        first_node->frequency_list_size = 1;
+/**
+ * Add amount to the counter at the given index, promoting the node's counter
+ * width first if the new value doesn't fit.
+ * @param allocator allocator of the node's chain
+ * @param markov_node node owning the counter
+ * @param index counter to increase
+ * @param amount value to add
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int increase_frequency(ChainAllocator *allocator, MarkovNode *markov_node, int index,
+                              uint64_t amount) {
+    uint64_t value = read_frequency(markov_node->frequencies,
+                                    markov_node->frequency_width, index);
+    // Saturate instead of wrapping; 2^64 transitions is out of reach anyway
+    uint64_t updated = (UINT64_MAX - value < amount) ? UINT64_MAX : value + amount;
+
+    unsigned char width = markov_node->frequency_width;
+    while (updated > max_frequency(width)) {
+        width *= 2;
+    }
+    if (width != markov_node->frequency_width &&
+        widen_frequencies(allocator, markov_node, width) != 0) {
+        return 1;
+    }
+
+    write_frequency(markov_node->frequencies, markov_node->frequency_width, index, updated);
+    markov_node->total_frequency += updated - value;
+    return 0;
+}
 
-        return 0; // Success
+/**
+ * Double the capacity of both successor arrays of the node (one slot for
+ * the first successor). Both new arrays are allocated before either old one
+ * is released, so a failure leaves the node untouched.
+ * @param allocator allocator of the node's chain
+ * @param markov_node node whose arrays to grow
+ * @return 0 on success, 1 in case of allocation error, the node being left
+ * as is
+ */
+static int grow_frequency_list(ChainAllocator *allocator, MarkovNode *markov_node) {
+    size_t capacity = (size_t)markov_node->frequency_capacity;
+    size_t new_capacity = capacity == 0 ? 1 : 2 * capacity;
+    if (new_capacity > INT_MAX) {
+        return 1;
+    }
+    size_t width = markov_node->frequency_width;
+    MarkovNode **new_list = chain_alloc(allocator, MEMORY_EDGES,
+                                        new_capacity * sizeof(MarkovNode *));
+    void *new_frequencies = new_list != NULL
+                            ? chain_alloc(allocator, MEMORY_EDGES, new_capacity * width)
+                            : NULL;
+    if (new_frequencies == NULL) {
+        chain_free(allocator, MEMORY_EDGES, new_list, new_capacity * sizeof(MarkovNode *));
+        return 1;
     }
 
-    // Case 2: first_node already has a frequency list
-    // We need to find out how many items are in the frequency list
+    size_t size = (size_t)markov_node->frequency_list_size;
+    if (size > 0) {
+        memcpy(new_list, markov_node->frequency_list, size * sizeof(MarkovNode *));
+        memcpy(new_frequencies, markov_node->frequencies, size * width);
+    }
+    chain_free(allocator, MEMORY_EDGES, markov_node->frequency_list,
+               capacity * sizeof(MarkovNode *));
+    chain_free(allocator, MEMORY_EDGES, markov_node->frequencies, capacity * width);
+    markov_node->frequency_list = new_list;
+    markov_node->frequencies = new_frequencies;
+    markov_node->frequency_capacity = (int)new_capacity;
+    return 0;
+}
+
+uint64_t get_frequency(const MarkovNode *markov_node, int index) {
+    if (markov_node == NULL || index < 0 || index >= markov_node->frequency_list_size) {
+        return 0;
+    }
+    return read_frequency(markov_node->frequencies, markov_node->frequency_width, index);
+}
+
+int add_node_to_frequency_list(MarkovChain *markov_chain, MarkovNode *first_node,
+                               MarkovNode *second_node) {
+    return add_transition_count(markov_chain, first_node, second_node, 1);
+}
+
+int add_transition_count(MarkovChain *markov_chain, MarkovNode *first_node,
+                         MarkovNode *second_node, uint64_t count) {
+    // Check for NULL inputs
+    if (markov_chain == NULL || first_node == NULL || second_node == NULL || count == 0) {
+        return 1;
+    }
+    ChainAllocator *allocator = &markov_chain->allocator;
 
     // Iterate through the existing frequency list to find if second_node is already in it
-    int i;
     int frequency_list_size = first_node->frequency_list_size;
-
-    for (i = 0; i < frequency_list_size; i++) {
-        if (first_node->frequency_list[i].markov_node == second_node) {
+    for (int i = 0; i < frequency_list_size; i++) {
+        if (first_node->frequency_list[i] == second_node) {
             // Found the node, update its frequency
-            first_node->frequency_list[i].frequency++;
-            return 0; // Success
+            return increase_frequency(allocator, first_node, i, count);
         }
     }
 
     // If we get here, second_node is not yet in the frequency list
-    // We need to resize the list to add one more item
-    MarkovNodeFrequency *new_list = realloc(first_node->frequency_list,
-                                          (frequency_list_size + 1) * sizeof(MarkovNodeFrequency));
-    if (new_list == NULL) {
-        // Memory reallocation failed
+    // We need to grow both arrays to add one more item, unless there is
+    // room left
+    if (frequency_list_size == first_node->frequency_capacity &&
+        grow_frequency_list(allocator, first_node) != 0) {
         fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
         return 1;
     }
 
-    // Update the list pointer to the reallocated memory
-    first_node->frequency_list = new_list;
+    // Add the new node to the end of the list with an empty counter, then
+    // count it like an existing one so the width gets promoted if needed
+    first_node->frequency_list[frequency_list_size] = second_node;
+    write_frequency(first_node->frequencies, first_node->frequency_width,
+                    frequency_list_size, 0);
+    first_node->frequency_list_size++;
+
+    if (increase_frequency(allocator, first_node, frequency_list_size, count) != 0) {
+        // Widening failed; drop the empty entry so the list stays as it was
+        first_node->frequency_list_size--;
+        return 1;
+    }
+    return 0;
+}
 
-    // Add the new node to the end of the list
-    first_node->frequency_list[frequency_list_size].markov_node = second_node;
-    first_node->frequency_list[frequency_list_size].frequency = 1;
+int set_successor(MarkovChain *markov_chain, MarkovNode *first_node, int index,
+                  MarkovNode *second_node, uint64_t count) {
+    if (markov_chain == NULL || first_node == NULL || second_node == NULL || count == 0 ||
+        index < 0 || index >= first_node->frequency_list_size) {
+        return 1;
+    }
 
-    // Increment the size of the frequency list
-    first_node->frequency_list_size++;
+    unsigned char width = first_node->frequency_width;
+    while (count > max_frequency(width)) {
+        width *= 2;
+    }
+    if (width != first_node->frequency_width &&
+        widen_frequencies(&markov_chain->allocator, first_node, width) != 0) {
+        return 1;
+    }
 
-    return 0; // Success
+    uint64_t value = read_frequency(first_node->frequencies,
+                                    first_node->frequency_width, index);
+    write_frequency(first_node->frequencies, first_node->frequency_width, index, count);
+    first_node->frequency_list[index] = second_node;
+    first_node->total_frequency = first_node->total_frequency - value + count;
+    return 0;
 }
 
+int remove_transition_count(MarkovNode *first_node, MarkovNode *second_node,
+                            uint64_t count) {
+    if (first_node == NULL || second_node == NULL || count == 0) {
+        return 1;
+    }
+
+    for (int i = 0; i < first_node->frequency_list_size; i++) {
+        if (first_node->frequency_list[i] != second_node) {
+            continue;
+        }
+        uint64_t value = read_frequency(first_node->frequencies,
+                                        first_node->frequency_width, i);
+        if (value < count) {
+            return 1;
+        }
+        first_node->total_frequency -= count;
+        if (value > count) {
+            write_frequency(first_node->frequencies, first_node->frequency_width, i,
+                            value - count);
+            return 0;
+        }
 
+        // Counter reached 0: close the gap in both arrays. The arrays keep
+        // their capacity, the counters keep their width.
+        int tail = first_node->frequency_list_size - i - 1;
+        memmove(first_node->frequency_list + i, first_node->frequency_list + i + 1,
+                (size_t)tail * sizeof(MarkovNode *));
+        unsigned char *frequencies = first_node->frequencies;
+        memmove(frequencies + (size_t)i * first_node->frequency_width,
+                frequencies + (size_t)(i + 1) * first_node->frequency_width,
+                (size_t)tail * first_node->frequency_width);
+        first_node->frequency_list_size--;
+        return 0;
+    }
+    return 1;
+}
+
+int remove_isolated_states(MarkovChain *markov_chain, int first_state) {
+    if (markov_chain == NULL || markov_chain->database == NULL) {
+        return 0;
+    }
+
+    // The id field doubles as the "is someone's successor" mark
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        current->data->id = 0;
+    }
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        for (int i = 0; i < current->data->frequency_list_size; i++) {
+            current->data->frequency_list[i]->id = 1;
+        }
+    }
+
+    int removed = 0, id = 0;
+    Node *previous = NULL;
+    for (Node *current = markov_chain->database->first; current != NULL;) {
+        MarkovNode *markov_node = current->data;
+        if (id < first_state || markov_node->id != 0 || markov_node->frequency_list_size > 0) {
+            markov_node->id = id++;
+            previous = current;
+            current = current->next;
+            continue;
+        }
+
+        current = current->next;
+        Node *unlinked = unlink_after(markov_chain->database, previous);
+        chain_free(&markov_chain->allocator, MEMORY_NODES, unlinked, sizeof(Node));
+        free_markov_node(markov_chain, markov_node);
+        removed++;
+    }
+    return removed;
+}
+
+/**
+ * Get a uniformly random number in [0, max_number) for 64-bit bounds. Bounds
+ * that fit in an int go through get_random_number() so seeded runs keep
+ * producing the exact same sequences.
+ * @param max_number exclusive upper bound, must be positive
+ * @return Random number
+ */
+static uint64_t get_random_frequency(uint64_t max_number) {
+    if (max_number <= (uint64_t)RAND_MAX && max_number <= INT32_MAX) {
+        return (uint64_t)get_random_number((int)max_number);
+    }
+
+    // Stitch 15 bits at a time, the least RAND_MAX guarantees
+    uint64_t random_value = 0;
+    for (int bits = 0; bits < 64; bits += 15) {
+        random_value = (random_value << 15) ^ (uint64_t)(rand() & 0x7FFF);
+    }
+    return random_value % max_number;
+}
+
+/**
+ * Returns a random first node from the database that isn't a sentence-ending word
+ * @param markov_chain The markov chain
+ * @return A random MarkovNode that isn't a sentence-ending word
+ */
+MarkovNode* get_first_random_node(MarkovChain *markov_chain) {
+    if (markov_chain == NULL || markov_chain->database == NULL ||
+        markov_chain->database->size == 0) {
+        return NULL;
+    }
+
+    Node *current = NULL;
+    int random_index;
+
+    // Keep selecting random nodes until we find one that doesn't end with a period
+    do {
+        // Generate a random index between 0 and size-1
+        random_index = get_random_number(markov_chain->database->size);
+
+        // Get the node at the random index
+        current = markov_chain->database->first;
+        for (int i = 0; i < random_index && current != NULL; i++) {
+            current = current->next;
+        }
+
+        // Get the MarkovNode from the current node
+        if (current != NULL) {
+            MarkovNode *markov_node = (MarkovNode *)current->data;
+            // Check if this node should be last in sequence
+            if (markov_node != NULL && markov_node->data != NULL) {
+                if (!markov_chain->is_last(markov_node->data)) {
+                    return markov_node;
+                }
+            }
+        } else {
+            // This should never happen if the database is properly set up
+            return NULL;
+        }
+
+        // If we're here, the selected node was a sentence-ending word
+        // We'll try again with a new random index
+    } while (1); // Keep trying until we find a suitable node
+
+    // This line should never be reached
+    return NULL;
+}
+
+/**
+ * Returns a random next node from the given node's frequency list
+ * The random selection is weighted by the frequencies of each following word
+ * @param cur_markov_node Current MarkovNode to find a successor for
+ * @return A random MarkovNode from the frequency list
+ */
+MarkovNode* get_next_random_node(MarkovNode *cur_markov_node) {
+    // Check for NULL input or empty frequency list
+    if (cur_markov_node == NULL ||
+        cur_markov_node->frequency_list == NULL ||
+        cur_markov_node->frequency_list_size == 0) {
+        return NULL;
+    }
+
+    // Generate a random number between 0 and total_frequency - 1
+    uint64_t random_num = get_random_frequency(cur_markov_node->total_frequency);
+
+    // Select a word based on weighted probabilities
+    return get_successor_at(cur_markov_node, random_num);
+}
+
+/**
+ * Scan one counter width for the first running sum passing the draw,
+ * leaving index there, or at frequency_list_size if none does.
+ */
+#define FIND_SUCCESSOR(type, markov_node, draw, index) do { \
+        const type *counters = (const type *)(markov_node)->frequencies; \
+        uint64_t cumulative_frequency = 0; \
+        for ((index) = 0; (index) < (markov_node)->frequency_list_size; (index)++) { \
+            cumulative_frequency += counters[index]; \
+            if ((draw) < cumulative_frequency) { \
+                break; \
+            } \
+        } \
+    } while (0)
+
+MarkovNode *get_successor_at(const MarkovNode *markov_node, uint64_t draw) {
+    if (markov_node == NULL) {
+        return NULL;
+    }
+
+    // Dispatch on the counter width once per node, not once per counter
+    int index;
+    switch (markov_node->frequency_width) {
+        case 1: FIND_SUCCESSOR(uint8_t, markov_node, draw, index); break;
+        case 2: FIND_SUCCESSOR(uint16_t, markov_node, draw, index); break;
+        case 4: FIND_SUCCESSOR(uint32_t, markov_node, draw, index); break;
+        default: FIND_SUCCESSOR(uint64_t, markov_node, draw, index); break;
+    }
+    return index < markov_node->frequency_list_size ? markov_node->frequency_list[index] : NULL;
+}
+
+void seed_random(MarkovRandom *random, uint64_t seed) {
+    random->state = seed;
+}
+
+uint64_t next_random(MarkovRandom *random) {
+    uint64_t z = (random->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+MarkovNode* get_next_random_node_r(MarkovNode *cur_markov_node, MarkovRandom *random) {
+    if (cur_markov_node == NULL || random == NULL ||
+        cur_markov_node->frequency_list_size == 0) {
+        return NULL;
+    }
+
+    uint64_t random_num = next_random(random) % cur_markov_node->total_frequency;
+    return get_successor_at(cur_markov_node, random_num);
+}
+
+/**
+ * Generates a tweet starting from the given first_node
+ * Continues to select random next words based on the Markov chain probabilities
+ * until reaching a sentence-ending word or max_length
+ * @param markov_chain The markov chain
+ * @param first_node The first word in the tweet
+ * @param max_length Maximum number of words to include in the tweet
+ */
+void generate_random_sequence(MarkovChain *markov_chain, MarkovNode *first_node, int max_length) {
+    if (markov_chain == NULL || first_node == NULL || max_length <= 0) {
+        return;
+    }
+
+    MarkovNode *current_node = first_node;
+    int word_count = 0;
+
+    // Generate and print the sequence
+    while (word_count < max_length) {
+        // Print the current node's data
+        markov_chain->print_func(current_node->data);
+        word_count++;
+
+        // Check if this should be the last node in the sequence
+        if (markov_chain->is_last(current_node->data)) {
+            break;
+        }
+
+        // Get the next node
+        current_node = get_next_random_node(current_node);
+        if (current_node == NULL) {
+            break; // No next node available
+        }
+
+        // Print a space separator before the next word
+        printf(" ");
+    }
+}
+
+void free_markov_node(MarkovChain *markov_chain, MarkovNode *markov_node) {
+    if (markov_node->data != NULL) {
+        markov_chain->free_data(markov_node->data);
+    }
+    ChainAllocator *allocator = &markov_chain->allocator;
+    size_t capacity = (size_t)markov_node->frequency_capacity;
+    chain_free(allocator, MEMORY_EDGES, markov_node->frequency_list,
+               capacity * sizeof(MarkovNode *));
+    chain_free(allocator, MEMORY_EDGES, markov_node->frequencies,
+               capacity * markov_node->frequency_width);
+    chain_free(allocator, MEMORY_NODES, markov_node, sizeof(MarkovNode));
+}
 
 /**
  * Free markov_chain and all of its content from memory
@@ -180,18 +654,9 @@ void free_database(MarkovChain **ptr_chain) {
             MarkovNode *markov_node = (MarkovNode *)current->data;
 
             if (markov_node != NULL) {
-                // Free the string data
-                if (markov_node->data != NULL) {
-                    chain->free_data(markov_node->data);
-                }
-
-                // Free the frequency list
-                if (markov_node->frequency_list != NULL) {
-                    free(markov_node->frequency_list);
-                }
-
-                // Free the MarkovNode itself
-                free(markov_node);
+                // Free the data, the frequency list and its counters, and
+                // the MarkovNode itself
+                free_markov_node(chain, markov_node);
             }
 
             // Move to the next node
@@ -199,7 +664,7 @@ void free_database(MarkovChain **ptr_chain) {
             current = current->next;
 
             // Free the Node wrapper
-            free(temp);
+            chain_free(&chain->allocator, MEMORY_NODES, temp, sizeof(Node));
         }
 
         // Free the LinkedList
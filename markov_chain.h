@@ -2,9 +2,11 @@
 #define _MARKOV_CHAIN_H
 
 #include "linked_list.h"
+#include "markov_allocator.h"
 #include <stdio.h>  // For printf(), sscanf()
 #include <stdlib.h> // For exit(), malloc()
 #include <stdbool.h> // for bool
+#include <stdint.h> // for uint64_t
 
 //Don't change the macros!
 #define ALLOCATION_ERROR_MESSAGE "Allocation failure: Failed to allocate"\
@@ -55,16 +57,30 @@ typedef bool (*is_last)(void *data);
 
 typedef struct MarkovNode {
     void *data;
-    struct MarkovNodeFrequency *frequency_list;
-    // any other fields you need
+    // successor states, in the order they were first seen after this state
+    struct MarkovNode **frequency_list;
+    // one counter per successor, frequency_width bytes each (see below)
+    void *frequencies;
+    // sum of all counters, kept 64-bit so hot states never wrap around
+    uint64_t total_frequency;
     int frequency_list_size;
+    // number of slots allocated in both successor arrays, drawn from the
+    // chain's allocator
+    int frequency_capacity;
+    // position of the state in the database, 0 for the first state added
+    int id;
+    // byte width of each counter: 1, 2, 4 or 8. Starts at 1 and is promoted
+    // for the whole node once any of its counters outgrows it.
+    unsigned char frequency_width;
 } MarkovNode;
 
-typedef struct MarkovNodeFrequency {
-    struct MarkovNode *markov_node;
-    int frequency;
-    // any other fields you need
-} MarkovNodeFrequency;
+/**
+ * State of a reentrant random number stream (splitmix64). Unlike rand(),
+ * every thread can own one, and a given seed always yields the same stream.
+ */
+typedef struct MarkovRandom {
+    uint64_t state;
+} MarkovRandom;
 
 /* DO NOT ADD or CHANGE variable names in this struct */
 typedef struct MarkovChain {
@@ -76,8 +92,50 @@ typedef struct MarkovChain {
     free_data free_data;
     copy_func copy_func;
     is_last is_last;
+
+    // Source of the states' nodes, successor arrays and, through
+    // markov_data_alloc(), copies; malloc() unless set_chain_allocator() is
+    // called. Its accounting and limit may be read and set directly.
+    ChainAllocator allocator;
 } MarkovChain;
 
+/**
+ * Allocate a markov_chain with an empty database and the given operations.
+ * @param print_func how to print a state
+ * @param comp_func how to compare two states
+ * @param free_data how to free a state copy
+ * @param copy_func how to copy a state into the chain
+ * @param is_last whether a state ends a sequence
+ * @return the new chain, NULL in case of allocation error. Free it with
+ * free_database().
+ */
+MarkovChain *create_markov_chain(print_func print_func, comp_func comp_func,
+                                 free_data free_data, copy_func copy_func,
+                                 is_last is_last);
+
+/**
+ * Draw the chain's allocations from the given callbacks instead of malloc().
+ * The accounting and the limit start over.
+ * @param markov_chain chain to change, with an empty database
+ * @param alloc_func how to allocate, NULL to go back to malloc()
+ * @param realloc_func how to resize
+ * @param dealloc_func how to release
+ * @param context passed to every callback
+ * @return 0 on success, 1 if the chain already has states
+ */
+int set_chain_allocator(MarkovChain *markov_chain, alloc_func alloc_func,
+                        realloc_func realloc_func, dealloc_func dealloc_func,
+                        void *context);
+
+/**
+ * Copy a state with the chain's copy_func, markov_data_alloc() drawing from
+ * the chain's allocator meanwhile.
+ * @param markov_chain chain the copy is for
+ * @param data state to copy
+ * @return the copy, NULL in case of allocation error
+ */
+void *copy_chain_data(MarkovChain *markov_chain, void *data);
+
 /**
  * Check if data_ptr is in database. If so, return the markov_node wrapping
  * it in the markov_chain, otherwise return NULL.
@@ -97,17 +155,97 @@ Node *get_node_from_database(MarkovChain *markov_chain, void *data_ptr);
  */
 Node *add_to_database(MarkovChain *markov_chain, void *data_ptr);
 
+/**
+ * Create a new node for data_ptr at the end of markov_chain's database
+ * without looking for an equal state first, for callers that keep their own
+ * index of the states (see markov_index.h). The state must not be in the
+ * database yet.
+ * @param markov_chain the chain to add to
+ * @param data_ptr the state to add, copied with copy_func
+ * @return node wrapping the new state, NULL in case of allocation error
+ */
+Node *append_to_database(MarkovChain *markov_chain, void *data_ptr);
+
 /**
  * Add the second markov_node to the frequency list of the first markov_node.
  * If already in list, update its frequency value.
+ * @param markov_chain the chain both nodes belong to, whose allocator the
+ * frequency list grows from
  * @param first_node
  * @param second_node
  * @return success/failure: 0 if the process was successful, 1 if in
  * case of allocation error.
  */
-int add_node_to_frequency_list(MarkovNode *first_node,
+int add_node_to_frequency_list(MarkovChain *markov_chain, MarkovNode *first_node,
                                MarkovNode *second_node);
 
+/**
+ * Add count transitions from first_node to second_node at once, as if
+ * add_node_to_frequency_list() was called count times.
+ * @param markov_chain the chain both nodes belong to
+ * @param first_node
+ * @param second_node
+ * @param count number of transitions to add, positive
+ * @return success/failure: 0 if the process was successful, 1 if in
+ * case of allocation error or invalid arguments.
+ */
+int add_transition_count(MarkovChain *markov_chain, MarkovNode *first_node,
+                         MarkovNode *second_node, uint64_t count);
+
+/**
+ * Take back count transitions from first_node to second_node. The successor
+ * is dropped from the frequency list once its counter reaches 0; the order
+ * of the remaining successors is kept.
+ * @param first_node
+ * @param second_node
+ * @param count number of transitions to remove, at most the current count
+ * @return 0 on success, 1 if the transition was not seen count times
+ */
+int remove_transition_count(MarkovNode *first_node, MarkovNode *second_node,
+                            uint64_t count);
+
+/**
+ * Overwrite one entry of a frequency list: its successor and its counter.
+ * For counters kept outside the chain (see markov_sketch.h), which may
+ * replace a successor or lower a count; total_frequency follows.
+ * @param markov_chain the chain both nodes belong to
+ * @param first_node node whose frequency list to change
+ * @param index position in first_node->frequency_list
+ * @param second_node the successor to put there, not elsewhere in the list
+ * @param count its transition count, positive
+ * @return 0 on success, 1 in case of allocation error or invalid arguments
+ */
+int set_successor(MarkovChain *markov_chain, MarkovNode *first_node, int index,
+                  MarkovNode *second_node, uint64_t count);
+
+/**
+ * Remove the states that have no successor and are no one's successor,
+ * freeing them like free_database() does. Ids of the remaining states are
+ * renumbered in database order.
+ * @param markov_chain the chain to clean up
+ * @param first_state database position of the first state that may be
+ * removed; the states before it are always kept
+ * @return the number of removed states
+ */
+int remove_isolated_states(MarkovChain *markov_chain, int first_state);
+
+/**
+ * Get the number of times the successor at the given index of the node's
+ * frequency list was seen after the node.
+ * @param markov_node node whose frequency list to read
+ * @param index position in markov_node->frequency_list
+ * @return the transition count, 0 if index is out of range
+ */
+uint64_t get_frequency(const MarkovNode *markov_node, int index);
+
+/**
+ * Free a node of the chain and everything it owns, but not the database
+ * link holding it.
+ * @param markov_chain chain the node belongs to
+ * @param markov_node node to free
+ */
+void free_markov_node(MarkovChain *markov_chain, MarkovNode *markov_node);
+
 /**
  * Free markov_chain and all of it's content from memory
  * @param chain_ptr markov_chain to free
@@ -129,6 +267,41 @@ MarkovNode *get_first_random_node(MarkovChain *markov_chain);
  */
 MarkovNode *get_next_random_node(MarkovNode *cur_markov_node);
 
+/**
+ * Find the successor a draw falls on: the first one whose running sum of
+ * counters, in frequency list order, passes the draw. The choice every
+ * get_next_random_node*() makes once it has drawn.
+ * @param markov_node node to choose from
+ * @param draw value in [0, markov_node->total_frequency)
+ * @return MarkovNode of the chosen state, NULL if the draw is out of range
+ */
+MarkovNode *get_successor_at(const MarkovNode *markov_node, uint64_t draw);
+
+/**
+ * Seed a random stream.
+ * @param random stream to seed
+ * @param seed any value; equal seeds give equal streams
+ */
+void seed_random(MarkovRandom *random, uint64_t seed);
+
+/**
+ * Draw the next 64 random bits of a stream.
+ * @param random stream to draw from
+ * @return random value
+ */
+uint64_t next_random(MarkovRandom *random);
+
+/**
+ * Reentrant version of get_next_random_node(): choose the next node by its
+ * occurrence frequency, drawing from the given stream instead of rand().
+ * Safe to call from many threads on a chain nobody modifies.
+ * @param cur_markov_node MarkovNode to choose from
+ * @param random stream to draw from
+ * @return MarkovNode of the chosen state, NULL if it has no successors
+ */
+MarkovNode *get_next_random_node_r(MarkovNode *cur_markov_node,
+                                   MarkovRandom *random);
+
 /**
  * Receive markov_chain, generate and print random sequences out of it. The
  * sequence most have at least 2 words in it.
@@ -0,0 +1,610 @@
+#include "markov_external.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // for unlink
+
+// Smallest transition buffer, whatever the budget
+#define MIN_BUFFER_RECORDS 1024
+// Smallest and largest block a run is read or written in during the merge
+#define MIN_RUN_BUFFER 4096
+#define MAX_RUN_BUFFER (1 << 20)
+// Most runs one merge reads at once; more are first merged into longer runs
+#define MERGE_FAN_IN 16
+// Template of the run file names under the spill directory
+#define RUN_FILE_TEMPLATE "/markov_run_XXXXXX"
+
+/**
+ * Order transitions by (from, to), the order of the runs.
+ */
+static int compare_edges(const void *first, const void *second) {
+    const EdgeRecord *a = first, *b = second;
+    if (a->from != b->from) {
+        return a->from < b->from ? -1 : 1;
+    }
+    if (a->to != b->to) {
+        return a->to < b->to ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * Order the successors of one state by first appearance, the order
+ * add_node_to_frequency_list() gives them.
+ */
+static int compare_first_seen(const void *first, const void *second) {
+    const EdgeRecord *a = first, *b = second;
+    return (a->first_seen > b->first_seen) - (a->first_seen < b->first_seen);
+}
+
+/**
+ * Fold a record into one for the same pair.
+ * @param into record to update
+ * @param record record of the same pair
+ */
+static void combine_edges(EdgeRecord *into, const EdgeRecord *record) {
+    into->count += record->count;
+    if (record->first_seen < into->first_seen) {
+        into->first_seen = record->first_seen;
+    }
+}
+
+/**
+ * Sort the buffer and combine the records of the same pair.
+ * @param builder builder whose buffer to compact
+ */
+static void compact_buffer(ExternalBuilder *builder) {
+    if (builder->buffer_size == 0) {
+        return;
+    }
+    qsort(builder->buffer, builder->buffer_size, sizeof(EdgeRecord), compare_edges);
+    size_t size = 1;
+    for (size_t i = 1; i < builder->buffer_size; i++) {
+        if (compare_edges(&builder->buffer[size - 1], &builder->buffer[i]) == 0) {
+            combine_edges(&builder->buffer[size - 1], &builder->buffer[i]);
+        } else {
+            builder->buffer[size++] = builder->buffer[i];
+        }
+    }
+    builder->buffer_size = size;
+}
+
+/**
+ * Create an anonymous run file, gone from the directory as soon as created.
+ * Runs are written and read in whole blocks, so the file is unbuffered.
+ * @param builder builder with the spill directory
+ * @return the file opened for update, NULL on error
+ */
+static FILE *open_run_file(const ExternalBuilder *builder) {
+    FILE *fp = NULL;
+    if (builder->spill_directory == NULL) {
+        fp = tmpfile();
+    } else {
+        size_t length = strlen(builder->spill_directory);
+        char *path = malloc(length + sizeof(RUN_FILE_TEMPLATE));
+        if (path == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return NULL;
+        }
+        memcpy(path, builder->spill_directory, length);
+        memcpy(path + length, RUN_FILE_TEMPLATE, sizeof(RUN_FILE_TEMPLATE));
+
+        int fd = mkstemp(path);
+        if (fd != -1) {
+            unlink(path);
+            fp = fdopen(fd, "w+b");
+            if (fp == NULL) {
+                close(fd);
+            }
+        }
+        free(path);
+    }
+
+    // setvbuf() is only allowed before the first I/O on the file
+    if (fp != NULL && setvbuf(fp, NULL, _IONBF, 0) != 0) {
+        fclose(fp);
+        fp = NULL;
+    }
+    return fp;
+}
+
+/**
+ * Write the compacted buffer to a new run and empty it.
+ * @param builder builder to spill
+ * @return 0 on success, 1 on allocation or write error
+ */
+static int spill_buffer(ExternalBuilder *builder) {
+    if (builder->num_runs == builder->runs_capacity) {
+        size_t new_capacity = builder->runs_capacity > 0 ? builder->runs_capacity * 2 : 8;
+        FILE **new_runs = realloc(builder->runs, new_capacity * sizeof(FILE *));
+        if (new_runs == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return 1;
+        }
+        builder->runs = new_runs;
+        builder->runs_capacity = new_capacity;
+    }
+
+    FILE *run = open_run_file(builder);
+    if (run == NULL) {
+        fprintf(stderr, "Error: could not create a run file\n");
+        return 1;
+    }
+    builder->runs[builder->num_runs++] = run;
+
+    if (fwrite(builder->buffer, sizeof(EdgeRecord), builder->buffer_size, run) !=
+        builder->buffer_size) {
+        fprintf(stderr, "Error: could not write a run file\n");
+        return 1;
+    }
+    builder->buffer_size = 0;
+    return 0;
+}
+
+/**
+ * Make room in a full buffer: compact it first, and only spill it when
+ * compacting did not free at least half of it, so a corpus with few
+ * distinct pairs never touches the disk.
+ * @param builder builder whose buffer is full
+ * @return 0 on success, 1 on allocation or write error
+ */
+static int flush_buffer(ExternalBuilder *builder) {
+    compact_buffer(builder);
+    if (builder->buffer_size <= builder->buffer_capacity / 2) {
+        return 0;
+    }
+    return spill_buffer(builder);
+}
+
+ExternalBuilder *create_external_builder(MarkovChain *markov_chain, hash_func hash_func,
+                                         size_t memory_budget, const char *spill_directory) {
+    if (markov_chain == NULL || markov_chain->database == NULL || hash_func == NULL) {
+        return NULL;
+    }
+
+    ExternalBuilder *builder = calloc(1, sizeof(ExternalBuilder));
+    if (builder == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    builder->markov_chain = markov_chain;
+    builder->spill_directory = spill_directory;
+    builder->memory_budget = memory_budget;
+    builder->buffer_capacity = memory_budget / sizeof(EdgeRecord);
+    if (builder->buffer_capacity < MIN_BUFFER_RECORDS) {
+        builder->buffer_capacity = MIN_BUFFER_RECORDS;
+    }
+
+    builder->buffer = malloc(builder->buffer_capacity * sizeof(EdgeRecord));
+    builder->index = build_state_index(markov_chain, hash_func);
+    if (builder->buffer == NULL || builder->index == NULL) {
+        if (builder->buffer == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        }
+        free_external_builder(&builder);
+        return NULL;
+    }
+    return builder;
+}
+
+int external_add_sentence(ExternalBuilder *builder, void **data, int length) {
+    if (builder == NULL || data == NULL || length < 0) {
+        return 1;
+    }
+
+    if ((size_t)length > builder->sentence_capacity) {
+        MarkovNode **new_sentence = realloc(builder->sentence,
+                                            (size_t)length * sizeof(MarkovNode *));
+        if (new_sentence == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return 1;
+        }
+        builder->sentence = new_sentence;
+        builder->sentence_capacity = (size_t)length;
+    }
+    if (index_add_batch(builder->index, builder->markov_chain, data, (size_t)length,
+                        builder->sentence) != 0) {
+        return 1;
+    }
+
+    for (int i = 0; i + 1 < length; i++) {
+        if (builder->buffer_size == builder->buffer_capacity && flush_buffer(builder) != 0) {
+            return 1;
+        }
+        EdgeRecord *record = &builder->buffer[builder->buffer_size++];
+        record->from = (uint32_t)builder->sentence[i]->id;
+        record->to = (uint32_t)builder->sentence[i + 1]->id;
+        record->count = 1;
+        record->first_seen = builder->num_transitions++;
+    }
+    return 0;
+}
+
+/**
+ * Cursor over one sorted run of the merge, either a spilled file read a
+ * block at a time or the buffer still in memory.
+ */
+typedef struct RunCursor {
+    FILE *fp;
+    // records not consumed yet, of the buffer or of the block last read
+    const EdgeRecord *records;
+    size_t remaining;
+    // file runs only
+    EdgeRecord *block;
+    size_t block_capacity;
+    EdgeRecord head;
+} RunCursor;
+
+/**
+ * Move a cursor to its next record.
+ * @param cursor cursor to advance
+ * @param has_head set to whether there is a next record
+ * @return 0 on success, 1 on read error
+ */
+static int advance_cursor(RunCursor *cursor, int *has_head) {
+    if (cursor->remaining == 0 && cursor->fp != NULL) {
+        cursor->remaining = fread(cursor->block, sizeof(EdgeRecord), cursor->block_capacity,
+                                  cursor->fp);
+        cursor->records = cursor->block;
+        if (cursor->remaining < cursor->block_capacity && ferror(cursor->fp)) {
+            return 1;
+        }
+    }
+    *has_head = cursor->remaining > 0;
+    if (*has_head) {
+        cursor->head = *cursor->records++;
+        cursor->remaining--;
+    }
+    return 0;
+}
+
+/**
+ * Point cursors at the start of file runs.
+ * @param cursors cursors to set
+ * @param runs runs to read
+ * @param num_runs number of runs
+ * @param blocks num_runs blocks of block_capacity records, one per run
+ * @param block_capacity records per block
+ * @return 0 on success, 1 on seek error
+ */
+static int open_cursors(RunCursor *cursors, FILE **runs, size_t num_runs, EdgeRecord *blocks,
+                        size_t block_capacity) {
+    for (size_t i = 0; i < num_runs; i++) {
+        cursors[i].fp = runs[i];
+        cursors[i].records = NULL;
+        cursors[i].remaining = 0;
+        cursors[i].block = blocks + i * block_capacity;
+        cursors[i].block_capacity = block_capacity;
+        if (fseek(runs[i], 0, SEEK_SET) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Restore the heap order below position i.
+ * @param heap cursors ordered by head
+ * @param size number of cursors in the heap
+ * @param i position to sift down from
+ */
+static void sift_down(RunCursor **heap, size_t size, size_t i) {
+    while (1) {
+        size_t smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && compare_edges(&heap[left]->head, &heap[smallest]->head) < 0) {
+            smallest = left;
+        }
+        if (right < size && compare_edges(&heap[right]->head, &heap[smallest]->head) < 0) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        RunCursor *swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+/**
+ * Receives the merged records in (from, to) order, pairs unique.
+ * @param target what the record is added to
+ * @param record next merged record
+ * @return 0 on success, 1 on failure
+ */
+typedef int (*add_record)(void *target, const EdgeRecord *record);
+
+/**
+ * Writes the merged records of an intermediate pass to a new run.
+ */
+typedef struct RunWriter {
+    FILE *fp;
+    EdgeRecord *block;
+    size_t size;
+    size_t capacity;
+} RunWriter;
+
+/**
+ * Write the pending block of a run writer.
+ * @param writer writer to flush
+ * @return 0 on success, 1 on write error
+ */
+static int flush_run(RunWriter *writer) {
+    if (fwrite(writer->block, sizeof(EdgeRecord), writer->size, writer->fp) != writer->size) {
+        fprintf(stderr, "Error: could not write a run file\n");
+        return 1;
+    }
+    writer->size = 0;
+    return 0;
+}
+
+/**
+ * add_record for a RunWriter.
+ */
+static int add_to_run(void *target, const EdgeRecord *record) {
+    RunWriter *writer = target;
+    if (writer->size == writer->capacity && flush_run(writer) != 0) {
+        return 1;
+    }
+    writer->block[writer->size++] = *record;
+    return 0;
+}
+
+/**
+ * Collects the merged successors of one state and writes its list.
+ */
+typedef struct ListWriter {
+    FILE *fp;
+    EdgeRecord *group;
+    uint32_t *targets;
+    uint64_t *counts;
+    size_t size;
+    size_t capacity;
+    // states whose list is written
+    uint32_t next_state;
+} ListWriter;
+
+/**
+ * Write the lists of the states up to end, the pending group being the one
+ * of the first of them.
+ * @param writer writer of the output
+ * @param end first state not to write
+ * @return 0 on success, 1 on write error
+ */
+static int write_lists(ListWriter *writer, uint32_t end) {
+    if (writer->next_state < end) {
+        // Successors in first-appearance order, like the in-memory build
+        if (writer->size > 1) {
+            qsort(writer->group, writer->size, sizeof(EdgeRecord), compare_first_seen);
+        }
+        for (size_t i = 0; i < writer->size; i++) {
+            writer->targets[i] = writer->group[i].to;
+            writer->counts[i] = writer->group[i].count;
+        }
+        if (write_transition_list(writer->fp, writer->targets, writer->counts,
+                                  (int)writer->size) != 0) {
+            return 1;
+        }
+        writer->size = 0;
+        writer->next_state++;
+    }
+    for (; writer->next_state < end; writer->next_state++) {
+        if (write_transition_list(writer->fp, NULL, NULL, 0) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * add_record for a ListWriter: add the record to the pending group, writing
+ * the groups before it.
+ */
+static int add_to_list(void *target, const EdgeRecord *record) {
+    ListWriter *writer = target;
+    if (record->from != writer->next_state && write_lists(writer, record->from) != 0) {
+        return 1;
+    }
+    if (writer->size == writer->capacity) {
+        size_t new_capacity = writer->capacity > 0 ? writer->capacity * 2 : 64;
+        EdgeRecord *new_group = realloc(writer->group, new_capacity * sizeof(EdgeRecord));
+        if (new_group != NULL) {
+            writer->group = new_group;
+        }
+        uint32_t *new_targets = realloc(writer->targets, new_capacity * sizeof(uint32_t));
+        if (new_targets != NULL) {
+            writer->targets = new_targets;
+        }
+        uint64_t *new_counts = realloc(writer->counts, new_capacity * sizeof(uint64_t));
+        if (new_counts != NULL) {
+            writer->counts = new_counts;
+        }
+        if (new_group == NULL || new_targets == NULL || new_counts == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return 1;
+        }
+        writer->capacity = new_capacity;
+    }
+    writer->group[writer->size++] = *record;
+    return 0;
+}
+
+/**
+ * K-way merge runs, combining the records of a pair spread over several
+ * runs.
+ * @param cursors one cursor per run
+ * @param num_cursors number of runs
+ * @param add what receives the merged records
+ * @param target what the records are added to
+ * @return 0 on success, 1 on read, write or allocation error
+ */
+static int merge_runs(RunCursor *cursors, size_t num_cursors, add_record add, void *target) {
+    RunCursor **heap = malloc((num_cursors > 0 ? num_cursors : 1) * sizeof(RunCursor *));
+    if (heap == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < num_cursors; i++) {
+        int has_head;
+        if (advance_cursor(&cursors[i], &has_head) != 0) {
+            free(heap);
+            return 1;
+        }
+        if (has_head) {
+            heap[size++] = &cursors[i];
+        }
+    }
+    for (size_t i = size / 2; i-- > 0;) {
+        sift_down(heap, size, i);
+    }
+
+    EdgeRecord pending;
+    int has_pending = 0;
+    while (size > 0) {
+        RunCursor *top = heap[0];
+        if (has_pending && compare_edges(&pending, &top->head) == 0) {
+            combine_edges(&pending, &top->head);
+        } else {
+            if (has_pending && add(target, &pending) != 0) {
+                free(heap);
+                return 1;
+            }
+            pending = top->head;
+            has_pending = 1;
+        }
+
+        int has_head;
+        if (advance_cursor(top, &has_head) != 0) {
+            free(heap);
+            return 1;
+        }
+        if (!has_head) {
+            heap[0] = heap[--size];
+        }
+        sift_down(heap, size, 0);
+    }
+    free(heap);
+
+    if (has_pending && add(target, &pending) != 0) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Merge the MERGE_FAN_IN oldest runs into one new run, placed last so the
+ * passes take every run in turn.
+ * @param builder builder with more than MERGE_FAN_IN runs
+ * @param blocks MERGE_FAN_IN + 1 blocks of block_capacity records
+ * @param block_capacity records per block
+ * @return 0 on success, 1 on read, write or allocation error
+ */
+static int merge_oldest_runs(ExternalBuilder *builder, EdgeRecord *blocks,
+                             size_t block_capacity) {
+    RunWriter writer = {open_run_file(builder), blocks + MERGE_FAN_IN * block_capacity, 0,
+                        block_capacity};
+    if (writer.fp == NULL) {
+        fprintf(stderr, "Error: could not create a run file\n");
+        return 1;
+    }
+
+    RunCursor cursors[MERGE_FAN_IN];
+    if (open_cursors(cursors, builder->runs, MERGE_FAN_IN, blocks, block_capacity) != 0 ||
+        merge_runs(cursors, MERGE_FAN_IN, add_to_run, &writer) != 0 || flush_run(&writer) != 0) {
+        fclose(writer.fp);
+        return 1;
+    }
+
+    for (size_t i = 0; i < MERGE_FAN_IN; i++) {
+        fclose(builder->runs[i]);
+    }
+    builder->num_runs -= MERGE_FAN_IN;
+    memmove(builder->runs, builder->runs + MERGE_FAN_IN, builder->num_runs * sizeof(FILE *));
+    builder->runs[builder->num_runs++] = writer.fp;
+    return 0;
+}
+
+int external_write_chain(ExternalBuilder *builder, FILE *fp, write_data write_data) {
+    if (builder == NULL || fp == NULL || write_data == NULL) {
+        return 1;
+    }
+
+    compact_buffer(builder);
+
+    // The budget not taken by the buffer is shared by the blocks of a merge:
+    // one per run read, and the output of an intermediate pass
+    size_t buffer_bytes = builder->buffer_size * sizeof(EdgeRecord);
+    size_t run_buffer = builder->memory_budget > buffer_bytes ?
+                        (builder->memory_budget - buffer_bytes) / (MERGE_FAN_IN + 1) : 0;
+    if (run_buffer < MIN_RUN_BUFFER) {
+        run_buffer = MIN_RUN_BUFFER;
+    } else if (run_buffer > MAX_RUN_BUFFER) {
+        run_buffer = MAX_RUN_BUFFER;
+    }
+    size_t block_capacity = run_buffer / sizeof(EdgeRecord);
+    EdgeRecord *blocks = malloc((MERGE_FAN_IN + 1) * block_capacity * sizeof(EdgeRecord));
+    if (blocks == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+
+    // Intermediate passes until the last merge reads at most MERGE_FAN_IN
+    // runs, the buffer counting as one
+    size_t in_memory = builder->buffer_size > 0 ? 1 : 0;
+    int result = 0;
+    while (result == 0 && builder->num_runs + in_memory > MERGE_FAN_IN) {
+        result = merge_oldest_runs(builder, blocks, block_capacity);
+    }
+
+    RunCursor cursors[MERGE_FAN_IN];
+    size_t num_cursors = builder->num_runs + in_memory;
+    if (result == 0 &&
+        open_cursors(cursors, builder->runs, builder->num_runs, blocks, block_capacity) != 0) {
+        result = 1;
+    }
+    if (in_memory) {
+        RunCursor *cursor = &cursors[builder->num_runs];
+        cursor->fp = NULL;
+        cursor->records = builder->buffer;
+        cursor->remaining = builder->buffer_size;
+    }
+
+    ListWriter writer = {fp, NULL, NULL, NULL, 0, 0, 0};
+    if (result == 0 && write_chain_states(builder->markov_chain, fp, write_data) != 0) {
+        result = 1;
+    }
+    if (result == 0 && merge_runs(cursors, num_cursors, add_to_list, &writer) != 0) {
+        result = 1;
+    }
+    // Flush the last group and the states after it without successors
+    if (result == 0 && (write_lists(&writer, (uint32_t)builder->markov_chain->database->size) != 0 ||
+                        ferror(fp))) {
+        result = 1;
+    }
+
+    free(writer.group);
+    free(writer.targets);
+    free(writer.counts);
+    free(blocks);
+    return result;
+}
+
+void free_external_builder(ExternalBuilder **builder_ptr) {
+    if (builder_ptr == NULL || *builder_ptr == NULL) {
+        return;
+    }
+
+    ExternalBuilder *builder = *builder_ptr;
+    for (size_t i = 0; i < builder->num_runs; i++) {
+        fclose(builder->runs[i]);
+    }
+    free(builder->runs);
+    free(builder->buffer);
+    free(builder->sentence);
+    free_state_index(&builder->index);
+    free(builder);
+    *builder_ptr = NULL;
+}
@@ -0,0 +1,90 @@
+#ifndef _MARKOV_EXTERNAL_H
+#define _MARKOV_EXTERNAL_H
+
+#include "markov_index.h"
+#include "markov_io.h"
+#include <stddef.h> // for size_t
+
+/**
+ * One transition of an external build: from -> to seen count times, first
+ * at the first_seen-th transition of the input.
+ */
+typedef struct EdgeRecord {
+    uint32_t from;
+    uint32_t to;
+    uint64_t count;
+    uint64_t first_seen;
+} EdgeRecord;
+
+/**
+ * Builds a chain file from input larger than RAM. Only the vocabulary is
+ * held in memory (states without transitions, with a hash index); the
+ * transitions are collected in a buffer of bounded size, which is sorted,
+ * merged and spilled to a run file whenever it fills up. Finishing k-way
+ * merges the runs straight into the frequency lists of the output, first
+ * merging them into fewer, longer runs while there are more than one merge
+ * reads at once, so disk I/O is sequential everywhere.
+ */
+typedef struct ExternalBuilder {
+    // vocabulary, states only
+    MarkovChain *markov_chain;
+    StateIndex *index;
+    // states of the sentence being added
+    MarkovNode **sentence;
+    size_t sentence_capacity;
+    // transitions not spilled yet
+    EdgeRecord *buffer;
+    size_t buffer_size;
+    size_t buffer_capacity;
+    // spilled runs, each sorted by (from, to) with unique pairs
+    FILE **runs;
+    size_t num_runs;
+    size_t runs_capacity;
+    // directory of the run files, NULL for tmpfile()
+    const char *spill_directory;
+    size_t memory_budget;
+    uint64_t num_transitions;
+} ExternalBuilder;
+
+/**
+ * Create a builder.
+ * @param markov_chain empty chain that receives the vocabulary, owned by the
+ * caller; its callbacks are the ones of the chain being built
+ * @param hash_func hash consistent with markov_chain->comp_func
+ * @param memory_budget bytes for transition buffering and merge buffers
+ * @param spill_directory existing directory for the run files, NULL for the
+ * system temporary directory; run files are deleted as soon as created
+ * @return the builder, NULL in case of allocation error or invalid arguments
+ */
+ExternalBuilder *create_external_builder(MarkovChain *markov_chain, hash_func hash_func,
+                                         size_t memory_budget, const char *spill_directory);
+
+/**
+ * Add one sentence like fill_database() does: its states in order of first
+ * appearance, and the transitions between consecutive states.
+ * @param builder builder to add to
+ * @param data states of the sentence
+ * @param length number of states
+ * @return 0 on success, 1 in case of allocation or spill error
+ */
+int external_add_sentence(ExternalBuilder *builder, void **data, int length);
+
+/**
+ * Write the chain file: the states, then the merged runs as frequency
+ * lists. The output is the file save_chain() writes for the chain
+ * fill_database() builds from the same input, byte for byte.
+ * @param builder builder with every sentence added
+ * @param fp file opened for binary writing
+ * @param write_data how to write one state
+ * @return 0 on success, 1 on read, write or allocation error
+ */
+int external_write_chain(ExternalBuilder *builder, FILE *fp, write_data write_data);
+
+/**
+ * Free the builder, its buffers and run files, and set the pointer to NULL.
+ * The vocabulary chain is left to the caller.
+ * @param builder_ptr builder to free
+ */
+void free_external_builder(ExternalBuilder **builder_ptr);
+
+#endif /* _MARKOV_EXTERNAL_H */
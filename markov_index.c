@@ -0,0 +1,243 @@
+#include "markov_index.h"
+
+#define MIN_INDEX_CAPACITY 16
+// Keys in flight per group of index_lookup_batch()
+#define LOOKUP_GROUP_SIZE 16
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/**
+ * Allocate empty slot arrays of the given capacity.
+ * @param index index to set up
+ * @param capacity number of slots, a power of two
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int allocate_slots(StateIndex *index, size_t capacity) {
+    MarkovNode **slots = calloc(capacity, sizeof(MarkovNode *));
+    uint64_t *hashes = malloc(capacity * sizeof(uint64_t));
+    if (slots == NULL || hashes == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(slots);
+        free(hashes);
+        return 1;
+    }
+    index->slots = slots;
+    index->hashes = hashes;
+    index->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Put a node in the first free slot of its probe sequence.
+ * @param index index with room for the node
+ * @param hash hash of the node's data
+ * @param markov_node node to place
+ */
+static void place_node(StateIndex *index, uint64_t hash, MarkovNode *markov_node) {
+    size_t mask = index->capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    while (index->slots[slot] != NULL) {
+        slot = (slot + 1) & mask;
+    }
+    index->slots[slot] = markov_node;
+    index->hashes[slot] = hash;
+}
+
+/**
+ * Double the capacity and rehash, using the cached hashes.
+ * @param index index to grow
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int grow_index(StateIndex *index) {
+    MarkovNode **old_slots = index->slots;
+    uint64_t *old_hashes = index->hashes;
+    size_t old_capacity = index->capacity;
+    if (allocate_slots(index, old_capacity * 2) != 0) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i] != NULL) {
+            place_node(index, old_hashes[i], old_slots[i]);
+        }
+    }
+    free(old_slots);
+    free(old_hashes);
+    return 0;
+}
+
+StateIndex *build_state_index(MarkovChain *markov_chain, hash_func hash_func) {
+    if (markov_chain == NULL || markov_chain->database == NULL || hash_func == NULL) {
+        return NULL;
+    }
+
+    StateIndex *index = malloc(sizeof(StateIndex));
+    if (index == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+
+    // Keep the load factor at or below 1/2
+    size_t capacity = MIN_INDEX_CAPACITY;
+    while (capacity < 2 * (size_t)markov_chain->database->size) {
+        capacity *= 2;
+    }
+    index->size = 0;
+    index->hash_func = hash_func;
+    index->comp_func = markov_chain->comp_func;
+    if (allocate_slots(index, capacity) != 0) {
+        free(index);
+        return NULL;
+    }
+
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        place_node(index, hash_func(current->data->data), current->data);
+        index->size++;
+    }
+    return index;
+}
+
+MarkovNode *index_lookup_hashed(const StateIndex *index, uint64_t hash, void *data) {
+    size_t mask = index->capacity - 1;
+    for (size_t slot = (size_t)hash & mask; index->slots[slot] != NULL;
+         slot = (slot + 1) & mask) {
+        if (index->hashes[slot] == hash &&
+            index->comp_func(index->slots[slot]->data, data) == 0) {
+            return index->slots[slot];
+        }
+    }
+    return NULL;
+}
+
+MarkovNode *index_lookup(const StateIndex *index, void *data) {
+    if (index == NULL || data == NULL) {
+        return NULL;
+    }
+    return index_lookup_hashed(index, index->hash_func(data), data);
+}
+
+/**
+ * Look up one group of keys, one probe step at a time across the group.
+ * @param index index to look in
+ * @param keys keys of the group
+ * @param hashes output, the hash of every key
+ * @param count number of keys, at most LOOKUP_GROUP_SIZE
+ * @param results output nodes, NULL where not indexed
+ */
+static void lookup_group(const StateIndex *index, void *const *keys, uint64_t *hashes,
+                         size_t count, MarkovNode **results) {
+    size_t mask = index->capacity - 1;
+    size_t slots[LOOKUP_GROUP_SIZE];
+
+    // Hash everything, then prefetch every home slot
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = index->hash_func(keys[i]);
+        slots[i] = (size_t)hashes[i] & mask;
+        PREFETCH(&index->hashes[slots[i]]);
+        PREFETCH(&index->slots[slots[i]]);
+    }
+
+    // Find the first slot with a matching hash (or the empty end of the
+    // probe) and prefetch its node
+    for (size_t i = 0; i < count; i++) {
+        size_t slot = slots[i];
+        while (index->slots[slot] != NULL && index->hashes[slot] != hashes[i]) {
+            slot = (slot + 1) & mask;
+        }
+        slots[i] = slot;
+        results[i] = index->slots[slot];
+        if (results[i] != NULL) {
+            PREFETCH(results[i]);
+        }
+    }
+
+    // Prefetch the data the candidates are compared with
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] != NULL) {
+            PREFETCH(results[i]->data);
+        }
+    }
+
+    // Compare; a hash collision falls back to the plain probe
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] != NULL && index->comp_func(results[i]->data, keys[i]) != 0) {
+            results[i] = index_lookup_hashed(index, hashes[i], keys[i]);
+        }
+    }
+}
+
+void index_lookup_batch(const StateIndex *index, void *const *keys, size_t num_keys,
+                        MarkovNode **results) {
+    if (index == NULL || keys == NULL || results == NULL) {
+        return;
+    }
+    uint64_t hashes[LOOKUP_GROUP_SIZE];
+    for (size_t first = 0; first < num_keys; first += LOOKUP_GROUP_SIZE) {
+        size_t count = num_keys - first < LOOKUP_GROUP_SIZE ? num_keys - first
+                                                            : LOOKUP_GROUP_SIZE;
+        lookup_group(index, keys + first, hashes, count, results + first);
+    }
+}
+
+int index_add_batch(StateIndex *index, MarkovChain *markov_chain, void *const *keys,
+                    size_t num_keys, MarkovNode **results) {
+    if (index == NULL || markov_chain == NULL || keys == NULL || results == NULL) {
+        return 1;
+    }
+    uint64_t hashes[LOOKUP_GROUP_SIZE];
+    for (size_t first = 0; first < num_keys; first += LOOKUP_GROUP_SIZE) {
+        size_t count = num_keys - first < LOOKUP_GROUP_SIZE ? num_keys - first
+                                                            : LOOKUP_GROUP_SIZE;
+        lookup_group(index, keys + first, hashes, count, results + first);
+
+        // Misses are rare once a chain is warm; add them one by one, looking
+        // again since an earlier key of the group may have added the state
+        for (size_t i = 0; i < count; i++) {
+            if (results[first + i] != NULL) {
+                continue;
+            }
+            results[first + i] = index_lookup_hashed(index, hashes[i], keys[first + i]);
+            if (results[first + i] != NULL) {
+                continue;
+            }
+            if (2 * (index->size + 1) > index->capacity && grow_index(index) != 0) {
+                return 1;
+            }
+            Node *node = append_to_database(markov_chain, keys[first + i]);
+            if (node == NULL) {
+                return 1;
+            }
+            place_node(index, hashes[i], node->data);
+            index->size++;
+            results[first + i] = node->data;
+        }
+    }
+    return 0;
+}
+
+int index_insert(StateIndex *index, MarkovNode *markov_node) {
+    if (index == NULL || markov_node == NULL) {
+        return 1;
+    }
+    if (2 * (index->size + 1) > index->capacity && grow_index(index) != 0) {
+        return 1;
+    }
+    place_node(index, index->hash_func(markov_node->data), markov_node);
+    index->size++;
+    return 0;
+}
+
+void free_state_index(StateIndex **index_ptr) {
+    if (index_ptr == NULL || *index_ptr == NULL) {
+        return;
+    }
+    free((*index_ptr)->slots);
+    free((*index_ptr)->hashes);
+    free(*index_ptr);
+    *index_ptr = NULL;
+}
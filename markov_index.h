@@ -0,0 +1,99 @@
+#ifndef _MARKOV_INDEX_H
+#define _MARKOV_INDEX_H
+
+#include "markov_chain.h"
+#include <stddef.h> // for size_t
+
+/**
+ * Function pointer type for hashing data
+ * @param data pointer to data to hash
+ * @return hash value; data that compare equal with the chain's comp_func
+ * must hash equal
+ */
+typedef uint64_t (*hash_func)(void *data);
+
+/**
+ * Hash index over the states of a chain (open addressing, linear probing),
+ * answering get_node_from_database() questions in O(1) instead of O(n).
+ * The hash of every state is cached next to it, so comp_func only runs on
+ * real matches.
+ */
+typedef struct StateIndex {
+    MarkovNode **slots;
+    uint64_t *hashes;
+    // power of two
+    size_t capacity;
+    size_t size;
+    hash_func hash_func;
+    comp_func comp_func;
+} StateIndex;
+
+/**
+ * Index every state of the chain.
+ * @param markov_chain chain to index
+ * @param hash_func hash consistent with markov_chain->comp_func
+ * @return the index, NULL in case of allocation error
+ */
+StateIndex *build_state_index(MarkovChain *markov_chain, hash_func hash_func);
+
+/**
+ * Find the state equal to data.
+ * @param index index to look in
+ * @param data the state to look for
+ * @return the node of the state, NULL if not indexed
+ */
+MarkovNode *index_lookup(const StateIndex *index, void *data);
+
+/**
+ * Find the state equal to data, with its hash already computed.
+ * @param index index to look in
+ * @param hash index->hash_func(data)
+ * @param data the state to look for
+ * @return the node of the state, NULL if not indexed
+ */
+MarkovNode *index_lookup_hashed(const StateIndex *index, uint64_t hash, void *data);
+
+/**
+ * Find many states at once. Keys are handled in groups: the whole group is
+ * hashed first, then every probe step (home slot, candidate node, its data)
+ * is prefetched for all keys of the group before any of them is compared,
+ * so the cache misses of different keys overlap instead of queueing up.
+ * @param index index to look in
+ * @param keys states to look for
+ * @param num_keys number of keys
+ * @param results output array of num_keys nodes, NULL where not indexed
+ */
+void index_lookup_batch(const StateIndex *index, void *const *keys, size_t num_keys,
+                        MarkovNode **results);
+
+/**
+ * Batch version of add_to_database() for an indexed chain: find many states
+ * at once like index_lookup_batch(), then append the missing ones to the
+ * chain's database and to the index, in key order. A key repeated within
+ * the batch resolves to the same new state.
+ * @param index index of the chain's states
+ * @param markov_chain chain the index was built from
+ * @param keys states to look for or add
+ * @param num_keys number of keys
+ * @param results output array of num_keys nodes
+ * @return 0 on success, 1 in case of allocation error
+ */
+int index_add_batch(StateIndex *index, MarkovChain *markov_chain, void *const *keys,
+                    size_t num_keys, MarkovNode **results);
+
+/**
+ * Add a node to the index, growing it as needed. The caller makes sure no
+ * equal state is indexed yet.
+ * @param index index to add to
+ * @param markov_node node to add
+ * @return 0 on success, 1 in case of allocation error
+ */
+int index_insert(StateIndex *index, MarkovNode *markov_node);
+
+/**
+ * Free the index and set the pointer to NULL. The chain is not touched.
+ * @param index_ptr index to free
+ */
+void free_state_index(StateIndex **index_ptr);
+
+#endif /* _MARKOV_INDEX_H */
@@ -0,0 +1,416 @@
+#include "markov_io.h"
+
+#include <string.h> // for memcmp()
+
+#define CHAIN_FILE_MAGIC "MKC1"
+#define COMPRESSED_CHAIN_FILE_MAGIC "MKZ1"
+#define CHAIN_FILE_MAGIC_LENGTH 4
+// LEB128 needs at most 10 bytes for 64 bits
+#define MAX_VARINT_LENGTH 10
+
+/**
+ * A state of the chain being compressed, ordered by how often it is reached.
+ */
+typedef struct RankedState {
+    uint64_t weight;
+    int id;
+} RankedState;
+
+/**
+ * A successor in the compressed numbering.
+ */
+typedef struct CompressedEdge {
+    int target;
+    uint64_t count;
+} CompressedEdge;
+
+/**
+ * Write an unsigned integer as little-endian bytes.
+ * @param fp file to write to
+ * @param value value to write
+ * @param num_bytes number of bytes, up to 8
+ * @return 0 on success, 1 on write error
+ */
+static int write_integer(FILE *fp, uint64_t value, int num_bytes) {
+    unsigned char bytes[8];
+    for (int i = 0; i < num_bytes; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    return fwrite(bytes, 1, (size_t)num_bytes, fp) == (size_t)num_bytes ? 0 : 1;
+}
+
+/**
+ * Read an unsigned little-endian integer.
+ * @param fp file to read from
+ * @param value output value
+ * @param num_bytes number of bytes, up to 8
+ * @return 0 on success, 1 on read error
+ */
+static int read_integer(FILE *fp, uint64_t *value, int num_bytes) {
+    unsigned char bytes[8];
+    if (fread(bytes, 1, (size_t)num_bytes, fp) != (size_t)num_bytes) {
+        return 1;
+    }
+    *value = 0;
+    for (int i = 0; i < num_bytes; i++) {
+        *value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return 0;
+}
+
+/**
+ * Write an unsigned integer as a LEB128 varint: 7 bits per byte, low bits
+ * first, high bit set on every byte but the last.
+ * @param fp file to write to
+ * @param value value to write
+ * @return 0 on success, 1 on write error
+ */
+static int write_varint(FILE *fp, uint64_t value) {
+    unsigned char bytes[MAX_VARINT_LENGTH];
+    size_t length = 0;
+    do {
+        bytes[length] = (unsigned char)(value & 0x7F);
+        value >>= 7;
+        bytes[length++] |= value != 0 ? 0x80 : 0;
+    } while (value != 0);
+    return fwrite(bytes, 1, length, fp) == length ? 0 : 1;
+}
+
+/**
+ * Read a varint written by write_varint().
+ * @param fp file to read from
+ * @param value output value
+ * @return 0 on success, 1 on read error or overlong encoding
+ */
+static int read_varint(FILE *fp, uint64_t *value) {
+    *value = 0;
+    for (int i = 0; i < MAX_VARINT_LENGTH; i++) {
+        int byte = getc(fp);
+        if (byte == EOF || (i == MAX_VARINT_LENGTH - 1 && byte > 1)) {
+            return 1;
+        }
+        *value |= (uint64_t)(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int write_chain_states(MarkovChain *markov_chain, FILE *fp, write_data write_data) {
+    if (markov_chain == NULL || markov_chain->database == NULL || fp == NULL ||
+        write_data == NULL) {
+        return 1;
+    }
+
+    if (fwrite(CHAIN_FILE_MAGIC, 1, CHAIN_FILE_MAGIC_LENGTH, fp) != CHAIN_FILE_MAGIC_LENGTH ||
+        write_integer(fp, (uint64_t)markov_chain->database->size, 4) != 0) {
+        return 1;
+    }
+
+    // States, numbering them so edges can refer to them by index
+    int id = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        current->data->id = id++;
+        if (write_data(current->data->data, fp) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int write_transition_list(FILE *fp, const uint32_t *targets, const uint64_t *counts,
+                          int size) {
+    if (write_integer(fp, (uint64_t)size, 4) != 0) {
+        return 1;
+    }
+    for (int i = 0; i < size; i++) {
+        if (write_integer(fp, targets[i], 4) != 0 || write_integer(fp, counts[i], 8) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int save_chain(MarkovChain *markov_chain, FILE *fp, write_data write_data) {
+    if (write_chain_states(markov_chain, fp, write_data) != 0) {
+        return 1;
+    }
+
+    // Frequency lists
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *markov_node = current->data;
+        if (write_integer(fp, (uint64_t)markov_node->frequency_list_size, 4) != 0) {
+            return 1;
+        }
+        for (int i = 0; i < markov_node->frequency_list_size; i++) {
+            if (write_integer(fp, (uint64_t)markov_node->frequency_list[i]->id, 4) != 0 ||
+                write_integer(fp, get_frequency(markov_node, i), 8) != 0) {
+                return 1;
+            }
+        }
+    }
+
+    return ferror(fp) ? 1 : 0;
+}
+
+/**
+ * Order states by decreasing weight, then by database position.
+ * @param first first RankedState
+ * @param second second RankedState
+ * @return comparison result for qsort()
+ */
+static int compare_ranked_states(const void *first, const void *second) {
+    const RankedState *a = first, *b = second;
+    if (a->weight != b->weight) {
+        return a->weight > b->weight ? -1 : 1;
+    }
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+/**
+ * Order successors by their compressed number.
+ * @param first first CompressedEdge
+ * @param second second CompressedEdge
+ * @return comparison result for qsort()
+ */
+static int compare_compressed_edges(const void *first, const void *second) {
+    const CompressedEdge *a = first, *b = second;
+    return (a->target > b->target) - (a->target < b->target);
+}
+
+/**
+ * Write the frequency lists of the compressed format, in rank order.
+ * @param fp file positioned after the states
+ * @param nodes database position -> node
+ * @param ranked states in rank order
+ * @param ranks database position -> rank
+ * @param num_states number of states
+ * @return 0 on success, 1 on write or allocation error
+ */
+static int save_compressed_lists(FILE *fp, MarkovNode **nodes, const RankedState *ranked,
+                                 const int *ranks, int num_states) {
+    CompressedEdge *edges = NULL;
+    int capacity = 0;
+    for (int k = 0; k < num_states; k++) {
+        MarkovNode *markov_node = nodes[ranked[k].id];
+        int size = markov_node->frequency_list_size;
+        if (size > capacity) {
+            CompressedEdge *new_edges = realloc(edges, (size_t)size * sizeof(CompressedEdge));
+            if (new_edges == NULL) {
+                fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+                free(edges);
+                return 1;
+            }
+            edges = new_edges;
+            capacity = size;
+        }
+        for (int i = 0; i < size; i++) {
+            edges[i] = (CompressedEdge) {ranks[markov_node->frequency_list[i]->id],
+                                         get_frequency(markov_node, i)};
+        }
+        qsort(edges, (size_t)size, sizeof(CompressedEdge), compare_compressed_edges);
+
+        // Successors as gaps (the first one as is), counts minus one since
+        // no count is 0
+        if (write_varint(fp, (uint64_t)size) != 0) {
+            free(edges);
+            return 1;
+        }
+        for (int i = 0; i < size; i++) {
+            uint64_t gap = i == 0 ? (uint64_t)edges[i].target
+                                  : (uint64_t)(edges[i].target - edges[i - 1].target - 1);
+            if (write_varint(fp, gap) != 0 || write_varint(fp, edges[i].count - 1) != 0) {
+                free(edges);
+                return 1;
+            }
+        }
+    }
+    free(edges);
+    return 0;
+}
+
+int save_chain_compressed(MarkovChain *markov_chain, FILE *fp, write_data write_data) {
+    if (markov_chain == NULL || markov_chain->database == NULL || fp == NULL ||
+        write_data == NULL) {
+        return 1;
+    }
+
+    int num_states = markov_chain->database->size;
+    size_t count = (size_t)num_states + 1;
+    MarkovNode **nodes = malloc(count * sizeof(MarkovNode *));
+    RankedState *ranked = calloc(count, sizeof(RankedState));
+    int *ranks = malloc(count * sizeof(int));
+    if (nodes == NULL || ranked == NULL || ranks == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(nodes);
+        free(ranked);
+        free(ranks);
+        return 1;
+    }
+
+    // Weigh every state by how often it is reached
+    int id = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        nodes[id] = current->data;
+        ranked[id].id = id;
+        current->data->id = id++;
+    }
+    for (int i = 0; i < num_states; i++) {
+        for (int j = 0; j < nodes[i]->frequency_list_size; j++) {
+            ranked[nodes[i]->frequency_list[j]->id].weight += get_frequency(nodes[i], j);
+        }
+    }
+    qsort(ranked, (size_t)num_states, sizeof(RankedState), compare_ranked_states);
+    for (int k = 0; k < num_states; k++) {
+        ranks[ranked[k].id] = k;
+    }
+
+    int result = fwrite(COMPRESSED_CHAIN_FILE_MAGIC, 1, CHAIN_FILE_MAGIC_LENGTH, fp) !=
+                 CHAIN_FILE_MAGIC_LENGTH || write_varint(fp, (uint64_t)num_states) != 0;
+    for (int k = 0; result == 0 && k < num_states; k++) {
+        result = write_data(nodes[ranked[k].id]->data, fp);
+    }
+    if (result == 0) {
+        result = save_compressed_lists(fp, nodes, ranked, ranks, num_states);
+    }
+
+    free(nodes);
+    free(ranked);
+    free(ranks);
+    return result != 0 || ferror(fp) ? 1 : 0;
+}
+
+/**
+ * Read the frequency lists part of a chain file.
+ * @param markov_chain chain merged into
+ * @param fp file positioned after the states
+ * @param states file state index -> node of the chain merged into
+ * @param num_states number of file states
+ * @return 0 on success, 1 on read error, malformed file or allocation error
+ */
+static int load_frequency_lists(MarkovChain *markov_chain, FILE *fp, MarkovNode **states,
+                                uint64_t num_states) {
+    for (uint64_t i = 0; i < num_states; i++) {
+        uint64_t list_size;
+        if (read_integer(fp, &list_size, 4) != 0) {
+            return 1;
+        }
+        for (uint64_t j = 0; j < list_size; j++) {
+            uint64_t target, count;
+            if (read_integer(fp, &target, 4) != 0 || read_integer(fp, &count, 8) != 0 ||
+                target >= num_states) {
+                return 1;
+            }
+            if (add_transition_count(markov_chain, states[i], states[target], count) != 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Read the frequency lists part of a compressed chain file.
+ * @param markov_chain chain merged into
+ * @param fp file positioned after the states
+ * @param states file state index -> node of the chain merged into
+ * @param num_states number of file states
+ * @return 0 on success, 1 on read error, malformed file or allocation error
+ */
+static int load_compressed_lists(MarkovChain *markov_chain, FILE *fp, MarkovNode **states,
+                                 uint64_t num_states) {
+    for (uint64_t i = 0; i < num_states; i++) {
+        uint64_t list_size;
+        if (read_varint(fp, &list_size) != 0 || list_size > num_states) {
+            return 1;
+        }
+        uint64_t target = 0;
+        for (uint64_t j = 0; j < list_size; j++) {
+            uint64_t gap, count;
+            if (read_varint(fp, &gap) != 0 || read_varint(fp, &count) != 0 ||
+                gap >= num_states || count == UINT64_MAX) {
+                return 1;
+            }
+            // Successors are strictly increasing, so the first is the gap
+            // itself and the others are at least one past the previous
+            target = j == 0 ? gap : target + 1 + gap;
+            if (target >= num_states) {
+                return 1;
+            }
+            if (add_transition_count(markov_chain, states[i], states[target],
+                                     count + 1) != 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int load_chain(MarkovChain *markov_chain, StateIndex *index, FILE *fp, read_data read_data) {
+    if (markov_chain == NULL || fp == NULL || read_data == NULL) {
+        return 1;
+    }
+
+    char magic[CHAIN_FILE_MAGIC_LENGTH];
+    uint64_t num_states;
+    if (fread(magic, 1, CHAIN_FILE_MAGIC_LENGTH, fp) != CHAIN_FILE_MAGIC_LENGTH) {
+        return 1;
+    }
+    bool compressed = memcmp(magic, COMPRESSED_CHAIN_FILE_MAGIC, CHAIN_FILE_MAGIC_LENGTH) == 0;
+    if (!compressed && memcmp(magic, CHAIN_FILE_MAGIC, CHAIN_FILE_MAGIC_LENGTH) != 0) {
+        return 1;
+    }
+    if ((compressed ? read_varint(fp, &num_states) : read_integer(fp, &num_states, 4)) != 0 ||
+        num_states >= (uint64_t)INT32_MAX) {
+        return 1;
+    }
+
+    MarkovNode **states = malloc(((size_t)num_states + 1) * sizeof(MarkovNode *));
+    if (states == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+
+    // Union the states into the chain, keeping the file's order for new ones
+    for (uint64_t i = 0; i < num_states; i++) {
+        void *data = read_data(fp);
+        if (data == NULL) {
+            free(states);
+            return 1;
+        }
+        MarkovNode *state = index != NULL ? index_lookup(index, data) : NULL;
+        if (state == NULL) {
+            Node *node = index != NULL ? append_to_database(markov_chain, data)
+                                       : add_to_database(markov_chain, data);
+            state = node != NULL ? node->data : NULL;
+            if (state != NULL && index != NULL && index_insert(index, state) != 0) {
+                state = NULL;
+            }
+        }
+        markov_chain->free_data(data);
+        if (state == NULL) {
+            free(states);
+            return 1;
+        }
+        states[i] = state;
+    }
+
+    int result = compressed ? load_compressed_lists(markov_chain, fp, states, num_states)
+                            : load_frequency_lists(markov_chain, fp, states, num_states);
+    free(states);
+    return result;
+}
+
+bool is_chain_file(FILE *fp) {
+    char magic[CHAIN_FILE_MAGIC_LENGTH];
+    long position = ftell(fp);
+    bool matches = fread(magic, 1, CHAIN_FILE_MAGIC_LENGTH, fp) == CHAIN_FILE_MAGIC_LENGTH &&
+                   (memcmp(magic, CHAIN_FILE_MAGIC, CHAIN_FILE_MAGIC_LENGTH) == 0 ||
+                    memcmp(magic, COMPRESSED_CHAIN_FILE_MAGIC, CHAIN_FILE_MAGIC_LENGTH) == 0);
+    fseek(fp, position, SEEK_SET);
+    return matches;
+}
@@ -0,0 +1,98 @@
+#ifndef _MARKOV_IO_H
+#define _MARKOV_IO_H
+
+#include "markov_chain.h"
+#include "markov_index.h"
+
+/**
+ * Function pointer type for writing one state to a chain file
+ * @param data pointer to the state to write
+ * @param fp file to write to
+ * @return 0 on success, 1 on write error
+ */
+typedef int (*write_data)(void *data, FILE *fp);
+
+/**
+ * Function pointer type for reading back a state written by write_data
+ * @param fp file to read from
+ * @return newly allocated state, freed with the chain's free_data, or NULL
+ * on read or allocation error
+ */
+typedef void *(*read_data)(FILE *fp);
+
+/**
+ * Write the chain to a file: a header, every state in database order, then
+ * every frequency list as (state index, count) pairs in list order.
+ * @param markov_chain chain to write, the id field of its nodes is refreshed
+ * @param fp file opened for binary writing
+ * @param write_data how to write one state
+ * @return 0 on success, 1 on write error
+ */
+int save_chain(MarkovChain *markov_chain, FILE *fp, write_data write_data);
+
+/**
+ * Write the first part of a chain file, the header and every state in
+ * database order. The frequency lists are to follow, one per state in the
+ * same order, each written with write_transition_list().
+ * @param markov_chain chain to write, the id field of its nodes is refreshed
+ * @param fp file opened for binary writing
+ * @param write_data how to write one state
+ * @return 0 on success, 1 on write error
+ */
+int write_chain_states(MarkovChain *markov_chain, FILE *fp, write_data write_data);
+
+/**
+ * Write one frequency list of a chain file.
+ * @param fp file positioned after the states or the previous list
+ * @param targets database position of every successor, in list order
+ * @param counts transition count of every successor
+ * @param size number of successors
+ * @return 0 on success, 1 on write error
+ */
+int write_transition_list(FILE *fp, const uint32_t *targets, const uint64_t *counts,
+                          int size);
+
+/**
+ * Write the chain in the compact format, for archival and transfer. States
+ * are renumbered by how often they are reached (most frequent first) and
+ * written once each, in that order, with write_data; each frequency list is
+ * then sorted by the new numbers and stored as varint gaps and varint
+ * counts. The file is written as the chain is walked; apart from the chain
+ * only a few integers per state are held.
+ * load_chain() reads both formats. The compact one restores every state
+ * and count, but states and successors come back in the canonical order
+ * above rather than in database order.
+ * @param markov_chain chain to write, the id field of its nodes is refreshed
+ * @param fp file opened for binary writing
+ * @param write_data how to write one state
+ * @return 0 on success, 1 on write or allocation error
+ */
+int save_chain_compressed(MarkovChain *markov_chain, FILE *fp, write_data write_data);
+
+/**
+ * Read a chain file of either format into the given chain, merging it with
+ * what the chain already holds: states are matched through the chain's
+ * comp_func, new ones are appended in file order, and transition counts are
+ * summed. Loading the chains of several corpus parts in order into one chain
+ * gives the same chain as training on the concatenated parts, as long as
+ * every part ends on a sentence end (compact files give the same states and
+ * counts, in their canonical order). The file is streamed; apart from the
+ * chain itself only one pointer per file state is held.
+ * @param markov_chain chain to merge into
+ * @param index index of every state of markov_chain, to which new states are
+ * added; NULL to match states with get_node_from_database(), O(n) per state
+ * @param fp file opened for binary reading
+ * @param read_data how to read one state
+ * @return 0 on success, 1 on read error, malformed file or allocation error
+ */
+int load_chain(MarkovChain *markov_chain, StateIndex *index, FILE *fp, read_data read_data);
+
+/**
+ * Check whether the file starts like a chain written by save_chain() or
+ * save_chain_compressed(). The file position is restored.
+ * @param fp file to check
+ * @return true for chain files
+ */
+bool is_chain_file(FILE *fp);
+
+#endif /* _MARKOV_IO_H */
@@ -0,0 +1,274 @@
+#include "markov_layout.h"
+#include "markov_stationary.h"
+
+#include <string.h> // for memcpy()
+
+// Visit frequencies only need to rank states, not be exact
+#define LAYOUT_DAMPING 0.85
+#define LAYOUT_TOLERANCE 1e-6
+#define LAYOUT_MAX_ITERATIONS 100
+
+/**
+ * A state with its long-run visit frequency.
+ */
+typedef struct RankedState {
+    double mass;
+    int id;
+} RankedState;
+
+/**
+ * A successor with its transition count, for BFS ordering.
+ */
+typedef struct WeightedSuccessor {
+    uint64_t count;
+    int id;
+} WeightedSuccessor;
+
+/**
+ * Order states by decreasing mass, then by id.
+ * @param first first RankedState
+ * @param second second RankedState
+ * @return comparison result for qsort()
+ */
+static int compare_ranked_states(const void *first, const void *second) {
+    const RankedState *a = first, *b = second;
+    if (a->mass != b->mass) {
+        return a->mass > b->mass ? -1 : 1;
+    }
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+/**
+ * Order successors by decreasing count, then by id.
+ * @param first first WeightedSuccessor
+ * @param second second WeightedSuccessor
+ * @return comparison result for qsort()
+ */
+static int compare_weighted_successors(const void *first, const void *second) {
+    const WeightedSuccessor *a = first, *b = second;
+    if (a->count != b->count) {
+        return a->count > b->count ? -1 : 1;
+    }
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+/**
+ * Rank the states of the snapshot by stationary mass.
+ * @param matrix snapshot of the chain
+ * @param ranked output array of matrix->num_states states, most visited first
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int rank_by_visits(const ChainMatrix *matrix, RankedState *ranked) {
+    double *mass = malloc(((size_t)matrix->num_states + 1) * sizeof(double));
+    if (mass == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    StationaryOptions options = default_stationary_options();
+    options.damping = LAYOUT_DAMPING;
+    options.tolerance = LAYOUT_TOLERANCE;
+    options.max_iterations = LAYOUT_MAX_ITERATIONS;
+    if (compute_stationary_distribution(matrix, &options, mass, NULL) != 0) {
+        free(mass);
+        return 1;
+    }
+
+    for (int i = 0; i < matrix->num_states; i++) {
+        ranked[i] = (RankedState) {mass[i], i};
+    }
+    qsort(ranked, (size_t)matrix->num_states, sizeof(RankedState), compare_ranked_states);
+    free(mass);
+    return 0;
+}
+
+/**
+ * Compute the placement of every state.
+ * @param matrix snapshot of the chain
+ * @param order placement order
+ * @param placement output array, new position -> state id
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int compute_placement(const ChainMatrix *matrix, LayoutOrder order, int *placement) {
+    size_t count = (size_t)matrix->num_states + 1;
+    RankedState *ranked = malloc(count * sizeof(RankedState));
+    if (ranked == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    if (rank_by_visits(matrix, ranked) != 0) {
+        free(ranked);
+        return 1;
+    }
+    if (order == LAYOUT_VISIT_FREQUENCY) {
+        for (int i = 0; i < matrix->num_states; i++) {
+            placement[i] = ranked[i].id;
+        }
+        free(ranked);
+        return 0;
+    }
+
+    // Breadth-first, seeding a new search from the most visited state not
+    // placed yet; placement doubles as the queue
+    bool *placed = calloc(count, sizeof(bool));
+    WeightedSuccessor *successors = NULL;
+    size_t capacity = 0;
+    if (placed == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(ranked);
+        return 1;
+    }
+    int tail = 0;
+    for (int seed = 0; seed < matrix->num_states; seed++) {
+        if (placed[ranked[seed].id]) {
+            continue;
+        }
+        int head = tail;
+        placement[tail++] = ranked[seed].id;
+        placed[ranked[seed].id] = true;
+        while (head < tail) {
+            MarkovNode *markov_node = matrix->nodes[placement[head++]];
+            size_t size = (size_t)markov_node->frequency_list_size;
+            if (size > capacity) {
+                WeightedSuccessor *grown = realloc(successors, size * sizeof(WeightedSuccessor));
+                if (grown == NULL) {
+                    fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+                    free(successors);
+                    free(placed);
+                    free(ranked);
+                    return 1;
+                }
+                successors = grown;
+                capacity = size;
+            }
+            for (size_t i = 0; i < size; i++) {
+                successors[i] = (WeightedSuccessor) {get_frequency(markov_node, (int)i),
+                                                     markov_node->frequency_list[i]->id};
+            }
+            qsort(successors, size, sizeof(WeightedSuccessor), compare_weighted_successors);
+            for (size_t i = 0; i < size; i++) {
+                if (!placed[successors[i].id]) {
+                    placed[successors[i].id] = true;
+                    placement[tail++] = successors[i].id;
+                }
+            }
+        }
+    }
+
+    free(successors);
+    free(placed);
+    free(ranked);
+    return 0;
+}
+
+/**
+ * Allocate the moved copy of a node, its data and its arrays, back to back,
+ * from the chain's allocator. Successor references still point at the old
+ * nodes.
+ * @param markov_chain chain the node belongs to
+ * @param old_node node to copy
+ * @return the copy, NULL in case of allocation error
+ */
+static MarkovNode *copy_markov_node(MarkovChain *markov_chain, const MarkovNode *old_node) {
+    MarkovNode *markov_node = chain_alloc(&markov_chain->allocator, MEMORY_NODES,
+                                          sizeof(MarkovNode));
+    if (markov_node == NULL) {
+        return NULL;
+    }
+    *markov_node = *old_node;
+    markov_node->frequency_list = NULL;
+    markov_node->frequencies = NULL;
+    markov_node->frequency_capacity = 0;
+    markov_node->data = copy_chain_data(markov_chain, old_node->data);
+    if (markov_node->data == NULL) {
+        free_markov_node(markov_chain, markov_node);
+        return NULL;
+    }
+
+    // The copy's arrays are exactly as long as its frequency list
+    size_t size = (size_t)old_node->frequency_list_size;
+    if (size == 0) {
+        return markov_node;
+    }
+    markov_node->frequencies = chain_alloc(&markov_chain->allocator, MEMORY_EDGES,
+                                           size * old_node->frequency_width);
+    markov_node->frequency_list = chain_alloc(&markov_chain->allocator, MEMORY_EDGES,
+                                              size * sizeof(MarkovNode *));
+    markov_node->frequency_capacity = old_node->frequency_list_size;
+    if (markov_node->frequencies == NULL || markov_node->frequency_list == NULL) {
+        free_markov_node(markov_chain, markov_node);
+        return NULL;
+    }
+    memcpy(markov_node->frequencies, old_node->frequencies, size * old_node->frequency_width);
+    memcpy(markov_node->frequency_list, old_node->frequency_list,
+           size * sizeof(MarkovNode *));
+    return markov_node;
+}
+
+int relayout_chain(MarkovChain *markov_chain, LayoutOrder order) {
+    if (markov_chain == NULL || markov_chain->database == NULL) {
+        return 1;
+    }
+    if (markov_chain->database->size == 0) {
+        return 0;
+    }
+    ChainMatrix *matrix = build_chain_matrix(markov_chain);
+    if (matrix == NULL) {
+        return 1;
+    }
+
+    int num_states = matrix->num_states;
+    size_t count = (size_t)num_states + 1;
+    int *placement = malloc(count * sizeof(int));
+    int *positions = malloc(count * sizeof(int));
+    MarkovNode **moved = calloc(count, sizeof(MarkovNode *));
+    int result = placement == NULL || positions == NULL || moved == NULL;
+    if (result != 0) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+    } else {
+        result = compute_placement(matrix, order, placement);
+    }
+
+    // Copy every node in placement order; on failure drop the copies
+    for (int k = 0; result == 0 && k < num_states; k++) {
+        moved[k] = copy_markov_node(markov_chain, matrix->nodes[placement[k]]);
+        if (moved[k] == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            for (int j = 0; j < k; j++) {
+                free_markov_node(markov_chain, moved[j]);
+            }
+            result = 1;
+        }
+    }
+    if (result != 0) {
+        free(placement);
+        free(positions);
+        free(moved);
+        free_chain_matrix(&matrix);
+        return 1;
+    }
+
+    // Point successors at the moved nodes; ids still hold the old positions
+    for (int k = 0; k < num_states; k++) {
+        positions[placement[k]] = k;
+    }
+    for (int k = 0; k < num_states; k++) {
+        for (int i = 0; i < moved[k]->frequency_list_size; i++) {
+            moved[k]->frequency_list[i] = moved[positions[moved[k]->frequency_list[i]->id]];
+        }
+    }
+
+    // Swap the moved nodes into the database in their new order
+    int k = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next, k++) {
+        free_markov_node(markov_chain, current->data);
+        moved[k]->id = k;
+        current->data = moved[k];
+    }
+
+    free(placement);
+    free(positions);
+    free(moved);
+    free_chain_matrix(&matrix);
+    return 0;
+}
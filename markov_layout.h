@@ -0,0 +1,36 @@
+#ifndef _MARKOV_LAYOUT_H
+#define _MARKOV_LAYOUT_H
+
+#include "markov_chain.h"
+
+/**
+ * Order in which relayout_chain() places the states.
+ */
+typedef enum LayoutOrder {
+    // most visited states first, by stationary mass
+    LAYOUT_VISIT_FREQUENCY,
+    // breadth-first from the most visited state, likeliest successors
+    // first, so a state's successors sit right after it
+    LAYOUT_BFS
+} LayoutOrder;
+
+/**
+ * Rebuild a trained chain in cache-friendly order. States are renumbered
+ * (ids and database order) in the given order and every node is moved to
+ * fresh memory, allocated in that order together with its data, successor
+ * list and counters, so hot states and their likely successors end up
+ * close together. Successor references are rewritten to the moved nodes;
+ * successor order and counts are unchanged, so a successor draw from a
+ * given state picks the same successor as before. Draws of a first state
+ * (get_first_random_node(), collect_start_states()) depend on database
+ * order, so a seeded run generally starts, and thus continues, differently.
+ * Meant to run once after training: every MarkovNode pointer and snapshot
+ * taken before is invalid afterwards. Peak memory is twice the chain.
+ * @param markov_chain trained chain to rebuild
+ * @param order placement order
+ * @return 0 on success, 1 in case of allocation error (the chain is then
+ * left as it was)
+ */
+int relayout_chain(MarkovChain *markov_chain, LayoutOrder order);
+
+#endif /* _MARKOV_LAYOUT_H */
@@ -0,0 +1,73 @@
+#include "markov_matrix.h"
+
+ChainMatrix *build_chain_matrix(MarkovChain *markov_chain) {
+    if (markov_chain == NULL || markov_chain->database == NULL) {
+        return NULL;
+    }
+
+    ChainMatrix *matrix = calloc(1, sizeof(ChainMatrix));
+    if (matrix == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+
+    // First pass: number the states and count the edges
+    int num_states = 0;
+    size_t num_edges = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        current->data->id = num_states++;
+        num_edges += (size_t)current->data->frequency_list_size;
+    }
+    matrix->num_states = num_states;
+    matrix->num_edges = num_edges;
+
+    // Keep every array non-empty so a chain without edges is not an error
+    matrix->nodes = malloc(((size_t)num_states + 1) * sizeof(MarkovNode *));
+    matrix->row_offsets = malloc(((size_t)num_states + 1) * sizeof(size_t));
+    matrix->is_last = malloc(((size_t)num_states + 1) * sizeof(bool));
+    matrix->columns = malloc((num_edges + 1) * sizeof(int));
+    matrix->probabilities = malloc((num_edges + 1) * sizeof(double));
+    if (matrix->nodes == NULL || matrix->row_offsets == NULL ||
+        matrix->is_last == NULL || matrix->columns == NULL ||
+        matrix->probabilities == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free_chain_matrix(&matrix);
+        return NULL;
+    }
+
+    // Second pass: fill the rows
+    size_t edge = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *markov_node = current->data;
+        matrix->nodes[markov_node->id] = markov_node;
+        matrix->row_offsets[markov_node->id] = edge;
+        matrix->is_last[markov_node->id] = markov_chain->is_last(markov_node->data);
+
+        double total = (double)markov_node->total_frequency;
+        for (int i = 0; i < markov_node->frequency_list_size; i++) {
+            matrix->columns[edge] = markov_node->frequency_list[i]->id;
+            matrix->probabilities[edge] = (double)get_frequency(markov_node, i) / total;
+            edge++;
+        }
+    }
+    matrix->row_offsets[num_states] = edge;
+
+    return matrix;
+}
+
+void free_chain_matrix(ChainMatrix **matrix_ptr) {
+    if (matrix_ptr == NULL || *matrix_ptr == NULL) {
+        return;
+    }
+
+    ChainMatrix *matrix = *matrix_ptr;
+    free(matrix->nodes);
+    free(matrix->row_offsets);
+    free(matrix->columns);
+    free(matrix->probabilities);
+    free(matrix->is_last);
+    free(matrix);
+    *matrix_ptr = NULL;
+}
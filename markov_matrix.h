@@ -0,0 +1,40 @@
+#ifndef _MARKOV_MATRIX_H
+#define _MARKOV_MATRIX_H
+
+#include "markov_chain.h"
+#include <stddef.h> // for size_t
+
+/**
+ * Read-only snapshot of a trained chain as a sparse transition matrix in
+ * CSR layout, indexed by state id. The successors of state i are
+ * columns[row_offsets[i]] .. columns[row_offsets[i + 1] - 1], in frequency
+ * list order, with the matching transition probabilities.
+ */
+typedef struct ChainMatrix {
+    int num_states;
+    size_t num_edges;
+    // state id -> node of the chain the snapshot was taken from
+    MarkovNode **nodes;
+    size_t *row_offsets;
+    int *columns;
+    double *probabilities;
+    // markov_chain->is_last of every state, so queries never call back
+    bool *is_last;
+} ChainMatrix;
+
+/**
+ * Take a matrix snapshot of the chain. State ids are the database order;
+ * the id field of every node is refreshed on the way. The snapshot has to
+ * be rebuilt after the chain changes.
+ * @param markov_chain chain to snapshot
+ * @return the snapshot, NULL in case of allocation error
+ */
+ChainMatrix *build_chain_matrix(MarkovChain *markov_chain);
+
+/**
+ * Free the snapshot and set the pointer to NULL. The chain is not touched.
+ * @param matrix_ptr snapshot to free
+ */
+void free_chain_matrix(ChainMatrix **matrix_ptr);
+
+#endif /* _MARKOV_MATRIX_H */
@@ -0,0 +1,266 @@
+#include "markov_query.h"
+
+#include <string.h> // for memcpy()
+
+/**
+ * Scratch space shared by all queries of a batch. dense is all zeros and
+ * in_frontier all false between steps; only the touched entries are ever
+ * reset, so a step costs O(frontier edges), not O(num_states).
+ */
+typedef struct QueryWorkspace {
+    double *dense;
+    bool *in_frontier;
+    // frontier of the current step
+    int *states;
+    double *probabilities;
+    int size;
+    // states touched while building the next frontier
+    int *touched;
+    int num_touched;
+} QueryWorkspace;
+
+/**
+ * Allocate a zeroed workspace for the given snapshot.
+ * @param workspace workspace to set up
+ * @param num_states number of states of the snapshot
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int create_workspace(QueryWorkspace *workspace, int num_states) {
+    size_t count = (size_t)num_states + 1;
+    workspace->dense = calloc(count, sizeof(double));
+    workspace->in_frontier = calloc(count, sizeof(bool));
+    workspace->states = malloc(count * sizeof(int));
+    workspace->probabilities = malloc(count * sizeof(double));
+    workspace->touched = malloc(count * sizeof(int));
+    workspace->size = 0;
+    workspace->num_touched = 0;
+    if (workspace->dense == NULL || workspace->in_frontier == NULL ||
+        workspace->states == NULL || workspace->probabilities == NULL ||
+        workspace->touched == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Free the buffers of the workspace.
+ * @param workspace workspace to free
+ */
+static void free_workspace(QueryWorkspace *workspace) {
+    free(workspace->dense);
+    free(workspace->in_frontier);
+    free(workspace->states);
+    free(workspace->probabilities);
+    free(workspace->touched);
+}
+
+/**
+ * Add probability mass to a state of the next frontier.
+ * @param workspace shared workspace
+ * @param state target state id
+ * @param probability mass to add
+ */
+static void accumulate(QueryWorkspace *workspace, int state, double probability) {
+    if (!workspace->in_frontier[state]) {
+        workspace->in_frontier[state] = true;
+        workspace->touched[workspace->num_touched++] = state;
+    }
+    workspace->dense[state] += probability;
+}
+
+/**
+ * Move the accumulated mass into the frontier, dropping entries below
+ * epsilon, and reset the touched scratch entries.
+ * @param workspace shared workspace
+ * @param epsilon pruning threshold
+ * @return the dropped mass
+ */
+static double collect_frontier(QueryWorkspace *workspace, double epsilon) {
+    double pruned = 0;
+    workspace->size = 0;
+    for (int i = 0; i < workspace->num_touched; i++) {
+        int state = workspace->touched[i];
+        double probability = workspace->dense[state];
+        if (probability < epsilon) {
+            pruned += probability;
+        } else {
+            workspace->states[workspace->size] = state;
+            workspace->probabilities[workspace->size] = probability;
+            workspace->size++;
+        }
+        workspace->dense[state] = 0;
+        workspace->in_frontier[state] = false;
+    }
+    workspace->num_touched = 0;
+    return pruned;
+}
+
+/**
+ * Whether a walk stops at the given state.
+ * @param matrix snapshot of the chain
+ * @param state state id
+ * @return true for last states and states without successors
+ */
+static bool is_stop_state(const ChainMatrix *matrix, int state) {
+    return matrix->is_last[state] ||
+           matrix->row_offsets[state] == matrix->row_offsets[state + 1];
+}
+
+/**
+ * Compare two ints, for qsort().
+ * @param first pointer to the first int
+ * @param second pointer to the second int
+ * @return negative, zero or positive like strcmp
+ */
+static int compare_states(const void *first, const void *second) {
+    int a = *(const int *)first;
+    int b = *(const int *)second;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Copy the current frontier into a result distribution, sorted by state id.
+ * @param workspace workspace holding the final frontier
+ * @param result distribution to fill
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int export_frontier(QueryWorkspace *workspace, SparseDistribution *result) {
+    size_t count = (size_t)workspace->size + 1;
+    result->states = malloc(count * sizeof(int));
+    result->probabilities = malloc(count * sizeof(double));
+    if (result->states == NULL || result->probabilities == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free_sparse_distribution(result);
+        return 1;
+    }
+
+    // Sort the ids, then pick the probabilities out of the zeroed dense
+    // array (scatter, read back, reset) to keep them paired
+    memcpy(result->states, workspace->states, (size_t)workspace->size * sizeof(int));
+    for (int i = 0; i < workspace->size; i++) {
+        workspace->dense[workspace->states[i]] = workspace->probabilities[i];
+    }
+    qsort(result->states, (size_t)workspace->size, sizeof(int), compare_states);
+    for (int i = 0; i < workspace->size; i++) {
+        result->probabilities[i] = workspace->dense[result->states[i]];
+        workspace->dense[result->states[i]] = 0;
+    }
+    result->size = workspace->size;
+    return 0;
+}
+
+int k_step_distribution(const ChainMatrix *matrix, const int *start_states,
+                        int num_starts, int steps, double epsilon,
+                        SparseDistribution *results) {
+    if (matrix == NULL || start_states == NULL || results == NULL ||
+        num_starts < 0 || steps < 0) {
+        return 1;
+    }
+    for (int q = 0; q < num_starts; q++) {
+        results[q] = (SparseDistribution) {0, NULL, NULL, 0};
+        if (start_states[q] < 0 || start_states[q] >= matrix->num_states) {
+            return 1;
+        }
+    }
+
+    QueryWorkspace workspace;
+    if (create_workspace(&workspace, matrix->num_states) != 0) {
+        free_workspace(&workspace);
+        return 1;
+    }
+
+    for (int q = 0; q < num_starts; q++) {
+        workspace.states[0] = start_states[q];
+        workspace.probabilities[0] = 1;
+        workspace.size = 1;
+
+        for (int step = 0; step < steps && workspace.size > 0; step++) {
+            for (int i = 0; i < workspace.size; i++) {
+                int state = workspace.states[i];
+                double probability = workspace.probabilities[i];
+                if (is_stop_state(matrix, state)) {
+                    // The walk ended here, its mass stays put
+                    accumulate(&workspace, state, probability);
+                    continue;
+                }
+                for (size_t e = matrix->row_offsets[state];
+                     e < matrix->row_offsets[state + 1]; e++) {
+                    accumulate(&workspace, matrix->columns[e],
+                               probability * matrix->probabilities[e]);
+                }
+            }
+            results[q].pruned += collect_frontier(&workspace, epsilon);
+        }
+
+        if (export_frontier(&workspace, &results[q]) != 0) {
+            for (int i = 0; i < q; i++) {
+                free_sparse_distribution(&results[i]);
+            }
+            free_workspace(&workspace);
+            return 1;
+        }
+    }
+
+    free_workspace(&workspace);
+    return 0;
+}
+
+int reach_last_probability(const ChainMatrix *matrix, const int *start_states,
+                           int num_starts, int steps, double epsilon,
+                           double *probabilities) {
+    if (matrix == NULL || start_states == NULL || probabilities == NULL ||
+        num_starts < 0 || steps < 0) {
+        return 1;
+    }
+    for (int q = 0; q < num_starts; q++) {
+        if (start_states[q] < 0 || start_states[q] >= matrix->num_states) {
+            return 1;
+        }
+    }
+
+    QueryWorkspace workspace;
+    if (create_workspace(&workspace, matrix->num_states) != 0) {
+        free_workspace(&workspace);
+        return 1;
+    }
+
+    for (int q = 0; q < num_starts; q++) {
+        double reached = matrix->is_last[start_states[q]] ? 1 : 0;
+        workspace.states[0] = start_states[q];
+        workspace.probabilities[0] = 1;
+        workspace.size = reached > 0 ? 0 : 1;
+
+        for (int step = 0; step < steps && workspace.size > 0; step++) {
+            for (int i = 0; i < workspace.size; i++) {
+                int state = workspace.states[i];
+                double probability = workspace.probabilities[i];
+                // Mass on a dead end never reaches a last state, drop it
+                for (size_t e = matrix->row_offsets[state];
+                     e < matrix->row_offsets[state + 1]; e++) {
+                    int next = matrix->columns[e];
+                    double mass = probability * matrix->probabilities[e];
+                    if (matrix->is_last[next]) {
+                        reached += mass;
+                    } else {
+                        accumulate(&workspace, next, mass);
+                    }
+                }
+            }
+            collect_frontier(&workspace, epsilon);
+        }
+        probabilities[q] = reached;
+    }
+
+    free_workspace(&workspace);
+    return 0;
+}
+
+void free_sparse_distribution(SparseDistribution *distribution) {
+    if (distribution == NULL) {
+        return;
+    }
+    free(distribution->states);
+    free(distribution->probabilities);
+    *distribution = (SparseDistribution) {0, NULL, NULL, 0};
+}
@@ -0,0 +1,62 @@
+#ifndef _MARKOV_QUERY_H
+#define _MARKOV_QUERY_H
+
+#include "markov_matrix.h"
+
+/**
+ * Sparse probability vector over state ids, sorted by state id.
+ */
+typedef struct SparseDistribution {
+    int size;
+    int *states;
+    double *probabilities;
+    // mass dropped by epsilon pruning on the way, so the entries sum to
+    // 1 - pruned
+    double pruned;
+} SparseDistribution;
+
+/**
+ * For each start state, compute the exact distribution of the walk's
+ * position after the given number of steps. A walk stops, and keeps its
+ * mass where it is, on a last state or a state without successors - the
+ * same way generate_random_sequence() stops.
+ * All starts share one scratch workspace, so a batch costs a single
+ * allocation of O(num_states) plus the results.
+ * @param matrix snapshot of the chain
+ * @param start_states ids of the start states
+ * @param num_starts number of start states
+ * @param steps number of steps to propagate, 0 or more
+ * @param epsilon entries below this probability are dropped after each
+ * step, 0 keeps everything
+ * @param results output array of num_starts distributions, free each with
+ * free_sparse_distribution()
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int k_step_distribution(const ChainMatrix *matrix, const int *start_states,
+                        int num_starts, int steps, double epsilon,
+                        SparseDistribution *results);
+
+/**
+ * For each start state, compute the probability that a walk from it
+ * reaches a last state within the given number of steps. A start state that
+ * is itself a last state counts as reached.
+ * @param matrix snapshot of the chain
+ * @param start_states ids of the start states
+ * @param num_starts number of start states
+ * @param steps maximal number of steps, 0 or more
+ * @param epsilon frontier entries below this probability are dropped after
+ * each step, so the answer is a lower bound off by less than the dropped mass
+ * @param probabilities output array of num_starts probabilities
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int reach_last_probability(const ChainMatrix *matrix, const int *start_states,
+                           int num_starts, int steps, double epsilon,
+                           double *probabilities);
+
+/**
+ * Free the entries of a distribution (not the struct itself) and reset it.
+ * @param distribution distribution to free
+ */
+void free_sparse_distribution(SparseDistribution *distribution);
+
+#endif /* _MARKOV_QUERY_H */
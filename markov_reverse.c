@@ -0,0 +1,171 @@
+#include "markov_reverse.h"
+
+#include <string.h>
+
+PredecessorIndex *build_predecessor_index(MarkovChain *markov_chain) {
+    if (markov_chain == NULL || markov_chain->database == NULL) {
+        return NULL;
+    }
+
+    PredecessorIndex *index = calloc(1, sizeof(PredecessorIndex));
+    if (index == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+
+    // First pass: number the states and count the edges
+    int num_states = 0;
+    size_t num_edges = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        current->data->id = num_states++;
+        num_edges += (size_t)current->data->frequency_list_size;
+    }
+    index->num_states = num_states;
+    index->num_edges = num_edges;
+
+    // Keep every array non-empty so a chain without edges is not an error
+    index->nodes = malloc(((size_t)num_states + 1) * sizeof(MarkovNode *));
+    index->offsets = calloc((size_t)num_states + 2, sizeof(size_t));
+    index->start_weights = calloc((size_t)num_states + 1, sizeof(uint64_t));
+    index->predecessors = malloc((num_edges + 1) * sizeof(MarkovNode *));
+    index->cumulative = malloc((num_edges + 1) * sizeof(uint64_t));
+    if (index->nodes == NULL || index->offsets == NULL || index->start_weights == NULL ||
+        index->predecessors == NULL || index->cumulative == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free_predecessor_index(&index);
+        return NULL;
+    }
+
+    // Second pass: count the predecessors of every state, shifted by one so
+    // the prefix sums leave offsets[i + 1] at the start of row i, the fill
+    // cursor of the third pass
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *markov_node = current->data;
+        index->nodes[markov_node->id] = markov_node;
+        for (int i = 0; i < markov_node->frequency_list_size; i++) {
+            index->offsets[markov_node->frequency_list[i]->id + 2]++;
+        }
+    }
+    for (int i = 2; i <= num_states + 1; i++) {
+        index->offsets[i] += index->offsets[i - 1];
+    }
+
+    // Third pass: fill the rows with the counts, in database order of the
+    // predecessors, and total what reaches every state
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *markov_node = current->data;
+        for (int i = 0; i < markov_node->frequency_list_size; i++) {
+            int successor = markov_node->frequency_list[i]->id;
+            size_t edge = index->offsets[successor + 1]++;
+            index->predecessors[edge] = markov_node;
+            index->cumulative[edge] = get_frequency(markov_node, i);
+            index->start_weights[successor] += index->cumulative[edge];
+        }
+    }
+
+    // Start weights out of what leaves and reaches each state, then the
+    // running sums of the rows on top of them
+    for (int id = 0; id < num_states; id++) {
+        MarkovNode *markov_node = index->nodes[id];
+        uint64_t incoming = index->start_weights[id];
+        uint64_t start = 0;
+        if (!markov_chain->is_last(markov_node->data) &&
+            markov_node->total_frequency > incoming) {
+            start = markov_node->total_frequency - incoming;
+        }
+        index->start_weights[id] = start;
+
+        uint64_t running = start;
+        for (size_t edge = index->offsets[id]; edge < index->offsets[id + 1]; edge++) {
+            running += index->cumulative[edge];
+            index->cumulative[edge] = running;
+        }
+    }
+
+    return index;
+}
+
+MarkovNode *get_previous_random_node_r(const PredecessorIndex *index,
+                                       const MarkovNode *markov_node, MarkovRandom *random) {
+    if (index == NULL || markov_node == NULL || random == NULL ||
+        markov_node->id < 0 || markov_node->id >= index->num_states) {
+        return NULL;
+    }
+
+    size_t low = index->offsets[markov_node->id];
+    size_t high = index->offsets[markov_node->id + 1];
+    uint64_t start = index->start_weights[markov_node->id];
+    uint64_t total = high > low ? index->cumulative[high - 1] : start;
+    if (total == 0) {
+        return NULL;
+    }
+
+    uint64_t random_num = next_random(random) % total;
+    if (random_num < start) {
+        return NULL;
+    }
+    // First edge whose running sum passes the draw
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (index->cumulative[middle] > random_num) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return index->predecessors[low];
+}
+
+int generate_through_sequence(const PredecessorIndex *index, MarkovChain *markov_chain,
+                              MarkovNode *seed, int max_length, MarkovRandom *random,
+                              MarkovNode **sequence, int *seed_position) {
+    if (index == NULL || markov_chain == NULL || seed == NULL || max_length <= 0 ||
+        random == NULL || sequence == NULL) {
+        return 0;
+    }
+
+    // Grow backward from the end of the output, then move it to the front
+    int first = max_length - 1;
+    sequence[first] = seed;
+    while (first > 0) {
+        MarkovNode *previous = get_previous_random_node_r(index, sequence[first], random);
+        if (previous == NULL) {
+            break;
+        }
+        sequence[--first] = previous;
+    }
+    int length = max_length - first;
+    memmove(sequence, sequence + first, (size_t)length * sizeof(MarkovNode *));
+    if (seed_position != NULL) {
+        *seed_position = length - 1;
+    }
+
+    // Then forward, like generate_random_sequence()
+    MarkovNode *current_node = seed;
+    while (length < max_length && !markov_chain->is_last(current_node->data)) {
+        current_node = get_next_random_node_r(current_node, random);
+        if (current_node == NULL) {
+            break;
+        }
+        sequence[length++] = current_node;
+    }
+    return length;
+}
+
+void free_predecessor_index(PredecessorIndex **index_ptr) {
+    if (index_ptr == NULL || *index_ptr == NULL) {
+        return;
+    }
+
+    PredecessorIndex *index = *index_ptr;
+    free(index->nodes);
+    free(index->offsets);
+    free(index->start_weights);
+    free(index->predecessors);
+    free(index->cumulative);
+    free(index);
+    *index_ptr = NULL;
+}
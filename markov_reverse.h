@@ -0,0 +1,76 @@
+#ifndef _MARKOV_REVERSE_H
+#define _MARKOV_REVERSE_H
+
+#include "markov_chain.h"
+#include <stddef.h> // for size_t
+
+/**
+ * Read-only predecessor index of a trained chain, for walking it backward.
+ * The predecessors of state i are predecessors[offsets[i]] ..
+ * predecessors[offsets[i + 1] - 1], indexed by state id.
+ *
+ * Each state also has a start weight, the number of times it began a
+ * sentence: what it was left more often than it was reached, for states
+ * that are not "last states". A backward step from a state stops there
+ * with probability start / (start + incoming), or else moves to a
+ * predecessor in proportion to its transition count, which reverses the
+ * training corpus exactly. Weights are kept as running sums per row, so a
+ * step is one binary search.
+ */
+typedef struct PredecessorIndex {
+    int num_states;
+    size_t num_edges;
+    // state id -> node of the chain the index was built from
+    MarkovNode **nodes;
+    size_t *offsets;
+    MarkovNode **predecessors;
+    // start weight of the row plus the counts of predecessors up to this one
+    uint64_t *cumulative;
+    uint64_t *start_weights;
+} PredecessorIndex;
+
+/**
+ * Build the predecessor index of the chain. State ids are the database
+ * order; the id field of every node is refreshed on the way. The index has
+ * to be rebuilt after the chain changes.
+ * @param markov_chain chain to index
+ * @return the index, NULL in case of allocation error
+ */
+PredecessorIndex *build_predecessor_index(MarkovChain *markov_chain);
+
+/**
+ * Draw one backward step.
+ * @param index index of the chain
+ * @param markov_node state to step back from
+ * @param random stream to draw from
+ * @return the predecessor, NULL if the draw makes markov_node the start
+ */
+MarkovNode *get_previous_random_node_r(const PredecessorIndex *index,
+                                       const MarkovNode *markov_node, MarkovRandom *random);
+
+/**
+ * Generate a sequence that goes through a given state: grow it backward
+ * from the state to a start, then forward like generate_random_sequence()
+ * until a "last state". If max_length is reached first, the backward part
+ * keeps the states closest to the seed and the forward part is cut.
+ * @param index index of the chain
+ * @param markov_chain chain the index was built from
+ * @param seed state the sequence goes through
+ * @param max_length maximum length of the sequence
+ * @param random stream to draw from
+ * @param sequence output, room for max_length states
+ * @param seed_position output, position of the seed in the sequence, may
+ * be NULL
+ * @return the sequence length, 0 on invalid arguments
+ */
+int generate_through_sequence(const PredecessorIndex *index, MarkovChain *markov_chain,
+                              MarkovNode *seed, int max_length, MarkovRandom *random,
+                              MarkovNode **sequence, int *seed_position);
+
+/**
+ * Free the index and set the pointer to NULL. The chain is not touched.
+ * @param index_ptr index to free
+ */
+void free_predecessor_index(PredecessorIndex **index_ptr);
+
+#endif /* _MARKOV_REVERSE_H */
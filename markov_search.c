@@ -0,0 +1,314 @@
+#include "markov_search.h"
+
+#include <math.h> // for log()
+
+/**
+ * A prefix under consideration: its score, last state, the history entry of
+ * the state before it (-1 for none) and its length.
+ */
+typedef struct Candidate {
+    double score;
+    int state;
+    int parent;
+    int length;
+} Candidate;
+
+/**
+ * A state on a kept prefix, linked to the entry of the state before it.
+ */
+typedef struct HistoryEntry {
+    int state;
+    int parent;
+} HistoryEntry;
+
+/**
+ * Edge of a row paired with its probability, for sorting.
+ */
+typedef struct WeightedEdge {
+    double probability;
+    int column;
+} WeightedEdge;
+
+/**
+ * Order edges by descending probability, then by column for stability.
+ * @param first pointer to the first WeightedEdge
+ * @param second pointer to the second WeightedEdge
+ * @return negative, zero or positive like strcmp
+ */
+static int compare_edges(const void *first, const void *second) {
+    const WeightedEdge *a = first;
+    const WeightedEdge *b = second;
+    if (a->probability != b->probability) {
+        return a->probability > b->probability ? -1 : 1;
+    }
+    return (a->column > b->column) - (a->column < b->column);
+}
+
+SortedSuccessors *build_sorted_successors(const ChainMatrix *matrix) {
+    if (matrix == NULL) {
+        return NULL;
+    }
+
+    SortedSuccessors *successors = malloc(sizeof(SortedSuccessors));
+    if (successors == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    successors->matrix = matrix;
+    successors->columns = malloc((matrix->num_edges + 1) * sizeof(int));
+    successors->log_probabilities = malloc((matrix->num_edges + 1) * sizeof(double));
+
+    // Scratch row buffer, sized for the widest row
+    size_t widest = 1;
+    for (int i = 0; i < matrix->num_states; i++) {
+        size_t width = matrix->row_offsets[i + 1] - matrix->row_offsets[i];
+        widest = width > widest ? width : widest;
+    }
+    WeightedEdge *row = malloc(widest * sizeof(WeightedEdge));
+    if (successors->columns == NULL || successors->log_probabilities == NULL ||
+        row == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(row);
+        free_sorted_successors(&successors);
+        return NULL;
+    }
+
+    for (int i = 0; i < matrix->num_states; i++) {
+        size_t first = matrix->row_offsets[i];
+        size_t width = matrix->row_offsets[i + 1] - first;
+        for (size_t e = 0; e < width; e++) {
+            row[e] = (WeightedEdge) {matrix->probabilities[first + e],
+                                     matrix->columns[first + e]};
+        }
+        qsort(row, width, sizeof(WeightedEdge), compare_edges);
+        for (size_t e = 0; e < width; e++) {
+            successors->columns[first + e] = row[e].column;
+            successors->log_probabilities[first + e] = log(row[e].probability);
+        }
+    }
+
+    free(row);
+    return successors;
+}
+
+/**
+ * Restore the min-heap property downwards from the root.
+ * @param heap heap array, lowest score at the root
+ * @param size number of entries
+ */
+static void sift_down(Candidate *heap, int size) {
+    int index = 0;
+    while (1) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < size && heap[left].score < heap[smallest].score) {
+            smallest = left;
+        }
+        if (right < size && heap[right].score < heap[smallest].score) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+        Candidate swap = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = swap;
+        index = smallest;
+    }
+}
+
+/**
+ * Offer a candidate to a bounded min-heap that keeps the best capacity
+ * candidates.
+ * @param heap heap array of capacity entries
+ * @param size in/out number of entries
+ * @param capacity bound of the heap
+ * @param candidate candidate to offer
+ */
+static void offer_candidate(Candidate *heap, int *size, int capacity, Candidate candidate) {
+    if (*size < capacity) {
+        // Sift the new entry up
+        int index = (*size)++;
+        while (index > 0 && heap[(index - 1) / 2].score > candidate.score) {
+            heap[index] = heap[(index - 1) / 2];
+            index = (index - 1) / 2;
+        }
+        heap[index] = candidate;
+    } else if (candidate.score > heap[0].score) {
+        heap[0] = candidate;
+        sift_down(heap, *size);
+    }
+}
+
+/**
+ * Lowest score a new candidate has to beat to enter the heap.
+ * @param heap heap array
+ * @param size number of entries
+ * @param capacity bound of the heap
+ * @return the threshold, -infinity while the heap is not full
+ */
+static double heap_threshold(const Candidate *heap, int size, int capacity) {
+    return size < capacity ? -HUGE_VAL : heap[0].score;
+}
+
+/**
+ * Order candidates by descending score.
+ * @param first pointer to the first Candidate
+ * @param second pointer to the second Candidate
+ * @return negative, zero or positive like strcmp
+ */
+static int compare_candidates(const void *first, const void *second) {
+    const Candidate *a = first;
+    const Candidate *b = second;
+    return (a->score < b->score) - (a->score > b->score);
+}
+
+/**
+ * Turn the complete candidates into results, best first.
+ * @param complete heap of complete candidates
+ * @param num_complete number of complete candidates
+ * @param history kept prefix states
+ * @param results output
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int export_results(Candidate *complete, int num_complete,
+                          const HistoryEntry *history, SearchResults *results) {
+    qsort(complete, (size_t)num_complete, sizeof(Candidate), compare_candidates);
+
+    size_t total_length = 1;
+    for (int i = 0; i < num_complete; i++) {
+        total_length += (size_t)complete[i].length;
+    }
+    results->sequences = malloc(((size_t)num_complete + 1) * sizeof(ScoredSequence));
+    results->states = malloc(total_length * sizeof(int));
+    if (results->sequences == NULL || results->states == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free_search_results(results);
+        return 1;
+    }
+
+    int *states = results->states;
+    for (int i = 0; i < num_complete; i++) {
+        // Walk the parent links back from the last state
+        int length = complete[i].length;
+        states[length - 1] = complete[i].state;
+        int entry = complete[i].parent;
+        for (int position = length - 2; position >= 0; position--) {
+            states[position] = history[entry].state;
+            entry = history[entry].parent;
+        }
+        results->sequences[i] = (ScoredSequence) {complete[i].score, length, states};
+        states += length;
+    }
+    results->count = num_complete;
+    return 0;
+}
+
+/**
+ * Whether a sequence has to end at the given state.
+ * @param matrix snapshot of the chain
+ * @param state state id
+ * @return true for last states and states without successors
+ */
+static bool ends_sequence(const ChainMatrix *matrix, int state) {
+    return matrix->is_last[state] ||
+           matrix->row_offsets[state] == matrix->row_offsets[state + 1];
+}
+
+int top_k_sequences(const SortedSuccessors *successors, int first_state, int k,
+                    int max_length, int beam_width, SearchResults *results) {
+    if (successors == NULL || results == NULL || k <= 0 || max_length <= 0 ||
+        beam_width <= 0 || first_state < 0 ||
+        first_state >= successors->matrix->num_states) {
+        return 1;
+    }
+    *results = (SearchResults) {0, NULL, NULL};
+
+    const ChainMatrix *matrix = successors->matrix;
+    size_t history_capacity = (size_t)max_length * (size_t)beam_width + 1;
+    HistoryEntry *history = malloc(history_capacity * sizeof(HistoryEntry));
+    Candidate *beam = malloc((size_t)beam_width * sizeof(Candidate));
+    Candidate *next_beam = malloc((size_t)beam_width * sizeof(Candidate));
+    Candidate *complete = malloc((size_t)k * sizeof(Candidate));
+    if (history == NULL || beam == NULL || next_beam == NULL || complete == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(history);
+        free(beam);
+        free(next_beam);
+        free(complete);
+        return 1;
+    }
+
+    int num_complete = 0;
+    int beam_size = 0;
+    int history_size = 0;
+    Candidate seed = {0, first_state, -1, 1};
+    if (ends_sequence(matrix, first_state) || max_length == 1) {
+        offer_candidate(complete, &num_complete, k, seed);
+    } else {
+        beam[beam_size++] = seed;
+    }
+
+    while (beam_size > 0) {
+        // Make the open prefixes part of the history, so children can link
+        for (int b = 0; b < beam_size; b++) {
+            history[history_size] = (HistoryEntry) {beam[b].state, beam[b].parent};
+            beam[b].parent = history_size++;
+        }
+
+        int next_size = 0;
+        for (int b = 0; b < beam_size; b++) {
+            const Candidate *prefix = &beam[b];
+            for (size_t e = matrix->row_offsets[prefix->state];
+                 e < matrix->row_offsets[prefix->state + 1]; e++) {
+                Candidate child = {prefix->score + successors->log_probabilities[e],
+                                   successors->columns[e], prefix->parent,
+                                   prefix->length + 1};
+
+                // Scores only drop along a prefix and the list is sorted, so
+                // once a child cannot beat the k-th result no sibling can
+                if (child.score <= heap_threshold(complete, num_complete, k)) {
+                    break;
+                }
+                if (ends_sequence(matrix, child.state) || child.length == max_length) {
+                    offer_candidate(complete, &num_complete, k, child);
+                } else if (child.score > heap_threshold(next_beam, next_size, beam_width)) {
+                    offer_candidate(next_beam, &next_size, beam_width, child);
+                }
+                // Otherwise keep scanning: a weaker sibling may still end here
+            }
+        }
+
+        Candidate *swap = beam;
+        beam = next_beam;
+        next_beam = swap;
+        beam_size = next_size;
+    }
+
+    int status = export_results(complete, num_complete, history, results);
+    free(history);
+    free(beam);
+    free(next_beam);
+    free(complete);
+    return status;
+}
+
+void free_search_results(SearchResults *results) {
+    if (results == NULL) {
+        return;
+    }
+    free(results->sequences);
+    free(results->states);
+    *results = (SearchResults) {0, NULL, NULL};
+}
+
+void free_sorted_successors(SortedSuccessors **successors_ptr) {
+    if (successors_ptr == NULL || *successors_ptr == NULL) {
+        return;
+    }
+    free((*successors_ptr)->columns);
+    free((*successors_ptr)->log_probabilities);
+    free(*successors_ptr);
+    *successors_ptr = NULL;
+}
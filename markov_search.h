@@ -0,0 +1,79 @@
+#ifndef _MARKOV_SEARCH_H
+#define _MARKOV_SEARCH_H
+
+#include "markov_matrix.h"
+
+/**
+ * Successor lists of a snapshot sorted by descending probability, with
+ * log-probabilities, so a search can stop scanning a list as soon as the
+ * rest cannot compete. Rows share matrix->row_offsets.
+ */
+typedef struct SortedSuccessors {
+    const ChainMatrix *matrix;
+    int *columns;
+    double *log_probabilities;
+} SortedSuccessors;
+
+/**
+ * One found sequence. states points into the SearchResults arena.
+ */
+typedef struct ScoredSequence {
+    double log_probability;
+    int length;
+    int *states;
+} ScoredSequence;
+
+/**
+ * Output of top_k_sequences(), best sequence first.
+ */
+typedef struct SearchResults {
+    int count;
+    ScoredSequence *sequences;
+    // all state ids of all sequences, back to back
+    int *states;
+} SearchResults;
+
+/**
+ * Sort every successor list of the snapshot by descending probability.
+ * @param matrix snapshot of the chain, must outlive the view
+ * @return the view, NULL in case of allocation error
+ */
+SortedSuccessors *build_sorted_successors(const ChainMatrix *matrix);
+
+/**
+ * Find the most probable continuations of a state with a beam search over
+ * log-probabilities. A sequence is complete when it reaches a last state, a
+ * state without successors, or max_length states. Each level keeps the
+ * beam_width best open prefixes in a bounded heap and the k best complete
+ * sequences in another; a sorted successor list is abandoned once its next
+ * entry cannot beat the k-th complete sequence, as no later sibling and no
+ * continuation can then. Entries too weak for the beam are still scanned,
+ * since one that ends a sequence may make the k best. Memory is
+ * O(max_length * beam_width + k * max_length) and time
+ * O(max_length * beam_width * fan-out * log(beam_width)), whatever the size
+ * of the chain. The result is exact when beam_width is at least the number
+ * of open prefixes per level, and a close approximation otherwise.
+ * @param successors sorted view of the chain
+ * @param first_state id of the seed state, always the first state
+ * @param k number of sequences to return, positive
+ * @param max_length maximum sequence length, positive
+ * @param beam_width open prefixes kept per level, positive
+ * @param results output, free with free_search_results()
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int top_k_sequences(const SortedSuccessors *successors, int first_state, int k,
+                    int max_length, int beam_width, SearchResults *results);
+
+/**
+ * Free the arrays of the results (not the struct itself) and reset them.
+ * @param results results to free
+ */
+void free_search_results(SearchResults *results);
+
+/**
+ * Free the view and set the pointer to NULL. The snapshot is not touched.
+ * @param successors_ptr view to free
+ */
+void free_sorted_successors(SortedSuccessors **successors_ptr);
+
+#endif /* _MARKOV_SEARCH_H */
@@ -0,0 +1,232 @@
+#include "markov_sketch.h"
+
+#include <math.h>
+
+// Most rows of a sketch, a failure probability of e^-64 at most
+#define MAX_DEPTH 64
+
+/**
+ * Key of a transition: the ids of its states, packed.
+ * @param first_node state
+ * @param second_node successor
+ * @return the key, distinct for distinct transitions
+ */
+static uint64_t transition_key(const MarkovNode *first_node, const MarkovNode *second_node) {
+    return ((uint64_t)(uint32_t)first_node->id << 32) | (uint32_t)second_node->id;
+}
+
+/**
+ * Hash a key for one row: the splitmix64 finalizer of the key xor a seed
+ * of that row's own.
+ * @param key transition key
+ * @param row row to hash for
+ * @return 64 well-mixed bits
+ */
+static uint64_t hash_for_row(uint64_t key, int row) {
+    uint64_t z = key ^ ((uint64_t)(row + 1) * 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Find the counter of a transition in each row. Every row mixes the key
+ * with its own seed, so two transitions sharing a counter in one row are no
+ * more likely than any others to share one in the next, as the error bound
+ * assumes.
+ * @param sketch sketch to look in
+ * @param key key of the transition
+ * @param slots output, one counter position per row
+ */
+static void find_counters(const CountMinSketch *sketch, uint64_t key, size_t *slots) {
+    size_t mask = sketch->width - 1;
+    for (int row = 0; row < sketch->depth; row++) {
+        slots[row] = (size_t)row * sketch->width + (size_t)(hash_for_row(key, row) & mask);
+    }
+}
+
+/**
+ * Read the estimate of a transition, the smallest of its counters.
+ * @param sketch sketch to read
+ * @param slots position of the transition's counter in each row
+ * @return the estimate
+ */
+static uint32_t read_estimate(const CountMinSketch *sketch, const size_t *slots) {
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < sketch->depth; row++) {
+        if (sketch->counters[slots[row]] < estimate) {
+            estimate = sketch->counters[slots[row]];
+        }
+    }
+    return estimate;
+}
+
+SketchChain *create_sketch_chain(MarkovChain *markov_chain, hash_func hash_func,
+                                 double epsilon, double delta, int top_k) {
+    if (markov_chain == NULL || markov_chain->database == NULL ||
+        markov_chain->database->size != 0 || hash_func == NULL || !(epsilon > 0) ||
+        !(epsilon < 1) || !(delta > 0) || !(delta < 1) || top_k <= 0 ||
+        ceil(log(1.0 / delta)) > MAX_DEPTH) {
+        return NULL;
+    }
+
+    SketchChain *sketch_chain = calloc(1, sizeof(SketchChain));
+    if (sketch_chain == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    sketch_chain->markov_chain = markov_chain;
+    sketch_chain->top_k = top_k;
+
+    size_t width = 1;
+    while ((double)width < exp(1.0) / epsilon) {
+        width *= 2;
+    }
+    sketch_chain->sketch.width = width;
+    sketch_chain->sketch.depth = (int)ceil(log(1.0 / delta));
+    if (sketch_chain->sketch.depth < 1) {
+        sketch_chain->sketch.depth = 1;
+    }
+
+    sketch_chain->sketch.counters = calloc(width * (size_t)sketch_chain->sketch.depth,
+                                           sizeof(uint32_t));
+    sketch_chain->sentence = malloc(sizeof(MarkovNode *));
+    sketch_chain->index = build_state_index(markov_chain, hash_func);
+    if (sketch_chain->sketch.counters == NULL || sketch_chain->sentence == NULL ||
+        sketch_chain->index == NULL) {
+        if (sketch_chain->sketch.counters == NULL || sketch_chain->sentence == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        }
+        free_sketch_chain(&sketch_chain);
+        return NULL;
+    }
+    sketch_chain->sentence_capacity = 1;
+    return sketch_chain;
+}
+
+/**
+ * Count one transition with a conservative update: the new estimate is the
+ * current one plus 1, and only counters below it are raised to it.
+ * @param sketch sketch to update
+ * @param key key of the transition
+ * @param slots scratch room for one position per row
+ * @return the new estimate
+ */
+static uint64_t count_transition(CountMinSketch *sketch, uint64_t key, size_t *slots) {
+    find_counters(sketch, key, slots);
+    uint32_t estimate = read_estimate(sketch, slots);
+    if (estimate < UINT32_MAX) {
+        estimate++;
+    }
+    for (int row = 0; row < sketch->depth; row++) {
+        if (sketch->counters[slots[row]] < estimate) {
+            sketch->counters[slots[row]] = estimate;
+        }
+    }
+    return estimate;
+}
+
+/**
+ * Bring a transition's estimate into the top-k list of its state: update
+ * its entry, add it while the list is short, or else replace the least
+ * counted successor if the estimate is now higher.
+ * @param sketch_chain sketch the list belongs to
+ * @param first_node state whose list to update
+ * @param second_node successor
+ * @param estimate new estimate of the transition
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int update_top_k(SketchChain *sketch_chain, MarkovNode *first_node,
+                        MarkovNode *second_node, uint64_t estimate) {
+    int smallest = 0;
+    uint64_t smallest_count = UINT64_MAX;
+    for (int i = 0; i < first_node->frequency_list_size; i++) {
+        uint64_t count = get_frequency(first_node, i);
+        if (first_node->frequency_list[i] == second_node) {
+            return set_successor(sketch_chain->markov_chain, first_node, i, second_node,
+                                 estimate);
+        }
+        if (count < smallest_count) {
+            smallest = i;
+            smallest_count = count;
+        }
+    }
+
+    if (first_node->frequency_list_size < sketch_chain->top_k) {
+        return add_transition_count(sketch_chain->markov_chain, first_node, second_node,
+                                    estimate);
+    }
+    if (estimate > smallest_count) {
+        return set_successor(sketch_chain->markov_chain, first_node, smallest, second_node,
+                             estimate);
+    }
+    return 0;
+}
+
+int sketch_add_sentence(SketchChain *sketch_chain, void **data, int length) {
+    if (sketch_chain == NULL || data == NULL || length < 0) {
+        return 1;
+    }
+
+    if ((size_t)length > sketch_chain->sentence_capacity) {
+        MarkovNode **new_sentence = realloc(sketch_chain->sentence,
+                                            (size_t)length * sizeof(MarkovNode *));
+        if (new_sentence == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return 1;
+        }
+        sketch_chain->sentence = new_sentence;
+        sketch_chain->sentence_capacity = (size_t)length;
+    }
+    if (index_add_batch(sketch_chain->index, sketch_chain->markov_chain, data,
+                        (size_t)length, sketch_chain->sentence) != 0) {
+        return 1;
+    }
+
+    size_t slots[MAX_DEPTH];
+    CountMinSketch *sketch = &sketch_chain->sketch;
+    for (int i = 0; i + 1 < length; i++) {
+        MarkovNode *first_node = sketch_chain->sentence[i];
+        MarkovNode *second_node = sketch_chain->sentence[i + 1];
+        uint64_t estimate = count_transition(sketch, transition_key(first_node, second_node),
+                                             slots);
+        sketch_chain->num_transitions++;
+        if (update_top_k(sketch_chain, first_node, second_node, estimate) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t sketch_estimate(const SketchChain *sketch_chain, const MarkovNode *first_node,
+                         const MarkovNode *second_node) {
+    if (sketch_chain == NULL || first_node == NULL || second_node == NULL) {
+        return 0;
+    }
+
+    size_t slots[MAX_DEPTH];
+    const CountMinSketch *sketch = &sketch_chain->sketch;
+    find_counters(sketch, transition_key(first_node, second_node), slots);
+    return read_estimate(sketch, slots);
+}
+
+uint64_t sketch_error_bound(const SketchChain *sketch_chain) {
+    if (sketch_chain == NULL) {
+        return 0;
+    }
+    return (uint64_t)ceil(exp(1.0) / (double)sketch_chain->sketch.width *
+                          (double)sketch_chain->num_transitions);
+}
+
+void free_sketch_chain(SketchChain **sketch_ptr) {
+    if (sketch_ptr == NULL || *sketch_ptr == NULL) {
+        return;
+    }
+
+    SketchChain *sketch_chain = *sketch_ptr;
+    free(sketch_chain->sketch.counters);
+    free(sketch_chain->sentence);
+    free_state_index(&sketch_chain->index);
+    free(sketch_chain);
+    *sketch_ptr = NULL;
+}
@@ -0,0 +1,95 @@
+#ifndef _MARKOV_SKETCH_H
+#define _MARKOV_SKETCH_H
+
+#include "markov_index.h"
+#include <stddef.h> // for size_t
+
+/**
+ * Count-min sketch of transition counts: depth rows of width counters,
+ * each (state, successor) pair counted in one counter per row. Every row
+ * hashes the pair with a seed of its own, so the rows are independent.
+ *
+ * Error bounds, for N transitions counted and epsilon = e / width: an
+ * estimate is never below the true count, and exceeds it by more than
+ * epsilon * N with probability at most e^-depth. Updates are conservative
+ * (only the counters at the current minimum are raised), which keeps these
+ * bounds and makes the overestimate much smaller in practice.
+ */
+typedef struct CountMinSketch {
+    // row after row, saturating at UINT32_MAX
+    uint32_t *counters;
+    // counters per row, a power of two
+    size_t width;
+    int depth;
+} CountMinSketch;
+
+/**
+ * Trains a chain with approximate counts in fixed memory. The chain's
+ * states are exact, but each frequency list holds at most top_k successors,
+ * with their sketch estimates as counters: a new successor takes the place
+ * of the least counted one once its estimate is higher. Sampling from the
+ * chain then works as usual, over the heavy successors of every state.
+ * Memory is the sketch plus top_k entries per state, whatever the length
+ * of the stream.
+ */
+typedef struct SketchChain {
+    MarkovChain *markov_chain;
+    StateIndex *index;
+    CountMinSketch sketch;
+    int top_k;
+    uint64_t num_transitions;
+    // states of the sentence being added
+    MarkovNode **sentence;
+    size_t sentence_capacity;
+} SketchChain;
+
+/**
+ * Create a sketch over an empty chain.
+ * @param markov_chain empty chain to train, not owned by the sketch
+ * @param hash_func hash consistent with markov_chain->comp_func
+ * @param epsilon relative error bound, in (0, 1); the width is e / epsilon
+ * rounded up to a power of two
+ * @param delta probability of exceeding the bound, in [e^-64, 1); the depth
+ * is ln(1 / delta) rounded up
+ * @param top_k successors kept per state, positive
+ * @return the sketch, NULL in case of allocation error or invalid arguments
+ */
+SketchChain *create_sketch_chain(MarkovChain *markov_chain, hash_func hash_func,
+                                 double epsilon, double delta, int top_k);
+
+/**
+ * Add one sentence like fill_database() does: its states, and one
+ * transition between each pair of consecutive states.
+ * @param sketch_chain sketch to add to
+ * @param data states of the sentence
+ * @param length number of states
+ * @return 0 on success, 1 in case of allocation error
+ */
+int sketch_add_sentence(SketchChain *sketch_chain, void **data, int length);
+
+/**
+ * Estimate how many times a transition was seen, whether or not the
+ * successor made it into the frequency list.
+ * @param sketch_chain sketch to query
+ * @param first_node state of the chain
+ * @param second_node state of the chain
+ * @return the estimate, at least the true count
+ */
+uint64_t sketch_estimate(const SketchChain *sketch_chain, const MarkovNode *first_node,
+                         const MarkovNode *second_node);
+
+/**
+ * The additive error bound of the estimates so far, epsilon * N.
+ * @param sketch_chain sketch to query
+ * @return the bound, in transitions
+ */
+uint64_t sketch_error_bound(const SketchChain *sketch_chain);
+
+/**
+ * Free the sketch and set the pointer to NULL. The chain keeps its
+ * frequency lists.
+ * @param sketch_ptr sketch to free
+ */
+void free_sketch_chain(SketchChain **sketch_ptr);
+
+#endif /* _MARKOV_SKETCH_H */
@@ -0,0 +1,382 @@
+#include "markov_stationary.h"
+
+#include <math.h>    // for fabs()
+#include <pthread.h> // for pthread_create(), pthread_cond_wait()
+#include <unistd.h>  // for sysconf()
+
+/**
+ * Incoming edges of every state, with edges leaving absorbing states (no
+ * successors, or last states when they restart) left out. The sources of
+ * state j are sources[offsets[j]] .. sources[offsets[j + 1] - 1].
+ */
+typedef struct IncomingEdges {
+    size_t *offsets;
+    int *sources;
+    double *weights;
+} IncomingEdges;
+
+/**
+ * Hand-off between the calling thread and the workers, which live for the
+ * whole run: each iteration the caller publishes the worker inputs, bumps
+ * step and waits until pending drops to 0.
+ */
+typedef struct StepControl {
+    pthread_mutex_t lock;
+    pthread_cond_t step_ready;
+    pthread_cond_t step_done;
+    // iterations started so far
+    unsigned long step;
+    // workers still busy with the current step
+    int pending;
+    bool stopping;
+} StepControl;
+
+/**
+ * Work and partial results of one thread for one iteration.
+ */
+typedef struct StationaryWorker {
+    StepControl *control;
+    const IncomingEdges *incoming;
+    const bool *absorbing;
+    const double *restart;
+    const double *current;
+    double *next;
+    int first_state;
+    int end_state;
+    double damping;
+    // mass that teleports into the restart distribution this iteration
+    double restart_mass;
+    // outputs: L1 change and absorbed mass of this thread's states
+    double residual;
+    double absorbed;
+} StationaryWorker;
+
+StationaryOptions default_stationary_options(void) {
+    return (StationaryOptions) {1.0, RESTART_START_STATES, true, 1e-10, 1000, 0};
+}
+
+/**
+ * Build the pull-side (transposed) view of the matrix, so each thread only
+ * writes the states it owns and no atomics are needed.
+ * @param matrix snapshot of the chain
+ * @param absorbing per state, whether its outgoing edges are ignored
+ * @param incoming output view
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int build_incoming_edges(const ChainMatrix *matrix, const bool *absorbing,
+                                IncomingEdges *incoming) {
+    size_t num_states = (size_t)matrix->num_states;
+    incoming->offsets = calloc(num_states + 1, sizeof(size_t));
+    incoming->sources = malloc((matrix->num_edges + 1) * sizeof(int));
+    incoming->weights = malloc((matrix->num_edges + 1) * sizeof(double));
+    if (incoming->offsets == NULL || incoming->sources == NULL ||
+        incoming->weights == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+
+    // Count the in-degree of every state, then turn counts into offsets
+    for (size_t i = 0; i < num_states; i++) {
+        if (absorbing[i]) {
+            continue;
+        }
+        for (size_t e = matrix->row_offsets[i]; e < matrix->row_offsets[i + 1]; e++) {
+            incoming->offsets[matrix->columns[e] + 1]++;
+        }
+    }
+    for (size_t j = 0; j < num_states; j++) {
+        incoming->offsets[j + 1] += incoming->offsets[j];
+    }
+
+    // Scatter the edges, reusing offsets[j] as the fill cursor of state j
+    for (size_t i = 0; i < num_states; i++) {
+        if (absorbing[i]) {
+            continue;
+        }
+        for (size_t e = matrix->row_offsets[i]; e < matrix->row_offsets[i + 1]; e++) {
+            size_t slot = incoming->offsets[matrix->columns[e]]++;
+            incoming->sources[slot] = (int)i;
+            incoming->weights[slot] = matrix->probabilities[e];
+        }
+    }
+    // The cursors now sit one state ahead, shift them back
+    for (size_t j = num_states; j > 0; j--) {
+        incoming->offsets[j] = incoming->offsets[j - 1];
+    }
+    incoming->offsets[0] = 0;
+    return 0;
+}
+
+/**
+ * One power iteration step over the states [first_state, end_state).
+ * @param worker the range and its inputs and outputs
+ */
+static void stationary_step(StationaryWorker *worker) {
+    const size_t *offsets = worker->incoming->offsets;
+    const int *sources = worker->incoming->sources;
+    const double *weights = worker->incoming->weights;
+    const double *current = worker->current;
+    double *next = worker->next;
+
+    double residual = 0;
+    double absorbed = 0;
+    for (int j = worker->first_state; j < worker->end_state; j++) {
+        double sum = 0;
+        for (size_t e = offsets[j]; e < offsets[j + 1]; e++) {
+            sum += current[sources[e]] * weights[e];
+        }
+        double value = worker->damping * sum + worker->restart_mass * worker->restart[j];
+        next[j] = value;
+        residual += fabs(value - current[j]);
+        absorbed += worker->absorbing[j] ? value : 0;
+    }
+
+    worker->residual = residual;
+    worker->absorbed = absorbed;
+}
+
+/**
+ * Worker thread: run one step per step published by the calling thread,
+ * until it stops the run.
+ * @param arg StationaryWorker of this thread
+ * @return NULL
+ */
+static void *stationary_worker_main(void *arg) {
+    StationaryWorker *worker = arg;
+    StepControl *control = worker->control;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&control->lock);
+    while (1) {
+        while (control->step == seen && !control->stopping) {
+            pthread_cond_wait(&control->step_ready, &control->lock);
+        }
+        if (control->stopping) {
+            break;
+        }
+        seen = control->step;
+        pthread_mutex_unlock(&control->lock);
+
+        stationary_step(worker);
+
+        pthread_mutex_lock(&control->lock);
+        if (--control->pending == 0) {
+            pthread_cond_signal(&control->step_done);
+        }
+    }
+    pthread_mutex_unlock(&control->lock);
+    return NULL;
+}
+
+/**
+ * Split the states into contiguous ranges of about equal work (states plus
+ * incoming edges) per thread.
+ * @param incoming pull-side view of the matrix
+ * @param num_states number of states
+ * @param workers array of num_workers workers to assign ranges to
+ * @param num_workers number of threads
+ */
+static void partition_states(const IncomingEdges *incoming, int num_states,
+                             StationaryWorker *workers, int num_workers) {
+    double total_work = (double)num_states + (double)incoming->offsets[num_states];
+    int state = 0;
+    for (int w = 0; w < num_workers; w++) {
+        workers[w].first_state = state;
+        double target = total_work * (w + 1) / num_workers;
+        while (state < num_states &&
+               (w == num_workers - 1 ||
+                (double)(state + 1) + (double)incoming->offsets[state + 1] <= target)) {
+            state++;
+        }
+        workers[w].end_state = state;
+    }
+}
+
+/**
+ * Run the power iteration with all buffers in place.
+ * @param matrix snapshot of the chain
+ * @param settings run options
+ * @param distribution output array, also the first iterate buffer
+ * @param scratch second iterate buffer
+ * @param absorbing per state, whether the walk ends there
+ * @param restart restart distribution
+ * @param workers one worker per thread
+ * @param threads one thread handle per worker
+ * @param control hand-off with the worker threads, initialized
+ * @param result output of the run statistics
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int power_iterate(const ChainMatrix *matrix, const StationaryOptions *settings,
+                         double *distribution, double *scratch, bool *absorbing,
+                         double *restart, StationaryWorker *workers, int num_threads,
+                         pthread_t *threads, StepControl *control,
+                         StationaryResult *result) {
+    int num_states = matrix->num_states;
+
+    // Absorbing states end the walk; restart mass spreads over the restart set
+    int num_restart_states = 0;
+    for (int i = 0; i < num_states; i++) {
+        absorbing[i] = matrix->row_offsets[i] == matrix->row_offsets[i + 1] ||
+                       (settings->restart_on_last && matrix->is_last[i]);
+        bool restarts = settings->restart == RESTART_UNIFORM || !matrix->is_last[i];
+        restart[i] = restarts ? 1 : 0;
+        num_restart_states += restarts;
+    }
+    for (int i = 0; i < num_states; i++) {
+        // Fall back to uniform if every state is a last state
+        restart[i] = num_restart_states > 0 ? restart[i] / num_restart_states
+                                            : 1.0 / num_states;
+    }
+
+    IncomingEdges incoming = {NULL, NULL, NULL};
+    if (build_incoming_edges(matrix, absorbing, &incoming) != 0) {
+        free(incoming.offsets);
+        free(incoming.sources);
+        free(incoming.weights);
+        return 1;
+    }
+    partition_states(&incoming, num_states, workers, num_threads);
+
+    // Start from the restart distribution
+    double *current = distribution;
+    double *next = scratch;
+    double absorbed = 0;
+    for (int i = 0; i < num_states; i++) {
+        current[i] = restart[i];
+        absorbed += absorbing[i] ? current[i] : 0;
+    }
+
+    for (int w = 0; w < num_threads; w++) {
+        workers[w].control = control;
+        workers[w].incoming = &incoming;
+        workers[w].absorbing = absorbing;
+        workers[w].restart = restart;
+        workers[w].damping = settings->damping;
+    }
+
+    // Start the workers once for the whole run; the calling thread takes the
+    // first range itself, and the ranges of threads that failed to start
+    int started = 1;
+    for (; started < num_threads; started++) {
+        if (pthread_create(&threads[started], NULL, stationary_worker_main,
+                           &workers[started]) != 0) {
+            break;
+        }
+    }
+
+    *result = (StationaryResult) {0, 0, false};
+    while (result->iterations < settings->max_iterations && !result->converged) {
+        double restart_mass = (1 - settings->damping) + settings->damping * absorbed;
+        pthread_mutex_lock(&control->lock);
+        for (int w = 0; w < num_threads; w++) {
+            workers[w].current = current;
+            workers[w].next = next;
+            workers[w].restart_mass = restart_mass;
+        }
+        control->step++;
+        control->pending = started - 1;
+        pthread_cond_broadcast(&control->step_ready);
+        pthread_mutex_unlock(&control->lock);
+
+        stationary_step(&workers[0]);
+        for (int w = started; w < num_threads; w++) {
+            stationary_step(&workers[w]);
+        }
+
+        pthread_mutex_lock(&control->lock);
+        while (control->pending > 0) {
+            pthread_cond_wait(&control->step_done, &control->lock);
+        }
+        pthread_mutex_unlock(&control->lock);
+
+        result->residual = 0;
+        absorbed = 0;
+        for (int w = 0; w < num_threads; w++) {
+            result->residual += workers[w].residual;
+            absorbed += workers[w].absorbed;
+        }
+        result->iterations++;
+        result->converged = result->residual < settings->tolerance;
+
+        double *swap = current;
+        current = next;
+        next = swap;
+    }
+
+    pthread_mutex_lock(&control->lock);
+    control->stopping = true;
+    pthread_cond_broadcast(&control->step_ready);
+    pthread_mutex_unlock(&control->lock);
+    for (int w = 1; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    // The latest iterate may sit in the scratch buffer
+    if (current != distribution) {
+        for (int i = 0; i < num_states; i++) {
+            distribution[i] = current[i];
+        }
+    }
+
+    free(incoming.offsets);
+    free(incoming.sources);
+    free(incoming.weights);
+    return 0;
+}
+
+int compute_stationary_distribution(const ChainMatrix *matrix,
+                                    const StationaryOptions *options,
+                                    double *distribution,
+                                    StationaryResult *result) {
+    StationaryOptions settings = options != NULL ? *options : default_stationary_options();
+    if (matrix == NULL || distribution == NULL || matrix->num_states <= 0 ||
+        settings.damping < 0 || settings.damping > 1) {
+        return 1;
+    }
+
+    int num_threads = settings.num_threads;
+    if (num_threads < 1) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = online > 0 ? (int)online : 1;
+    }
+    if (num_threads > matrix->num_states) {
+        num_threads = matrix->num_states;
+    }
+
+    size_t num_states = (size_t)matrix->num_states;
+    bool *absorbing = malloc(num_states * sizeof(bool));
+    double *restart = malloc(num_states * sizeof(double));
+    double *scratch = malloc(num_states * sizeof(double));
+    StationaryWorker *workers = malloc((size_t)num_threads * sizeof(StationaryWorker));
+    pthread_t *threads = malloc((size_t)num_threads * sizeof(pthread_t));
+
+    int status = 1;
+    StationaryResult run;
+    if (absorbing == NULL || restart == NULL || scratch == NULL ||
+        workers == NULL || threads == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+    } else {
+        StepControl control;
+        control.step = 0;
+        control.pending = 0;
+        control.stopping = false;
+        pthread_mutex_init(&control.lock, NULL);
+        pthread_cond_init(&control.step_ready, NULL);
+        pthread_cond_init(&control.step_done, NULL);
+        status = power_iterate(matrix, &settings, distribution, scratch, absorbing,
+                               restart, workers, num_threads, threads, &control, &run);
+        pthread_mutex_destroy(&control.lock);
+        pthread_cond_destroy(&control.step_ready);
+        pthread_cond_destroy(&control.step_done);
+    }
+
+    if (status == 0 && result != NULL) {
+        *result = run;
+    }
+    free(absorbing);
+    free(restart);
+    free(scratch);
+    free(workers);
+    free(threads);
+    return status;
+}
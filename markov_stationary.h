@@ -0,0 +1,73 @@
+#ifndef _MARKOV_STATIONARY_H
+#define _MARKOV_STATIONARY_H
+
+#include "markov_matrix.h"
+
+/**
+ * Where a walk restarts after it teleports or runs out of successors.
+ */
+typedef enum RestartMode {
+    // any state, uniformly
+    RESTART_UNIFORM,
+    // any state that is not a "last state", uniformly - the same start
+    // distribution get_first_random_node() samples from
+    RESTART_START_STATES
+} RestartMode;
+
+/**
+ * Knobs of compute_stationary_distribution(), see
+ * default_stationary_options() for the defaults.
+ */
+typedef struct StationaryOptions {
+    // probability of following an edge on each step, the rest teleports to
+    // the restart distribution. 1 follows the chain exactly; anything below
+    // 1 guarantees convergence on periodic chains.
+    double damping;
+    RestartMode restart;
+    // treat "last states" like states without successors: the walk ends
+    // there and restarts, even if the state has outgoing edges
+    bool restart_on_last;
+    // stop once the L1 change between two iterations drops below this
+    double tolerance;
+    int max_iterations;
+    // worker threads, values below 1 mean one per online CPU
+    int num_threads;
+} StationaryOptions;
+
+/**
+ * Outcome of a stationary distribution run.
+ */
+typedef struct StationaryResult {
+    int iterations;
+    // L1 change of the last iteration
+    double residual;
+    bool converged;
+} StationaryResult;
+
+/**
+ * Get the default options: exact chain (damping 1), restarts from start
+ * states, last states restart, tolerance 1e-10, at most 1000 iterations,
+ * one thread per CPU.
+ * @return the default options
+ */
+StationaryOptions default_stationary_options(void);
+
+/**
+ * Compute the long-run distribution over the states of the snapshot by
+ * power iteration. Mass reaching a state without successors (or a last
+ * state, if restart_on_last) is moved to the restart distribution, so the
+ * result always sums to 1.
+ * @param matrix snapshot of the chain
+ * @param options run options, NULL for the defaults
+ * @param distribution output array of matrix->num_states probabilities,
+ * indexed by state id
+ * @param result optional output of the run statistics, may be NULL
+ * @return 0 on success (converged or not, see result), 1 on invalid
+ * arguments or allocation error
+ */
+int compute_stationary_distribution(const ChainMatrix *matrix,
+                                    const StationaryOptions *options,
+                                    double *distribution,
+                                    StationaryResult *result);
+
+#endif /* _MARKOV_STATIONARY_H */
@@ -0,0 +1,157 @@
+#include "markov_terminal.h"
+
+/**
+ * Draw a uniform double in [0, 1).
+ * @param random stream to draw from
+ * @return random double
+ */
+static double random_unit(MarkovRandom *random) {
+    return (double)(next_random(random) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+TerminationTable *build_termination_table(const ChainMatrix *matrix, int max_length) {
+    if (matrix == NULL || max_length <= 0) {
+        return NULL;
+    }
+
+    size_t num_states = (size_t)matrix->num_states;
+    TerminationTable *table = malloc(sizeof(TerminationTable));
+    if (table == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    table->matrix = matrix;
+    table->max_length = max_length;
+    table->reach = malloc((size_t)max_length * num_states * sizeof(float) + 1);
+    table->start_weights = malloc((num_states + 1) * sizeof(double));
+    if (table->reach == NULL || table->start_weights == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free_termination_table(&table);
+        return NULL;
+    }
+
+    // Budget 1: only a last state itself terminates
+    for (size_t s = 0; s < num_states; s++) {
+        table->reach[s] = matrix->is_last[s] ? 1.0f : 0.0f;
+    }
+
+    // Budget b: a last state terminates, anything else terminates if the
+    // next step does within b - 1
+    for (int budget = 2; budget <= max_length; budget++) {
+        const float *shorter = table->reach + (size_t)(budget - 2) * num_states;
+        float *row = table->reach + (size_t)(budget - 1) * num_states;
+        for (size_t s = 0; s < num_states; s++) {
+            if (matrix->is_last[s]) {
+                row[s] = 1.0f;
+                continue;
+            }
+            double probability = 0;
+            for (size_t e = matrix->row_offsets[s]; e < matrix->row_offsets[s + 1]; e++) {
+                probability += matrix->probabilities[e] * shorter[matrix->columns[e]];
+            }
+            row[s] = (float)probability;
+        }
+    }
+
+    // Starts are the non-last states, weighted by their chance to finish
+    const float *full = table->reach + (size_t)(max_length - 1) * num_states;
+    double cumulative = 0;
+    for (size_t s = 0; s < num_states; s++) {
+        cumulative += matrix->is_last[s] ? 0 : full[s];
+        table->start_weights[s] = cumulative;
+    }
+    return table;
+}
+
+double get_termination_probability(const TerminationTable *table, int state, int budget) {
+    if (table == NULL || state < 0 || state >= table->matrix->num_states ||
+        budget < 1 || budget > table->max_length) {
+        return 0;
+    }
+    return table->reach[(size_t)(budget - 1) * (size_t)table->matrix->num_states + (size_t)state];
+}
+
+/**
+ * Draw a start state from the cumulative start weights.
+ * @param table analysis of the chain
+ * @param random stream to draw from
+ * @return state id, -1 if no state can terminate
+ */
+static int draw_start_state(const TerminationTable *table, MarkovRandom *random) {
+    int num_states = table->matrix->num_states;
+    double total = num_states > 0 ? table->start_weights[num_states - 1] : 0;
+    if (total <= 0) {
+        return -1;
+    }
+
+    // First state whose cumulative weight exceeds the draw
+    double target = random_unit(random) * total;
+    int low = 0, high = num_states - 1;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (table->start_weights[middle] > target) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+int generate_terminating_sequence(const TerminationTable *table, int first_state,
+                                  MarkovRandom *random, MarkovNode **sequence,
+                                  int *length) {
+    if (table == NULL || random == NULL || sequence == NULL || length == NULL ||
+        first_state >= table->matrix->num_states) {
+        return 1;
+    }
+
+    const ChainMatrix *matrix = table->matrix;
+    int state = first_state >= 0 ? first_state : draw_start_state(table, random);
+    if (state < 0 || get_termination_probability(table, state, table->max_length) <= 0) {
+        return 1;
+    }
+
+    int count = 0;
+    sequence[count++] = matrix->nodes[state];
+    while (!matrix->is_last[state]) {
+        // Successors that can finish within the states left after them
+        int remaining = table->max_length - count;
+        const float *reach = table->reach + (size_t)(remaining - 1) * (size_t)matrix->num_states;
+        double total = 0;
+        for (size_t e = matrix->row_offsets[state]; e < matrix->row_offsets[state + 1]; e++) {
+            total += matrix->probabilities[e] * reach[matrix->columns[e]];
+        }
+
+        double target = random_unit(random) * total;
+        size_t chosen = matrix->row_offsets[state + 1];
+        double cumulative = 0;
+        for (size_t e = matrix->row_offsets[state]; e < matrix->row_offsets[state + 1]; e++) {
+            double weight = matrix->probabilities[e] * reach[matrix->columns[e]];
+            cumulative += weight;
+            if (weight > 0) {
+                // Rounding may leave target at the very top, keep the last viable edge
+                chosen = e;
+                if (target < cumulative) {
+                    break;
+                }
+            }
+        }
+
+        state = matrix->columns[chosen];
+        sequence[count++] = matrix->nodes[state];
+    }
+
+    *length = count;
+    return 0;
+}
+
+void free_termination_table(TerminationTable **table_ptr) {
+    if (table_ptr == NULL || *table_ptr == NULL) {
+        return;
+    }
+    free((*table_ptr)->reach);
+    free((*table_ptr)->start_weights);
+    free(*table_ptr);
+    *table_ptr = NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef _MARKOV_TERMINAL_H
+#define _MARKOV_TERMINAL_H
+
+#include "markov_matrix.h"
+
+/**
+ * Backward reachability analysis of a chain snapshot for a length budget:
+ * for every state and every budget up to max_length, the probability that
+ * a walk from the state hits a last state within that many states
+ * (the state itself included).
+ */
+typedef struct TerminationTable {
+    const ChainMatrix *matrix;
+    int max_length;
+    // reach[(budget - 1) * num_states + state]
+    float *reach;
+    // cumulative start weights over state ids, see
+    // generate_terminating_sequence()
+    double *start_weights;
+} TerminationTable;
+
+/**
+ * Run the backward analysis, O(max_length * num_edges).
+ * @param matrix snapshot of the chain, must outlive the table
+ * @param max_length longest sequence to plan for, positive
+ * @return the table, NULL on invalid arguments or allocation error
+ */
+TerminationTable *build_termination_table(const ChainMatrix *matrix, int max_length);
+
+/**
+ * Get the probability that a walk from the state reaches a last state
+ * within the given number of states.
+ * @param table analysis of the chain
+ * @param state state id
+ * @param budget number of states, 1 to table->max_length
+ * @return the probability, 0 for out of range arguments
+ */
+double get_termination_probability(const TerminationTable *table, int state, int budget);
+
+/**
+ * Generate a sequence that ends on a last state within table->max_length
+ * states, on the first try. Each step only samples successors that can
+ * still finish in the remaining budget, weighted by transition probability
+ * times their chance to finish, which is exactly the chain's distribution
+ * conditioned on terminating in time.
+ * @param table analysis of the chain
+ * @param first_state id of the first state, or -1 to draw a start state
+ * (not a last state) with the conditional start distribution
+ * @param random stream to draw from
+ * @param sequence output buffer of at least table->max_length nodes
+ * @param length output, number of states written
+ * @return 0 on success, 1 if no terminating sequence exists from the start
+ * (or from any start, for -1) or on invalid arguments
+ */
+int generate_terminating_sequence(const TerminationTable *table, int first_state,
+                                  MarkovRandom *random, MarkovNode **sequence,
+                                  int *length);
+
+/**
+ * Free the table and set the pointer to NULL. The snapshot is not touched.
+ * @param table_ptr table to free
+ */
+void free_termination_table(TerminationTable **table_ptr);
+
+#endif /* _MARKOV_TERMINAL_H */
@@ -0,0 +1,419 @@
+#include "markov_vocabulary.h"
+
+#include <string.h>
+
+#define MIN_SLOTS_CAPACITY 16
+
+/**
+ * Copy function of shared chains: the vocabulary owns the data.
+ * @param data state data of the vocabulary
+ * @return the same pointer
+ */
+static void *share_data(void *data) {
+    return data;
+}
+
+/**
+ * Free function of shared chains: the vocabulary frees the data.
+ * @param data state data of the vocabulary
+ */
+static void keep_data(void *data) {
+    (void)data;
+}
+
+/**
+ * Make room for at least needed elements in a zero-filled array.
+ * @param array array to grow, may be NULL
+ * @param capacity current number of elements, updated on success
+ * @param needed number of elements required
+ * @param element_size size of one element
+ * @return the array, possibly moved; NULL in case of allocation error, the
+ * old array being left as is
+ */
+static void *reserve(void *array, size_t *capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) {
+        return array;
+    }
+    size_t new_capacity = *capacity > 0 ? *capacity : 16;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    char *grown = realloc(array, new_capacity * element_size);
+    if (grown == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    memset(grown + *capacity * element_size, 0, (new_capacity - *capacity) * element_size);
+    *capacity = new_capacity;
+    return grown;
+}
+
+Vocabulary *create_vocabulary(MarkovChain *states, hash_func hash_func) {
+    if (states == NULL || states->database == NULL || states->database->size != 0 ||
+        hash_func == NULL) {
+        return NULL;
+    }
+
+    Vocabulary *vocabulary = calloc(1, sizeof(Vocabulary));
+    if (vocabulary == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    vocabulary->index = build_state_index(states, hash_func);
+    if (vocabulary->index == NULL) {
+        free(vocabulary);
+        return NULL;
+    }
+    vocabulary->states = states;
+    vocabulary->references = 1;
+    return vocabulary;
+}
+
+/**
+ * Find or add many states at once.
+ * @param vocabulary vocabulary to look in
+ * @param data the states
+ * @param length number of states
+ * @param nodes output, the vocabulary node of every state
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int intern_states(Vocabulary *vocabulary, void **data, size_t length,
+                         MarkovNode **nodes) {
+    if (index_add_batch(vocabulary->index, vocabulary->states, data, length, nodes) != 0) {
+        return 1;
+    }
+    void **grown = reserve(vocabulary->data, &vocabulary->capacity,
+                           (size_t)vocabulary->states->database->size, sizeof(void *));
+    if (grown == NULL) {
+        return 1;
+    }
+    vocabulary->data = grown;
+    for (size_t i = 0; i < length; i++) {
+        vocabulary->data[nodes[i]->id] = nodes[i]->data;
+    }
+    return 0;
+}
+
+int vocabulary_intern(Vocabulary *vocabulary, void *data) {
+    if (vocabulary == NULL || data == NULL) {
+        return -1;
+    }
+    MarkovNode *node;
+    if (intern_states(vocabulary, &data, 1, &node) != 0) {
+        return -1;
+    }
+    return node->id;
+}
+
+int vocabulary_find(const Vocabulary *vocabulary, void *data) {
+    if (vocabulary == NULL || data == NULL) {
+        return -1;
+    }
+    MarkovNode *node = index_lookup(vocabulary->index, data);
+    return node != NULL ? node->id : -1;
+}
+
+void retain_vocabulary(Vocabulary *vocabulary) {
+    if (vocabulary != NULL) {
+        vocabulary->references++;
+    }
+}
+
+void release_vocabulary(Vocabulary **vocabulary_ptr) {
+    if (vocabulary_ptr == NULL || *vocabulary_ptr == NULL) {
+        return;
+    }
+
+    Vocabulary *vocabulary = *vocabulary_ptr;
+    *vocabulary_ptr = NULL;
+    if (--vocabulary->references > 0) {
+        return;
+    }
+    free_state_index(&vocabulary->index);
+    free_database(&vocabulary->states);
+    free(vocabulary->data);
+    free(vocabulary);
+}
+
+SharedChain *create_shared_chain(Vocabulary *vocabulary) {
+    if (vocabulary == NULL) {
+        return NULL;
+    }
+
+    SharedChain *shared_chain = calloc(1, sizeof(SharedChain));
+    if (shared_chain == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    MarkovChain *states = vocabulary->states;
+    shared_chain->markov_chain = create_markov_chain(states->print_func, states->comp_func,
+                                                     keep_data, share_data, states->is_last);
+    if (shared_chain->markov_chain == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(shared_chain);
+        return NULL;
+    }
+    retain_vocabulary(vocabulary);
+    shared_chain->vocabulary = vocabulary;
+    return shared_chain;
+}
+
+/**
+ * Home slot of a vocabulary id (Fibonacci hashing: ids are dense, so their
+ * low bits alone would cluster).
+ * @param id vocabulary id
+ * @param capacity number of slots, a power of two
+ * @return the slot to start probing at
+ */
+static size_t home_slot(uint32_t id, size_t capacity) {
+    return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+/**
+ * The chain's state of a vocabulary id, without adding it.
+ * @param shared_chain chain to look in
+ * @param id vocabulary id
+ * @return the state, NULL if the chain lacks it
+ */
+static MarkovNode *find_state(const SharedChain *shared_chain, uint32_t id) {
+    if (shared_chain->slots_capacity == 0) {
+        return NULL;
+    }
+    size_t mask = shared_chain->slots_capacity - 1;
+    for (size_t slot = home_slot(id, shared_chain->slots_capacity);
+         shared_chain->slots[slot] != NULL; slot = (slot + 1) & mask) {
+        if (shared_chain->ids[shared_chain->slots[slot]->id] == id) {
+            return shared_chain->slots[slot];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Put a state in the first free slot of its probe sequence.
+ * @param slots table with room for the state
+ * @param capacity number of slots, a power of two
+ * @param id vocabulary id of the state
+ * @param markov_node the chain's state
+ */
+static void place_state(MarkovNode **slots, size_t capacity, uint32_t id,
+                        MarkovNode *markov_node) {
+    size_t slot = home_slot(id, capacity);
+    while (slots[slot] != NULL) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    slots[slot] = markov_node;
+}
+
+/**
+ * Double the slot table, or create it, and rehash the chain's states.
+ * @param shared_chain chain whose table to grow
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int grow_slots(SharedChain *shared_chain) {
+    size_t capacity = shared_chain->slots_capacity > 0 ? shared_chain->slots_capacity * 2
+                                                       : MIN_SLOTS_CAPACITY;
+    MarkovNode **slots = calloc(capacity, sizeof(MarkovNode *));
+    if (slots == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    for (size_t i = 0; i < shared_chain->slots_capacity; i++) {
+        MarkovNode *markov_node = shared_chain->slots[i];
+        if (markov_node != NULL) {
+            place_state(slots, capacity, shared_chain->ids[markov_node->id], markov_node);
+        }
+    }
+    free(shared_chain->slots);
+    shared_chain->slots = slots;
+    shared_chain->slots_capacity = capacity;
+    return 0;
+}
+
+MarkovNode *shared_chain_state(SharedChain *shared_chain, uint32_t id) {
+    if (shared_chain == NULL ||
+        id >= (uint32_t)shared_chain->vocabulary->states->database->size) {
+        return NULL;
+    }
+    MarkovNode *found = find_state(shared_chain, id);
+    if (found != NULL) {
+        return found;
+    }
+
+    // Keep the load factor at or below 1/2
+    MarkovChain *markov_chain = shared_chain->markov_chain;
+    size_t size = (size_t)markov_chain->database->size;
+    if (2 * (size + 1) > shared_chain->slots_capacity && grow_slots(shared_chain) != 0) {
+        return NULL;
+    }
+    uint32_t *ids = reserve(shared_chain->ids, &shared_chain->ids_capacity, size + 1,
+                            sizeof(uint32_t));
+    if (ids == NULL) {
+        return NULL;
+    }
+    shared_chain->ids = ids;
+
+    Node *node = append_to_database(markov_chain, shared_chain->vocabulary->data[id]);
+    if (node == NULL) {
+        return NULL;
+    }
+    shared_chain->ids[node->data->id] = id;
+    place_state(shared_chain->slots, shared_chain->slots_capacity, id, node->data);
+    return node->data;
+}
+
+int shared_add_sentence(SharedChain *shared_chain, void **data, int length) {
+    if (shared_chain == NULL || data == NULL || length < 0) {
+        return 1;
+    }
+
+    MarkovNode **sentence = reserve(shared_chain->sentence, &shared_chain->sentence_capacity,
+                                    (size_t)length, sizeof(MarkovNode *));
+    if (sentence == NULL) {
+        return 1;
+    }
+    shared_chain->sentence = sentence;
+
+    // Vocabulary nodes first, then this chain's nodes in their place
+    if (intern_states(shared_chain->vocabulary, data, (size_t)length, sentence) != 0) {
+        return 1;
+    }
+    for (int i = 0; i < length; i++) {
+        sentence[i] = shared_chain_state(shared_chain, (uint32_t)sentence[i]->id);
+        if (sentence[i] == NULL) {
+            return 1;
+        }
+        if (i > 0 && add_node_to_frequency_list(shared_chain->markov_chain, sentence[i - 1],
+                                                sentence[i]) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int merge_shared_chains(SharedChain *into, const SharedChain *from) {
+    if (into == NULL || from == NULL || into->vocabulary != from->vocabulary) {
+        return 1;
+    }
+
+    for (Node *current = from->markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *from_node = current->data;
+        MarkovNode *into_node = shared_chain_state(into, from->ids[from_node->id]);
+        if (into_node == NULL) {
+            return 1;
+        }
+        for (int i = 0; i < from_node->frequency_list_size; i++) {
+            MarkovNode *successor =
+                shared_chain_state(into, from->ids[from_node->frequency_list[i]->id]);
+            if (successor == NULL ||
+                add_transition_count(into->markov_chain, into_node, successor,
+                                     get_frequency(from_node, i)) != 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * One successor of a state, by vocabulary id, with its probability.
+ */
+typedef struct SharedSuccessor {
+    uint32_t id;
+    double probability;
+} SharedSuccessor;
+
+/**
+ * Order successors by vocabulary id.
+ */
+static int compare_successors(const void *first, const void *second) {
+    const SharedSuccessor *a = first, *b = second;
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+/**
+ * Collect the successor distribution of a state, sorted by vocabulary id.
+ * @param shared_chain chain of the state
+ * @param markov_node the state, may be NULL
+ * @param size output, number of successors
+ * @return the successors, NULL without successors or in case of allocation
+ * error (told apart by size)
+ */
+static SharedSuccessor *collect_successors(const SharedChain *shared_chain,
+                                           const MarkovNode *markov_node, int *size) {
+    *size = markov_node != NULL ? markov_node->frequency_list_size : 0;
+    if (*size == 0) {
+        return NULL;
+    }
+    SharedSuccessor *successors = malloc((size_t)*size * sizeof(SharedSuccessor));
+    if (successors == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    for (int i = 0; i < *size; i++) {
+        successors[i].id = shared_chain->ids[markov_node->frequency_list[i]->id];
+        successors[i].probability = (double)get_frequency(markov_node, i) /
+                                    (double)markov_node->total_frequency;
+    }
+    qsort(successors, (size_t)*size, sizeof(SharedSuccessor), compare_successors);
+    return successors;
+}
+
+double shared_successor_distance(const SharedChain *first, const SharedChain *second,
+                                 uint32_t id) {
+    if (first == NULL || second == NULL || first->vocabulary != second->vocabulary) {
+        return -1;
+    }
+
+    int first_size, second_size;
+    SharedSuccessor *first_successors = collect_successors(first, find_state(first, id),
+                                                           &first_size);
+    SharedSuccessor *second_successors = collect_successors(second, find_state(second, id),
+                                                            &second_size);
+    if ((first_size > 0 && first_successors == NULL) ||
+        (second_size > 0 && second_successors == NULL)) {
+        free(first_successors);
+        free(second_successors);
+        return -1;
+    }
+    if (first_size == 0 || second_size == 0) {
+        free(first_successors);
+        free(second_successors);
+        return first_size == second_size ? 0 : 1;
+    }
+
+    // Merge the two sorted lists
+    double distance = 0;
+    int i = 0, j = 0;
+    while (i < first_size || j < second_size) {
+        if (j == second_size ||
+            (i < first_size && first_successors[i].id < second_successors[j].id)) {
+            distance += first_successors[i++].probability;
+        } else if (i == first_size || second_successors[j].id < first_successors[i].id) {
+            distance += second_successors[j++].probability;
+        } else {
+            double difference = first_successors[i++].probability -
+                                second_successors[j++].probability;
+            distance += difference < 0 ? -difference : difference;
+        }
+    }
+    free(first_successors);
+    free(second_successors);
+    return distance / 2;
+}
+
+void free_shared_chain(SharedChain **shared_ptr) {
+    if (shared_ptr == NULL || *shared_ptr == NULL) {
+        return;
+    }
+
+    SharedChain *shared_chain = *shared_ptr;
+    free_database(&shared_chain->markov_chain);
+    free(shared_chain->slots);
+    free(shared_chain->ids);
+    free(shared_chain->sentence);
+    release_vocabulary(&shared_chain->vocabulary);
+    free(shared_chain);
+    *shared_ptr = NULL;
+}
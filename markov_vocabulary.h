@@ -0,0 +1,143 @@
+#ifndef _MARKOV_VOCABULARY_H
+#define _MARKOV_VOCABULARY_H
+
+#include "markov_index.h"
+#include <stddef.h> // for size_t
+
+/**
+ * Registry of states shared by many chains, each state stored once and
+ * numbered by a vocabulary id in order of first appearance. Reference
+ * counted: every attached chain holds a reference, and the last release
+ * frees the states. Not thread-safe, like the chains themselves.
+ */
+typedef struct Vocabulary {
+    // one edgeless node per state, owning its data; node id = vocabulary id
+    MarkovChain *states;
+    StateIndex *index;
+    // vocabulary id -> state data
+    void **data;
+    size_t capacity;
+    int references;
+} Vocabulary;
+
+/**
+ * A chain whose states live in a vocabulary. The chain's nodes point at the
+ * vocabulary's data instead of copies, so only the edges are per chain, and
+ * two chains over the same vocabulary can be related id by id.
+ * Operations that renumber the states of a chain (relayout_chain(),
+ * remove_isolated_states()) must not be used on it.
+ */
+typedef struct SharedChain {
+    // copy_func is the identity and free_data does nothing
+    MarkovChain *markov_chain;
+    Vocabulary *vocabulary;
+    // vocabulary id -> state of this chain: open addressing over the
+    // chain's own states, keyed by their vocabulary id, so a chain using a
+    // small part of a large vocabulary stays small. Power of two capacity,
+    // load factor at most 1/2.
+    MarkovNode **slots;
+    size_t slots_capacity;
+    // state id of this chain -> vocabulary id
+    uint32_t *ids;
+    size_t ids_capacity;
+    // states of the sentence being added
+    MarkovNode **sentence;
+    size_t sentence_capacity;
+} SharedChain;
+
+/**
+ * Create a vocabulary with one reference, held by the caller.
+ * @param states empty chain whose callbacks define the states; the
+ * vocabulary takes it over and frees it with the last reference
+ * @param hash_func hash consistent with states->comp_func
+ * @return the vocabulary, NULL in case of allocation error or invalid
+ * arguments (the chain is then left to the caller)
+ */
+Vocabulary *create_vocabulary(MarkovChain *states, hash_func hash_func);
+
+/**
+ * Find or add a state.
+ * @param vocabulary vocabulary to look in
+ * @param data the state, copied with the vocabulary's copy_func if new
+ * @return its vocabulary id, -1 in case of allocation error
+ */
+int vocabulary_intern(Vocabulary *vocabulary, void *data);
+
+/**
+ * Find a state.
+ * @param vocabulary vocabulary to look in
+ * @param data the state
+ * @return its vocabulary id, -1 if not in the vocabulary
+ */
+int vocabulary_find(const Vocabulary *vocabulary, void *data);
+
+/**
+ * Take one more reference to the vocabulary.
+ * @param vocabulary vocabulary to keep alive
+ */
+void retain_vocabulary(Vocabulary *vocabulary);
+
+/**
+ * Drop a reference and set the pointer to NULL. The last one frees the
+ * vocabulary and its states.
+ * @param vocabulary_ptr reference to drop
+ */
+void release_vocabulary(Vocabulary **vocabulary_ptr);
+
+/**
+ * Create an empty chain over a vocabulary, holding a reference to it.
+ * @param vocabulary vocabulary of the states
+ * @return the chain, NULL in case of allocation error
+ */
+SharedChain *create_shared_chain(Vocabulary *vocabulary);
+
+/**
+ * Get the chain's state of a vocabulary id, adding it if needed.
+ * @param shared_chain chain to look in
+ * @param id vocabulary id
+ * @return the state, NULL in case of allocation error or unknown id
+ */
+MarkovNode *shared_chain_state(SharedChain *shared_chain, uint32_t id);
+
+/**
+ * Add one sentence like fill_database() does, interning its states in the
+ * vocabulary.
+ * @param shared_chain chain to add to
+ * @param data states of the sentence
+ * @param length number of states
+ * @return 0 on success, 1 in case of allocation error
+ */
+int shared_add_sentence(SharedChain *shared_chain, void **data, int length);
+
+/**
+ * Add every transition of one chain to another over the same vocabulary,
+ * like loading a saved chain merges it, but id by id without comparing or
+ * copying any state.
+ * @param into chain to merge into
+ * @param from chain to merge, not changed
+ * @return 0 on success, 1 in case of allocation error or different
+ * vocabularies
+ */
+int merge_shared_chains(SharedChain *into, const SharedChain *from);
+
+/**
+ * Total variation distance between the successor distributions of one
+ * state in two chains over the same vocabulary: half the sum of the
+ * probability differences, 0 for equal distributions, 1 for disjoint ones.
+ * @param first chain
+ * @param second chain
+ * @param id vocabulary id of the state
+ * @return the distance, 0 if neither chain has successors for the state,
+ * 1 if only one has, -1 in case of allocation error or different
+ * vocabularies
+ */
+double shared_successor_distance(const SharedChain *first, const SharedChain *second,
+                                 uint32_t id);
+
+/**
+ * Free the chain, drop its vocabulary reference and set the pointer to NULL.
+ * @param shared_ptr chain to free
+ */
+void free_shared_chain(SharedChain **shared_ptr);
+
+#endif /* _MARKOV_VOCABULARY_H */
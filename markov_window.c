@@ -0,0 +1,185 @@
+#include "markov_window.h"
+
+#include <math.h> // for exp2(), ldexp(), llround()
+
+ChainWindow *create_chain_window(MarkovChain *markov_chain, hash_func hash_func,
+                                 WindowMode mode, size_t sentences) {
+    if (markov_chain == NULL || markov_chain->database == NULL || hash_func == NULL ||
+        sentences == 0 || (mode == WINDOW_DECAY && markov_chain->database->size != 0)) {
+        return NULL;
+    }
+
+    ChainWindow *window = calloc(1, sizeof(ChainWindow));
+    if (window == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+    window->markov_chain = markov_chain;
+    window->mode = mode;
+    window->sentences = sentences;
+    window->first_state = markov_chain->database->size;
+
+    window->index = build_state_index(markov_chain, hash_func);
+    if (window->index == NULL) {
+        free(window);
+        return NULL;
+    }
+    if (mode == WINDOW_SLIDING) {
+        window->ring = calloc(sentences, sizeof(WindowSentence));
+        if (window->ring == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            free_state_index(&window->index);
+            free(window);
+            return NULL;
+        }
+    }
+    return window;
+}
+
+/**
+ * Take back the transitions of the oldest sentence of a sliding window.
+ * @param window sliding window with a full ring
+ */
+static void expire_oldest(ChainWindow *window) {
+    WindowSentence *oldest = &window->ring[window->ring_start];
+    for (int i = 0; i + 1 < oldest->length; i++) {
+        remove_transition_count(oldest->states[i], oldest->states[i + 1], 1);
+    }
+    free(oldest->states);
+    *oldest = (WindowSentence) {NULL, 0};
+    window->ring_start = (window->ring_start + 1) % window->sentences;
+    window->ring_size--;
+    window->since_sweep++;
+}
+
+/**
+ * Weight of a transition added now to a decaying window.
+ * @param window decaying window
+ * @return 2^(DECAY_UNIT_BITS + since_rescale / half-life), rounded
+ */
+static uint64_t decay_weight(const ChainWindow *window) {
+    double exponent = (double)window->since_rescale / (double)window->sentences;
+    return (uint64_t)llround(ldexp(exp2(exponent), DECAY_UNIT_BITS));
+}
+
+/**
+ * Shift every count of the chain down by DECAY_RESCALE_HALF_LIVES bits, as
+ * the weights of new transitions start over that much lower, dropping the
+ * transitions whose count reaches 0.
+ * @param markov_chain chain to rescale
+ */
+static void rescale_counts(MarkovChain *markov_chain) {
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *markov_node = current->data;
+        // Backwards, since removals shift the later successors down
+        for (int i = markov_node->frequency_list_size - 1; i >= 0; i--) {
+            uint64_t count = get_frequency(markov_node, i);
+            remove_transition_count(markov_node, markov_node->frequency_list[i],
+                                    count - (count >> DECAY_RESCALE_HALF_LIVES));
+        }
+    }
+}
+
+/**
+ * Remove the isolated states the window added, and re-index the rest.
+ * @param window window to sweep
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int sweep_states(ChainWindow *window) {
+    window->since_sweep = 0;
+    if (remove_isolated_states(window->markov_chain, window->first_state) == 0) {
+        return 0;
+    }
+    // The index has no deletion; rebuilding costs about what the sweep did
+    hash_func hash_func = window->index->hash_func;
+    free_state_index(&window->index);
+    window->index = build_state_index(window->markov_chain, hash_func);
+    return window->index != NULL ? 0 : 1;
+}
+
+int window_add_sentence(ChainWindow *window, void **data, int length) {
+    if (window == NULL || window->index == NULL || (data == NULL && length > 0)) {
+        return 1;
+    }
+
+    // Rescale first: the sweep after it would take the sentence's new
+    // states, still without transitions, for isolated ones
+    if (window->mode == WINDOW_DECAY &&
+        window->since_rescale >= DECAY_RESCALE_HALF_LIVES * window->sentences) {
+        rescale_counts(window->markov_chain);
+        window->since_rescale = 0;
+        window->rescales++;
+        if (sweep_states(window) != 0) {
+            return 1;
+        }
+    }
+
+    MarkovNode **states = length > 0 ? malloc((size_t)length * sizeof(MarkovNode *)) : NULL;
+    if (length > 0 && states == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+    if (length > 0 &&
+        index_add_batch(window->index, window->markov_chain, data, (size_t)length,
+                        states) != 0) {
+        free(states);
+        return 1;
+    }
+
+    // Count the transitions, taking back the added ones if one fails so the
+    // ring always matches the counts
+    uint64_t weight = window->mode == WINDOW_DECAY ? decay_weight(window) : 1;
+    for (int i = 0; i + 1 < length; i++) {
+        if (add_transition_count(window->markov_chain, states[i], states[i + 1],
+                                 weight) != 0) {
+            for (int j = 0; j < i; j++) {
+                remove_transition_count(states[j], states[j + 1], weight);
+            }
+            free(states);
+            return 1;
+        }
+    }
+    window->total_sentences++;
+
+    if (window->mode == WINDOW_DECAY) {
+        free(states);
+        window->since_rescale++;
+        return 0;
+    }
+
+    if (window->ring_size == window->sentences) {
+        expire_oldest(window);
+    }
+    size_t slot = (window->ring_start + window->ring_size) % window->sentences;
+    // Sentences without transitions have nothing to expire
+    if (length < 2) {
+        free(states);
+        states = NULL;
+        length = 0;
+    }
+    window->ring[slot] = (WindowSentence) {states, length};
+    window->ring_size++;
+
+    // Sweep once a quarter of the window has expired since the last sweep
+    if (window->since_sweep * 4 >= window->sentences) {
+        return sweep_states(window);
+    }
+    return 0;
+}
+
+void free_chain_window(ChainWindow **window_ptr) {
+    if (window_ptr == NULL || *window_ptr == NULL) {
+        return;
+    }
+    ChainWindow *window = *window_ptr;
+    if (window->ring != NULL) {
+        for (size_t i = 0; i < window->sentences; i++) {
+            free(window->ring[i].states);
+        }
+        free(window->ring);
+    }
+    free_state_index(&window->index);
+    free(window);
+    *window_ptr = NULL;
+}
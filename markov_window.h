@@ -0,0 +1,101 @@
+#ifndef _MARKOV_WINDOW_H
+#define _MARKOV_WINDOW_H
+
+#include "markov_chain.h"
+#include "markov_index.h"
+#include <stddef.h> // for size_t
+
+// Fraction bits of decayed counts: a fresh transition weighs 2^8 at least
+#define DECAY_UNIT_BITS 8
+// Half-lives between two rescales of a decaying window
+#define DECAY_RESCALE_HALF_LIVES 8
+
+/**
+ * How a windowed chain forgets old sentences.
+ */
+typedef enum WindowMode {
+    // exact: the chain counts only the last N sentences
+    WINDOW_SLIDING,
+    // exponential: a transition's weight halves every N sentences
+    WINDOW_DECAY
+} WindowMode;
+
+/**
+ * One remembered sentence of a sliding window.
+ */
+typedef struct WindowSentence {
+    MarkovNode **states;
+    int length;
+} WindowSentence;
+
+/**
+ * Feeds a chain from an unbounded stream of sentences while keeping it
+ * bounded: transitions expire by mode, and states left without any
+ * transition are swept out of the database.
+ *
+ * Decay mode uses forward decay: instead of shrinking every old count each
+ * sentence, each new transition is counted with a weight that grows by
+ * 2^(1/N) per sentence, starting at 2^DECAY_UNIT_BITS, so the counts of a
+ * state always compare as exponentially decayed counts. Every
+ * DECAY_RESCALE_HALF_LIVES half-lives the weights have grown by that power
+ * of two and every count is shifted down by it at once; only a transition
+ * whose count reaches 0 then, one weighing less than 2^-DECAY_UNIT_BITS of
+ * a fresh one, is dropped.
+ */
+typedef struct ChainWindow {
+    MarkovChain *markov_chain;
+    // every state of the chain, for O(1) lookups of streamed states
+    StateIndex *index;
+    WindowMode mode;
+    // window length (sliding) or half-life (decay), in sentences
+    size_t sentences;
+    // database position of the first state the window added; the states
+    // before it were in the chain already and are never swept
+    int first_state;
+    // sliding only: ring of the last sentences, oldest at ring_start
+    WindowSentence *ring;
+    size_t ring_start;
+    size_t ring_size;
+    // decay only: sentences since the last rescale, and rescales so far
+    size_t since_rescale;
+    size_t rescales;
+    // sliding only: sentences expired since the last sweep; a decaying
+    // window sweeps after every rescale
+    size_t since_sweep;
+    size_t total_sentences;
+} ChainWindow;
+
+/**
+ * Create a window over a chain. In sliding mode the chain may already hold
+ * data; only sentences added through the window ever expire. In decay mode
+ * the chain must be empty, as its counts are weights in the window's scale.
+ * States that were in the chain before are never swept.
+ * @param markov_chain chain to feed, not owned by the window
+ * @param hash_func hash consistent with markov_chain->comp_func
+ * @param mode how counts expire
+ * @param sentences window length or half-life in sentences, positive
+ * @return the window, NULL in case of allocation error or invalid arguments
+ */
+ChainWindow *create_chain_window(MarkovChain *markov_chain, hash_func hash_func,
+                                 WindowMode mode, size_t sentences);
+
+/**
+ * Add one sentence: its states and the transitions between consecutive
+ * states, like fill_database() does, then expire what fell out of the
+ * window. Sweeps of isolated states run after a quarter of the window has
+ * expired, so their cost is amortized over the sentences.
+ * @param window window to add to
+ * @param data states of the sentence, copied into the chain as needed
+ * @param length number of states
+ * @return 0 on success, 1 in case of allocation error
+ */
+int window_add_sentence(ChainWindow *window, void **data, int length);
+
+/**
+ * Free the window and set the pointer to NULL. The chain keeps its current
+ * counts (weights, for a decaying window).
+ * @param window_ptr window to free
+ */
+void free_chain_window(ChainWindow **window_ptr);
+
+#endif /* _MARKOV_WINDOW_H */
@@ -1,365 +1,423 @@
 #include <string.h> // For strlen(), strcmp(), strcpy()
-#include "markov_chain.h"
+#include <limits.h> // For INT_MAX
+#include <pthread.h> // For pthread_create(), pthread_join()
+#include <unistd.h> // For sysconf()
+#include "snakes_board.h"
+// Walk tables of the default board, generated at build time by snakes_tablegen
+#include "snakes_tables.h"
 
-#define MAX(X, Y) (((X) < (Y)) ? (Y) : (X))
-
-#define EMPTY -1
-#define BOARD_SIZE 100
 #define MAX_GENERATION_LENGTH 60
 
-#define DICE_MAX 6
-#define NUM_OF_TRANSITIONS 20
+#define MAX_PLAYERS 64
+#define GAMES_PER_BATCH 256
+#define MAX_TOURNAMENT_ROUNDS 10000
 
 #define NUM_ARGS_ERROR "Usage: invalid number of arguments"
 
-/**
- * represents the transitions by ladders and snakes in the game
- * each tuple (x,y) represents a ladder from x to if x<y or a snake otherwise
- */
-const int transitions[][2] = {
-    {13, 4},
-    {85, 17},
-    {95, 67},
-    {97, 58},
-    {66, 89},
-    {87, 31},
-    {57, 83},
-    {91, 25},
-    {28, 50},
-    {35, 11},
-    {8, 30},
-    {41, 62},
-    {81, 43},
-    {69, 32},
-    {20, 39},
-    {33, 70},
-    {79, 99},
-    {23, 76},
-    {15, 47},
-    {61, 14}
-};
-
-int get_random_number(int max_number);
+// Cell index (number - 1) of the start and of the goal
+#define START_CELL 0
+#define LAST_CELL (BOARD_SIZE - 1)
 
 /**
- * struct represents a Cell in the game board
+ * Pick a successor in a row of the board tables.
+ * @param cell cell index to move from
+ * @param random_num draw in [0, row total)
+ * @return the successor's cell index
  */
-typedef struct Cell {
-    int number; // Cell number 1-100
-    int ladder_to; // cell which ladder leads to, if there is one
-    int snake_to; // cell which snake leads to, if there is one
-    //both ladder_to and snake_to should be -1 if the Cell doesn't have them
-} Cell;
+static int pick_successor(int cell, uint64_t random_num) {
+    int edge = snakes_row_offsets[cell];
+    while (edge + 1 < snakes_row_offsets[cell + 1] && random_num >= snakes_cumulative[edge]) {
+        edge++;
+    }
+    return snakes_columns[edge];
+}
 
 /**
- * Print function for Cell
- * @param data pointer to Cell data
+ * Total transition weight of a cell.
+ * @param cell cell index
+ * @return the total, 0 if the cell has no successor
  */
-void print_cell(void *data) {
-    if (data != NULL) {
-        Cell *cell = (Cell*)data;
-        printf("[%d]", cell->number);
-    }
+static int row_total(int cell) {
+    int end = snakes_row_offsets[cell + 1];
+    return end > snakes_row_offsets[cell] ? snakes_cumulative[end - 1] : 0;
 }
 
 /**
- * Comparison function for Cells
- * @param first_data pointer to first Cell
- * @param second_data pointer to second Cell
- * @return comparison result
+ * Choose the next cell like get_next_random_node() chooses the next node
+ * of the board chain, drawing from rand().
+ * @param cell cell index to move from
+ * @return the next cell index, EMPTY if the cell has no successor
  */
-int comp_cells(void *first_data, void *second_data) {
-    if (first_data == NULL || second_data == NULL) {
-        return 0;
-    }
-    Cell *first = (Cell*)first_data;
-    Cell *second = (Cell*)second_data;
-    return first->number - second->number;
+static int get_next_random_cell(int cell) {
+    int total = row_total(cell);
+    return total > 0 ? pick_successor(cell, (uint64_t)(rand() % total)) : EMPTY;
 }
 
 /**
- * Free function for Cell (no dynamic allocation needed for Cell itself)
- * @param data pointer to Cell data
+ * Reentrant version of get_next_random_cell(), drawing like
+ * get_next_random_node_r().
+ * @param cell cell index to move from
+ * @param random stream to draw from
+ * @return the next cell index, EMPTY if the cell has no successor
  */
-void free_cell(void *data) {
-    (void)data;
-    // Cell doesn't contain dynamically allocated memory, so nothing to free
-    // The Cell itself will be freed by the MarkovChain cleanup
+static int get_next_random_cell_r(int cell, MarkovRandom *random) {
+    int total = row_total(cell);
+    return total > 0 ? pick_successor(cell, next_random(random) % (uint64_t)total) : EMPTY;
 }
 
 /**
- * Copy function for Cell
- * @param data pointer to Cell data to copy
- * @return pointer to newly allocated copy
+ * Generate and print a random walk path
+ * @param first_cell The starting cell index (always cell 1)
+ * @param max_length Maximum path length
+ * @param path_num Path number for display
  */
-void* copy_cell(void *data) {
-    if (data == NULL) {
-        return NULL;
+void generate_random_walk(int first_cell, int max_length, int path_num) {
+    if (max_length <= 0) {
+        return;
+    }
+
+    printf("Random Walk %d: ", path_num);
+
+    int current_cell = first_cell;
+    int step_count = 0;
+
+    while (step_count < max_length) {
+        // Print current cell
+        printf("[%d]", current_cell + 1);
+        step_count++;
+
+        // Check if we reached the end (cell 100)
+        if (current_cell == LAST_CELL) {
+            break;
+        }
+
+        // Get the next cell
+        int next_cell = get_next_random_cell(current_cell);
+        if (next_cell == EMPTY) {
+            break;
+        }
+
+        // Print transition arrow based on ladder/snake/normal move
+        if (snakes_ladder_to[current_cell] != EMPTY &&
+            next_cell + 1 == snakes_ladder_to[current_cell]) {
+            printf(" -> ladder to ");
+        } else if (snakes_snake_to[current_cell] != EMPTY &&
+                   next_cell + 1 == snakes_snake_to[current_cell]) {
+            printf(" -> snake to ");
+        } else {
+            printf(" -> ");
+        }
+
+        current_cell = next_cell;
     }
 
-    Cell *original = (Cell*)data;
-    Cell *copy = malloc(sizeof(Cell));
-    if (copy == NULL) {
-        return NULL;
+    // If we didn't reach cell 100 but reached max length, print final arrow
+    if (step_count >= max_length && current_cell != LAST_CELL) {
+        if (snakes_ladder_to[current_cell] != EMPTY) {
+            printf("ladder to ");
+        } else if (snakes_snake_to[current_cell] != EMPTY) {
+            printf("snake to ");
+        }
     }
 
-    *copy = *original;
-    return copy;
+    printf("\n");
 }
 
 /**
- * Check if Cell should be last in sequence (cell number 100)
- * @param data pointer to Cell data
- * @return true if cell number is 100, false otherwise
+ * Shared state of a tournament. Games are cut into batches of
+ * GAMES_PER_BATCH; each worker owns a range of batch indices, packed as
+ * (end << 32 | next) so the owner and thieves can update it atomically.
  */
-bool is_last_cell(void *data) {
-    if (data == NULL) {
-        return false;
-    }
+typedef struct Tournament {
+    int start_cell;
+    int num_players;
+    unsigned int seed;
+    size_t num_games;
+    uint64_t *ranges; // one per worker
+    int num_workers;
+} Tournament;
 
-    Cell *cell = (Cell*)data;
-    return cell->number == BOARD_SIZE;
-}
+/**
+ * Statistics gathered by one worker, merged after the join.
+ */
+typedef struct TournamentWorker {
+    Tournament *tournament;
+    int id;
+    size_t wins[MAX_PLAYERS];
+    size_t *length_counts; // games won after that many rounds
+    size_t unfinished;
+} TournamentWorker;
 
 /**
- * allocates memory for cells on the board and initalizes them
- * @param cells Array of pointer to Cell, represents game board
- * @return EXIT_SUCCESS if successful, else EXIT_FAILURE
+ * Move a player one turn: roll once, then follow the snake or ladder of
+ * the landing cell, if there is one.
+ * @param cell current cell index of the player
+ * @param random stream of the game
+ * @return the new cell index of the player
  */
-int create_board(Cell *cells[BOARD_SIZE])
-{
-    for (int i = 0; i < BOARD_SIZE; i++)
-    {
-        cells[i] = malloc(sizeof(Cell));
-        if (cells[i] == NULL)
-        {
-            for (int j = 0; j < i; j++)
-            {
-                free(cells[j]);
-            }
-            printf(ALLOCATION_ERROR_MESSAGE);
-            return EXIT_FAILURE;
+static int play_turn(int cell, MarkovRandom *random) {
+    int next_cell = get_next_random_cell_r(cell, random);
+    while (next_cell != EMPTY && next_cell != LAST_CELL) {
+        if (snakes_ladder_to[next_cell] == EMPTY && snakes_snake_to[next_cell] == EMPTY) {
+            break;
         }
-        *(cells[i]) = (Cell){i + 1, EMPTY, EMPTY};
+        cell = next_cell;
+        next_cell = get_next_random_cell_r(cell, random);
     }
+    return next_cell != EMPTY ? next_cell : cell;
+}
 
-    for (int i = 0; i < NUM_OF_TRANSITIONS; i++)
-    {
-        int from = transitions[i][0];
-        int to = transitions[i][1];
-        if (from < to)
-        {
-            cells[from - 1]->ladder_to = to;
-        } else
-        {
-            cells[from - 1]->snake_to = to;
+/**
+ * Play one game: all players start on cell 1 and move in seat order, the
+ * first to reach cell 100 wins.
+ * @param tournament tournament settings
+ * @param random stream of the game
+ * @param rounds output, number of rounds played
+ * @return the winning seat, -1 if nobody won within MAX_TOURNAMENT_ROUNDS
+ */
+static int play_game(const Tournament *tournament, MarkovRandom *random, int *rounds) {
+    int positions[MAX_PLAYERS];
+    for (int seat = 0; seat < tournament->num_players; seat++) {
+        positions[seat] = tournament->start_cell;
+    }
+
+    for (*rounds = 1; *rounds <= MAX_TOURNAMENT_ROUNDS; (*rounds)++) {
+        for (int seat = 0; seat < tournament->num_players; seat++) {
+            positions[seat] = play_turn(positions[seat], random);
+            if (positions[seat] == LAST_CELL) {
+                return seat;
+            }
         }
     }
-    return EXIT_SUCCESS;
+    return -1;
 }
 
-int add_cells_to_database(MarkovChain *markov_chain, Cell *cells[BOARD_SIZE])
-{
-    for (size_t i = 0; i < BOARD_SIZE; i++)
-    {
-        Node *tmp = add_to_database(markov_chain, cells[i]);
-        if (tmp == NULL)
-        {
-            return EXIT_FAILURE;
+/**
+ * Play every game of a batch. Each batch has its own random stream derived
+ * from the seed and the batch index, so the results do not depend on the
+ * number of threads or on which thread plays which batch.
+ * @param worker worker playing the batch
+ * @param batch batch index
+ */
+static void play_batch(TournamentWorker *worker, uint32_t batch) {
+    const Tournament *tournament = worker->tournament;
+    MarkovRandom random;
+    seed_random(&random, ((uint64_t)tournament->seed << 32) | batch);
+
+    size_t first_game = (size_t)batch * GAMES_PER_BATCH;
+    size_t end_game = first_game + GAMES_PER_BATCH;
+    if (end_game > tournament->num_games) {
+        end_game = tournament->num_games;
+    }
+    for (size_t game = first_game; game < end_game; game++) {
+        int rounds;
+        int winner = play_game(tournament, &random, &rounds);
+        if (winner < 0) {
+            worker->unfinished++;
+        } else {
+            worker->wins[winner]++;
+            worker->length_counts[rounds]++;
         }
     }
-    return EXIT_SUCCESS;
 }
 
-int set_nodes_frequencies(MarkovChain *markov_chain, Cell *cells[BOARD_SIZE])
-{
-    MarkovNode *from_node = NULL, *to_node = NULL;
-    size_t index_to;
-
-    for (size_t i = 0; i < BOARD_SIZE; i++)
-    {
-        from_node = get_node_from_database(markov_chain, cells[i])->data;
-        if (cells[i]->snake_to != EMPTY || cells[i]->ladder_to != EMPTY)
-        {
-            index_to = MAX(cells[i]->snake_to, cells[i]->ladder_to) - 1;
-            to_node = get_node_from_database(markov_chain,
-                                             cells[index_to])->data;
-            int res = add_node_to_frequency_list(from_node, to_node);
-            if (res == EXIT_FAILURE)
-            {
-                return EXIT_FAILURE;
-            }
+/**
+ * Take the next batch from the front of the worker's own range.
+ * @param range range of the worker
+ * @param batch output, the batch index
+ * @return true if a batch was taken, false if the range is empty
+ */
+static bool take_batch(uint64_t *range, uint32_t *batch) {
+    uint64_t old = __atomic_load_n(range, __ATOMIC_ACQUIRE);
+    while (true) {
+        uint32_t next = (uint32_t)old, end = (uint32_t)(old >> 32);
+        if (next >= end) {
+            return false;
         }
-        else
-        {
-            for (int j = 1; j <= DICE_MAX; j++)
-            {
-                index_to = ((Cell *) (from_node->data))->number + j - 1;
-                if (index_to >= BOARD_SIZE)
-                {
-                    break;
-                }
-                to_node = get_node_from_database(markov_chain,
-                                                 cells[index_to])->data;
-                int res = add_node_to_frequency_list(from_node, to_node);
-                if (res == EXIT_FAILURE)
-                {
-                    return EXIT_FAILURE;
-                }
-            }
+        uint64_t updated = ((uint64_t)end << 32) | (next + 1);
+        if (__atomic_compare_exchange_n(range, &old, updated, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *batch = next;
+            return true;
         }
     }
-    return EXIT_SUCCESS;
 }
 
 /**
- * fills database
- * @param markov_chain
- * @return EXIT_SUCCESS or EXIT_FAILURE
+ * Steal the back half of another worker's range into an empty own range.
+ * @param victim range to steal from
+ * @param own empty range of the thief
+ * @return true if anything was stolen
  */
-int fill_database_snakes(MarkovChain *markov_chain)
-{
-    Cell *cells[BOARD_SIZE];
-    if (create_board(cells) == EXIT_FAILURE)
-    {
-        return EXIT_FAILURE;
-    }
-    if (add_cells_to_database(markov_chain, cells) == EXIT_FAILURE)
-    {
-        for (size_t i = 0; i < BOARD_SIZE; i++)
-        {
-            free(cells[i]);
+static bool steal_batches(uint64_t *victim, uint64_t *own) {
+    uint64_t old = __atomic_load_n(victim, __ATOMIC_ACQUIRE);
+    while (true) {
+        uint32_t next = (uint32_t)old, end = (uint32_t)(old >> 32);
+        if (next >= end) {
+            return false;
         }
-        return EXIT_FAILURE;
-    }
-
-    if(set_nodes_frequencies(markov_chain, cells) == EXIT_FAILURE)
-    {
-        for (size_t i = 0; i < BOARD_SIZE; i++)
-        {
-            free(cells[i]);
+        uint32_t split = end - (end - next + 1) / 2;
+        uint64_t updated = ((uint64_t)split << 32) | next;
+        if (__atomic_compare_exchange_n(victim, &old, updated, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(own, ((uint64_t)end << 32) | split, __ATOMIC_RELEASE);
+            return true;
         }
-        return EXIT_FAILURE;
     }
+}
 
-    // free temp arr
-    for (size_t i = 0; i < BOARD_SIZE; i++)
-    {
-        free(cells[i]);
+/**
+ * Worker thread: play its own batches, then steal from the others until
+ * no batch is left anywhere.
+ * @param arg TournamentWorker of this thread
+ * @return NULL
+ */
+static void *run_tournament_worker(void *arg) {
+    TournamentWorker *worker = arg;
+    Tournament *tournament = worker->tournament;
+    uint64_t *own = &tournament->ranges[worker->id];
+    while (true) {
+        uint32_t batch;
+        if (take_batch(own, &batch)) {
+            play_batch(worker, batch);
+            continue;
+        }
+        bool stolen = false;
+        for (int i = 1; i < tournament->num_workers && !stolen; i++) {
+            int victim = (worker->id + i) % tournament->num_workers;
+            stolen = steal_batches(&tournament->ranges[victim], own);
+        }
+        if (!stolen) {
+            return NULL;
+        }
     }
-    return EXIT_SUCCESS;
 }
 
 /**
- * Returns a random next node from the given node's frequency list
- * The random selection is weighted by the frequencies of each following word
- * @param cur_markov_node Current MarkovNode to find a successor for
- * @return A random MarkovNode from the frequency list
+ * Print the merged statistics of a tournament.
+ * @param tournament tournament settings
+ * @param workers workers, already joined; merged into the first one
  */
-MarkovNode* get_next_random_node(MarkovNode *cur_markov_node) {
-    // Check for NULL input or empty frequency list
-    if (cur_markov_node == NULL ||
-        cur_markov_node->frequency_list == NULL ||
-        cur_markov_node->frequency_list_size == 0) {
-        return NULL;
+static void print_tournament(const Tournament *tournament, TournamentWorker *workers) {
+    TournamentWorker *total = &workers[0];
+    for (int w = 1; w < tournament->num_workers; w++) {
+        for (int seat = 0; seat < tournament->num_players; seat++) {
+            total->wins[seat] += workers[w].wins[seat];
         }
-
-    // Calculate the total frequency of all words that follow the current word
-    int total_frequency = 0;
-    for (int i = 0; i < cur_markov_node->frequency_list_size; i++) {
-        total_frequency += cur_markov_node->frequency_list[i].frequency;
+        for (int rounds = 0; rounds <= MAX_TOURNAMENT_ROUNDS; rounds++) {
+            total->length_counts[rounds] += workers[w].length_counts[rounds];
+        }
+        total->unfinished += workers[w].unfinished;
     }
 
-    // Generate a random number between 0 and total_frequency - 1
-    int random_num = get_random_number(total_frequency);
+    printf("Tournament: %zu games, %d players\n", tournament->num_games,
+           tournament->num_players);
+    for (int seat = 0; seat < tournament->num_players; seat++) {
+        printf("Seat %d: %zu wins (%.2f%%)\n", seat + 1, total->wins[seat],
+               100.0 * (double)total->wins[seat] / (double)tournament->num_games);
+    }
 
-    // Select a word based on weighted probabilities
-    int cumulative_frequency = 0;
-    for (int i = 0; i < cur_markov_node->frequency_list_size; i++) {
-        cumulative_frequency += cur_markov_node->frequency_list[i].frequency;
-        if (random_num < cumulative_frequency) {
-            return cur_markov_node->frequency_list[i].markov_node;
+    size_t finished = tournament->num_games - total->unfinished;
+    if (finished > 0) {
+        const double quantiles[] = {0.5, 0.9, 0.99, 1.0};
+        int percentiles[4] = {0};
+        size_t seen = 0;
+        double sum = 0;
+        int q = 0;
+        for (int rounds = 1; rounds <= MAX_TOURNAMENT_ROUNDS; rounds++) {
+            seen += total->length_counts[rounds];
+            sum += (double)rounds * (double)total->length_counts[rounds];
+            while (q < 4 && (double)seen >= quantiles[q] * (double)finished) {
+                percentiles[q++] = rounds;
+            }
         }
+        printf("Game length in rounds: mean %.2f, p50 %d, p90 %d, p99 %d, max %d\n",
+               sum / (double)finished, percentiles[0], percentiles[1], percentiles[2],
+               percentiles[3]);
+    }
+    if (total->unfinished > 0) {
+        printf("Unfinished games: %zu\n", total->unfinished);
     }
-
-    // This should never happen if the frequency list is properly set up
-    return NULL;
 }
 
-
 /**
- * Generate and print a random walk path
- * @param markov_chain The markov chain
- * @param first_node The starting cell (always cell 1)
- * @param max_length Maximum path length
- * @param path_num Path number for display
+ * Simulate many multi-player games across threads and print win rates by
+ * seat and game-length percentiles.
+ * @param start_cell The starting cell index (always cell 1)
+ * @param seed seed of the per-batch random streams
+ * @param num_games number of games
+ * @param num_players players per game
+ * @param num_threads worker threads, 0 for one per online CPU
+ * @return EXIT_SUCCESS or EXIT_FAILURE
  */
-void generate_random_walk(MarkovChain *markov_chain, MarkovNode *first_node, int max_length, int path_num) {
-    if (markov_chain == NULL || first_node == NULL || max_length <= 0) {
-        return;
+int run_tournament(int start_cell, unsigned int seed, size_t num_games, int num_players,
+                   int num_threads) {
+    size_t num_batches = (num_games + GAMES_PER_BATCH - 1) / GAMES_PER_BATCH;
+    if (num_threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = online > 0 ? (int)online : 1;
+    }
+    if ((size_t)num_threads > num_batches) {
+        num_threads = (int)num_batches;
     }
 
-    printf("Random Walk %d: ", path_num);
-
-    MarkovNode *current_node = first_node;
-    MarkovNode *next_node = NULL;
-    int step_count = 0;
-
-    while (step_count < max_length) {
-        Cell *current_cell = (Cell*)current_node->data;
-
-        // Print current cell
-        markov_chain->print_func(current_node->data);
-        step_count++;
-
-        // Check if we reached the end (cell 100)
-        if (markov_chain->is_last(current_node->data)) {
-            break;
-        }
+    Tournament tournament = {start_cell, num_players, seed, num_games,
+                             malloc((size_t)num_threads * sizeof(uint64_t)), num_threads};
+    TournamentWorker *workers = calloc((size_t)num_threads, sizeof(TournamentWorker));
+    pthread_t *threads = malloc((size_t)num_threads * sizeof(pthread_t));
+    bool allocated = tournament.ranges != NULL && workers != NULL && threads != NULL;
+    for (int w = 0; allocated && w < num_threads; w++) {
+        workers[w].tournament = &tournament;
+        workers[w].id = w;
+        workers[w].length_counts = calloc(MAX_TOURNAMENT_ROUNDS + 1, sizeof(size_t));
+        allocated = workers[w].length_counts != NULL;
+
+        // Every worker starts with an even share of the batches
+        uint64_t first = num_batches * (size_t)w / (size_t)num_threads;
+        uint64_t end = num_batches * (size_t)(w + 1) / (size_t)num_threads;
+        tournament.ranges[w] = (end << 32) | first;
+    }
 
-        // Get the next node
-        next_node = get_next_random_node(current_node);
-        if (next_node == NULL) {
-            break;
+    if (allocated) {
+        // The main thread is worker 0; a worker that fails to start just
+        // has its batches stolen by the others
+        int started = 1;
+        for (; started < num_threads; started++) {
+            if (pthread_create(&threads[started], NULL, run_tournament_worker,
+                               &workers[started]) != 0) {
+                break;
+            }
         }
-
-        Cell *next_cell = (Cell*)next_node->data;
-
-        // Print transition arrow based on ladder/snake/normal move
-        if (current_cell->ladder_to != EMPTY && next_cell->number == current_cell->ladder_to) {
-            printf(" -> ladder to ");
-        } else if (current_cell->snake_to != EMPTY && next_cell->number == current_cell->snake_to) {
-            printf(" -> snake to ");
-        } else {
-            printf(" -> ");
+        run_tournament_worker(&workers[0]);
+        for (int w = 1; w < started; w++) {
+            pthread_join(threads[w], NULL);
         }
-
-        current_node = next_node;
+        print_tournament(&tournament, workers);
+    } else {
+        printf(ALLOCATION_ERROR_MESSAGE);
     }
 
-    // If we didn't reach cell 100 but reached max length, print final arrow
-    if (step_count >= max_length && !markov_chain->is_last(current_node->data)) {
-        Cell *current_cell = (Cell*)current_node->data;
-        if (current_cell->ladder_to != EMPTY) {
-            printf("ladder to ");
-        } else if (current_cell->snake_to != EMPTY) {
-            printf("snake to ");
-        }
+    for (int w = 0; workers != NULL && w < num_threads; w++) {
+        free(workers[w].length_counts);
     }
-
-    printf("\n");
+    free(workers);
+    free(threads);
+    free(tournament.ranges);
+    return allocated ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 /**
  * @param argc num of arguments
  * @param argv 1) Seed
- *             2) Number of paths to generate
+ *             2) Number of paths to generate, or of games in tournament mode
+ *             3) Optional number of players, selects tournament mode
+ *             4) Optional number of tournament threads (default one per CPU)
  * @return EXIT_SUCCESS or EXIT_FAILURE
  */
 int main(int argc, char *argv[])
 {
     // Check argument count
-    if (argc != 3) {
+    if (argc < 3 || argc > 5) {
         printf("%s\n", NUM_ARGS_ERROR);
         return EXIT_FAILURE;
     }
@@ -374,64 +432,39 @@ int main(int argc, char *argv[])
     srand(seed);
 
     // Parse and validate number of paths
-    int num_paths = (int)strtol(argv[2], &endptr, 10);
-    if (*endptr != '\0' || num_paths <= 0) {
+    long num_paths = strtol(argv[2], &endptr, 10);
+    if (*endptr != '\0' || num_paths <= 0 || (argc == 3 && num_paths > INT_MAX) ||
+        (size_t)num_paths / GAMES_PER_BATCH >= UINT32_MAX) {
         printf("Error: Invalid number of paths.\n");
         return EXIT_FAILURE;
     }
 
-    // Create and initialize the markov chain
-    MarkovChain *markov_chain = malloc(sizeof(MarkovChain));
-    if (markov_chain == NULL) {
-        printf(ALLOCATION_ERROR_MESSAGE);
-        return EXIT_FAILURE;
-    }
-
-    // Initialize the database (linked list)
-    markov_chain->database = malloc(sizeof(LinkedList));
-    if (markov_chain->database == NULL) {
-        printf(ALLOCATION_ERROR_MESSAGE);
-        free(markov_chain);
-        return EXIT_FAILURE;
+    // Tournament mode: players per game and optional thread count
+    int num_players = 0, num_threads = 0;
+    if (argc >= 4) {
+        num_players = (int)strtol(argv[3], &endptr, 10);
+        if (*endptr != '\0' || num_players <= 0 || num_players > MAX_PLAYERS) {
+            printf("Error: Invalid number of players.\n");
+            return EXIT_FAILURE;
+        }
     }
-
-    // Initialize the linked list fields
-    markov_chain->database->first = NULL;
-    markov_chain->database->last = NULL;
-    markov_chain->database->size = 0;
-
-    // Set up the function pointers for Cell operations
-    markov_chain->print_func = print_cell;
-    markov_chain->comp_func = comp_cells;
-    markov_chain->free_data = free_cell;
-    markov_chain->copy_func = copy_cell;
-    markov_chain->is_last = is_last_cell;
-
-    // Fill the markov chain with the board
-    if (fill_database_snakes(markov_chain) != EXIT_SUCCESS) {
-        printf(ALLOCATION_ERROR_MESSAGE);
-        free_database(&markov_chain);
-        return EXIT_FAILURE;
+    if (argc == 5) {
+        num_threads = (int)strtol(argv[4], &endptr, 10);
+        if (*endptr != '\0' || num_threads <= 0) {
+            printf("Error: Invalid number of threads.\n");
+            return EXIT_FAILURE;
+        }
     }
 
-    // Find cell 1 (starting cell)
-    Cell start_cell = {1, EMPTY, EMPTY};
-    Node *start_node = get_node_from_database(markov_chain, &start_cell);
-    if (start_node == NULL) {
-        printf("Error: Could not find starting cell.\n");
-        free_database(&markov_chain);
-        return EXIT_FAILURE;
+    // The board is static, walks start right away
+    if (num_players > 0) {
+        return run_tournament(START_CELL, seed, (size_t)num_paths, num_players, num_threads);
     }
 
-    MarkovNode *start_markov_node = (MarkovNode*)start_node->data;
-
     // Generate and print the random walks
     for (int i = 1; i <= num_paths; i++) {
-        generate_random_walk(markov_chain, start_markov_node, MAX_GENERATION_LENGTH, i);
+        generate_random_walk(START_CELL, MAX_GENERATION_LENGTH, i);
     }
 
-    // Free the allocated memory
-    free_database(&markov_chain);
-
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,234 @@
+#include "snakes_board.h"
+
+#define MAX(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+const int transitions[NUM_OF_TRANSITIONS][2] = {
+    {13, 4},
+    {85, 17},
+    {95, 67},
+    {97, 58},
+    {66, 89},
+    {87, 31},
+    {57, 83},
+    {91, 25},
+    {28, 50},
+    {35, 11},
+    {8, 30},
+    {41, 62},
+    {81, 43},
+    {69, 32},
+    {20, 39},
+    {33, 70},
+    {79, 99},
+    {23, 76},
+    {15, 47},
+    {61, 14}
+};
+
+/**
+ * Print function for Cell
+ * @param data pointer to Cell data
+ */
+void print_cell(void *data) {
+    if (data != NULL) {
+        Cell *cell = (Cell*)data;
+        printf("[%d]", cell->number);
+    }
+}
+
+/**
+ * Comparison function for Cells
+ * @param first_data pointer to first Cell
+ * @param second_data pointer to second Cell
+ * @return comparison result
+ */
+int comp_cells(void *first_data, void *second_data) {
+    if (first_data == NULL || second_data == NULL) {
+        return 0;
+    }
+    Cell *first = (Cell*)first_data;
+    Cell *second = (Cell*)second_data;
+    return first->number - second->number;
+}
+
+/**
+ * Free function for Cell copies made by copy_cell()
+ * @param data pointer to Cell data
+ */
+void free_cell(void *data) {
+    markov_data_free(data);
+}
+
+/**
+ * Copy function for Cell
+ * @param data pointer to Cell data to copy
+ * @return pointer to newly allocated copy
+ */
+void *copy_cell(void *data) {
+    if (data == NULL) {
+        return NULL;
+    }
+
+    Cell *original = (Cell*)data;
+    Cell *copy = markov_data_alloc(sizeof(Cell));
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    *copy = *original;
+    return copy;
+}
+
+/**
+ * Check if Cell should be last in sequence (cell number 100)
+ * @param data pointer to Cell data
+ * @return true if cell number is 100, false otherwise
+ */
+bool is_last_cell(void *data) {
+    if (data == NULL) {
+        return false;
+    }
+
+    Cell *cell = (Cell*)data;
+    return cell->number == BOARD_SIZE;
+}
+
+/**
+ * allocates memory for cells on the board and initalizes them
+ * @param cells Array of pointer to Cell, represents game board
+ * @return EXIT_SUCCESS if successful, else EXIT_FAILURE
+ */
+static int create_board(Cell *cells[BOARD_SIZE])
+{
+    for (int i = 0; i < BOARD_SIZE; i++)
+    {
+        cells[i] = malloc(sizeof(Cell));
+        if (cells[i] == NULL)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                free(cells[j]);
+            }
+            printf(ALLOCATION_ERROR_MESSAGE);
+            return EXIT_FAILURE;
+        }
+        *(cells[i]) = (Cell){i + 1, EMPTY, EMPTY};
+    }
+
+    for (int i = 0; i < NUM_OF_TRANSITIONS; i++)
+    {
+        int from = transitions[i][0];
+        int to = transitions[i][1];
+        if (from < to)
+        {
+            cells[from - 1]->ladder_to = to;
+        } else
+        {
+            cells[from - 1]->snake_to = to;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * adds every cell of the board to the database, in order
+ * @param markov_chain
+ * @param cells Array of pointer to Cell, represents game board
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int add_cells_to_database(MarkovChain *markov_chain, Cell *cells[BOARD_SIZE])
+{
+    for (size_t i = 0; i < BOARD_SIZE; i++)
+    {
+        Node *tmp = add_to_database(markov_chain, cells[i]);
+        if (tmp == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * connects every cell to the cells a turn can move it to
+ * @param markov_chain
+ * @param cells Array of pointer to Cell, represents game board
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int set_nodes_frequencies(MarkovChain *markov_chain, Cell *cells[BOARD_SIZE])
+{
+    MarkovNode *from_node = NULL, *to_node = NULL;
+    size_t index_to;
+
+    for (size_t i = 0; i < BOARD_SIZE; i++)
+    {
+        from_node = get_node_from_database(markov_chain, cells[i])->data;
+        if (cells[i]->snake_to != EMPTY || cells[i]->ladder_to != EMPTY)
+        {
+            index_to = MAX(cells[i]->snake_to, cells[i]->ladder_to) - 1;
+            to_node = get_node_from_database(markov_chain,
+                                             cells[index_to])->data;
+            int res = add_node_to_frequency_list(markov_chain, from_node, to_node);
+            if (res == EXIT_FAILURE)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            for (int j = 1; j <= DICE_MAX; j++)
+            {
+                index_to = ((Cell *) (from_node->data))->number + j - 1;
+                if (index_to >= BOARD_SIZE)
+                {
+                    break;
+                }
+                to_node = get_node_from_database(markov_chain,
+                                                 cells[index_to])->data;
+                int res = add_node_to_frequency_list(markov_chain, from_node, to_node);
+                if (res == EXIT_FAILURE)
+                {
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+MarkovChain *create_snakes_chain(void) {
+    return create_markov_chain(print_cell, comp_cells, free_cell, copy_cell, is_last_cell);
+}
+
+int fill_database_snakes(MarkovChain *markov_chain)
+{
+    Cell *cells[BOARD_SIZE];
+    if (create_board(cells) == EXIT_FAILURE)
+    {
+        return EXIT_FAILURE;
+    }
+    if (add_cells_to_database(markov_chain, cells) == EXIT_FAILURE)
+    {
+        for (size_t i = 0; i < BOARD_SIZE; i++)
+        {
+            free(cells[i]);
+        }
+        return EXIT_FAILURE;
+    }
+
+    if(set_nodes_frequencies(markov_chain, cells) == EXIT_FAILURE)
+    {
+        for (size_t i = 0; i < BOARD_SIZE; i++)
+        {
+            free(cells[i]);
+        }
+        return EXIT_FAILURE;
+    }
+
+    // free temp arr
+    for (size_t i = 0; i < BOARD_SIZE; i++)
+    {
+        free(cells[i]);
+    }
+    return EXIT_SUCCESS;
+}
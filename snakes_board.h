@@ -0,0 +1,77 @@
+#ifndef _SNAKES_BOARD_H
+#define _SNAKES_BOARD_H
+
+#include "markov_chain.h"
+
+#define EMPTY -1
+#define BOARD_SIZE 100
+
+#define DICE_MAX 6
+#define NUM_OF_TRANSITIONS 20
+
+/**
+ * represents the transitions by ladders and snakes in the game
+ * each tuple (x,y) represents a ladder from x to if x<y or a snake otherwise
+ */
+extern const int transitions[NUM_OF_TRANSITIONS][2];
+
+/**
+ * struct represents a Cell in the game board
+ */
+typedef struct Cell {
+    int number; // Cell number 1-100
+    int ladder_to; // cell which ladder leads to, if there is one
+    int snake_to; // cell which snake leads to, if there is one
+    //both ladder_to and snake_to should be -1 if the Cell doesn't have them
+} Cell;
+
+/**
+ * Print function for Cell
+ * @param data pointer to Cell data
+ */
+void print_cell(void *data);
+
+/**
+ * Comparison function for Cells
+ * @param first_data pointer to first Cell
+ * @param second_data pointer to second Cell
+ * @return comparison result
+ */
+int comp_cells(void *first_data, void *second_data);
+
+/**
+ * Free function for Cell copies made by copy_cell()
+ * @param data pointer to Cell data
+ */
+void free_cell(void *data);
+
+/**
+ * Copy function for Cell
+ * @param data pointer to Cell data to copy
+ * @return pointer to newly allocated copy, from markov_data_alloc()
+ */
+void *copy_cell(void *data);
+
+/**
+ * Check if Cell should be last in sequence (cell number 100)
+ * @param data pointer to Cell data
+ * @return true if cell number is 100, false otherwise
+ */
+bool is_last_cell(void *data);
+
+/**
+ * Allocate an empty markov chain over board cells, using the Cell functions
+ * above.
+ * @return the new chain, NULL in case of allocation error
+ */
+MarkovChain *create_snakes_chain(void);
+
+/**
+ * fills database with the board: cells 1-100 in order, each moving to the
+ * end of its snake or ladder, or else to the next DICE_MAX cells
+ * @param markov_chain
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int fill_database_snakes(MarkovChain *markov_chain);
+
+#endif /* _SNAKES_BOARD_H */
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "snakes_board.h"
+
+#define NUM_ARGS_ERROR "Usage: snakes_tablegen <output_header>"
+// Numbers per line of a generated array
+#define VALUES_PER_LINE 12
+
+/**
+ * Write one static const array of the generated header.
+ * @param fp header being written
+ * @param type element type
+ * @param name array name
+ * @param size array size expression
+ * @param values the elements
+ * @param count number of elements
+ */
+static void write_table(FILE *fp, const char *type, const char *name, const char *size,
+                        const long *values, int count) {
+    fprintf(fp, "static const %s %s[%s] = {", type, name, size);
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%s%ld%s", i % VALUES_PER_LINE == 0 ? "\n    " : " ", values[i],
+                i + 1 < count ? "," : "\n");
+    }
+    fprintf(fp, "};\n\n");
+}
+
+/**
+ * Write the board tables: the chain of the default board in CSR layout,
+ * indexed by cell (number - 1), with running transition weights per row,
+ * and the snake and ladder of every cell for printing.
+ * @param markov_chain chain of the board, cells in order
+ * @param fp header to write
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int write_tables(MarkovChain *markov_chain, FILE *fp) {
+    long row_offsets[BOARD_SIZE + 1], columns[BOARD_SIZE * DICE_MAX];
+    long cumulative[BOARD_SIZE * DICE_MAX];
+    long ladder_to[BOARD_SIZE], snake_to[BOARD_SIZE];
+    int num_edges = 0, cell = 0;
+
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next, cell++) {
+        MarkovNode *markov_node = current->data;
+        Cell *data = markov_node->data;
+        // The walk engine draws with rand() % total, like get_next_random_node()
+        // does for totals up to the least RAND_MAX
+        if (cell >= BOARD_SIZE || data->number != cell + 1 ||
+            markov_node->frequency_list_size > DICE_MAX ||
+            markov_node->total_frequency > 32767) {
+            fprintf(stderr, "Error: unexpected board chain\n");
+            return EXIT_FAILURE;
+        }
+
+        row_offsets[cell] = num_edges;
+        ladder_to[cell] = data->ladder_to;
+        snake_to[cell] = data->snake_to;
+        long running = 0;
+        for (int i = 0; i < markov_node->frequency_list_size; i++) {
+            running += (long)get_frequency(markov_node, i);
+            columns[num_edges] = ((Cell *)markov_node->frequency_list[i]->data)->number - 1;
+            cumulative[num_edges++] = running;
+        }
+    }
+    if (cell != BOARD_SIZE) {
+        fprintf(stderr, "Error: unexpected board chain\n");
+        return EXIT_FAILURE;
+    }
+    row_offsets[BOARD_SIZE] = num_edges;
+
+    fprintf(fp, "/* Generated by snakes_tablegen from snakes_board.c, do not edit. */\n"
+                "#ifndef _SNAKES_TABLES_H\n"
+                "#define _SNAKES_TABLES_H\n\n"
+                "#include <stdint.h>\n\n"
+                "#define SNAKES_NUM_EDGES %d\n\n"
+                "// Successors of cell i (number - 1) are snakes_columns[snakes_row_offsets[i]]\n"
+                "// .. snakes_columns[snakes_row_offsets[i + 1] - 1], in frequency list order.\n"
+                "// snakes_cumulative holds the running transition weights of each row.\n",
+            num_edges);
+    write_table(fp, "uint16_t", "snakes_row_offsets", "BOARD_SIZE + 1", row_offsets,
+                BOARD_SIZE + 1);
+    write_table(fp, "uint16_t", "snakes_columns", "SNAKES_NUM_EDGES", columns, num_edges);
+    write_table(fp, "uint16_t", "snakes_cumulative", "SNAKES_NUM_EDGES", cumulative,
+                num_edges);
+    fprintf(fp, "// End cell number of the ladder or snake of every cell, EMPTY if none\n");
+    write_table(fp, "int16_t", "snakes_ladder_to", "BOARD_SIZE", ladder_to, BOARD_SIZE);
+    write_table(fp, "int16_t", "snakes_snake_to", "BOARD_SIZE", snake_to, BOARD_SIZE);
+    fprintf(fp, "#endif /* _SNAKES_TABLES_H */\n");
+    return ferror(fp) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Build-time generator of the default board's walk tables: builds the
+ * board chain exactly like the game used to at startup, and writes it out
+ * as static const arrays, so the game itself needs no setup at all.
+ * @param argc num of arguments
+ * @param argv 1) Header file to write
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    MarkovChain *markov_chain = create_snakes_chain();
+    if (markov_chain == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return EXIT_FAILURE;
+    }
+    if (fill_database_snakes(markov_chain) != EXIT_SUCCESS) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    FILE *fp = fopen(argv[1], "w");
+    if (fp == NULL) {
+        fprintf(stdout, "Error: incorrect file path: %s\n", argv[1]);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+    int result = write_tables(markov_chain, fp);
+    if (fclose(fp) != 0) {
+        result = EXIT_FAILURE;
+    }
+    free_database(&markov_chain);
+    return result;
+}
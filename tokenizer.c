@@ -0,0 +1,167 @@
+#include "tokenizer.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BLOCK_SIZE 64
+
+/**
+ * Whether the byte separates words.
+ * @param c byte to check
+ * @return true for the delimiter bytes
+ */
+static bool is_delimiter(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\0';
+}
+
+/**
+ * Build the delimiter bit mask of a full 64-byte block.
+ * @param block 64 readable bytes
+ * @return bit i set if block[i] is a delimiter
+ */
+static uint64_t classify_block(const char *block) {
+#if defined(__AVX2__)
+    uint64_t mask = 0;
+    for (int half = 0; half < 2; half++) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + 32 * half));
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')),
+                                            _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256()))));
+        mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(hits) << (32 * half);
+    }
+    return mask;
+#elif defined(__SSE2__)
+    uint64_t mask = 0;
+    for (int quarter = 0; quarter < 4; quarter++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(block + 16 * quarter));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                         _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')),
+                         _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')),
+                                      _mm_cmpeq_epi8(bytes, _mm_setzero_si128()))));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hits) << (16 * quarter);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        mask |= (uint64_t)is_delimiter(block[i]) << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * Index of the lowest set bit.
+ * @param mask non-zero mask
+ * @return bit index
+ */
+static int lowest_bit(uint64_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int index = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/**
+ * Classify the block at tokenizer->block and turn the delimiter mask into
+ * word start and end masks.
+ * @param tokenizer scanner positioned at a new block
+ */
+static void load_block(Tokenizer *tokenizer) {
+    size_t available = (size_t)(tokenizer->end - tokenizer->block);
+    uint64_t delimiters;
+    if (available >= BLOCK_SIZE) {
+        delimiters = classify_block(tokenizer->block);
+    } else {
+        // Tail: bytes past the text count as delimiters, closing the last word
+        delimiters = ~(uint64_t)0;
+        for (size_t i = 0; i < available; i++) {
+            if (!is_delimiter(tokenizer->block[i])) {
+                delimiters &= ~((uint64_t)1 << i);
+            }
+        }
+    }
+
+    uint64_t words = ~delimiters;
+    uint64_t previous_delimiters = (delimiters << 1) | (tokenizer->after_delimiter ? 1 : 0);
+    tokenizer->starts = words & previous_delimiters;
+    tokenizer->ends = delimiters & ~previous_delimiters;
+    tokenizer->after_delimiter = (delimiters >> (BLOCK_SIZE - 1)) != 0;
+}
+
+void init_tokenizer(Tokenizer *tokenizer, const char *text, size_t length) {
+    tokenizer->block = text;
+    tokenizer->end = text + length;
+    tokenizer->pending = NULL;
+    tokenizer->after_delimiter = true;
+    if (length > 0) {
+        load_block(tokenizer);
+    } else {
+        tokenizer->starts = 0;
+        tokenizer->ends = 0;
+    }
+}
+
+bool next_token(Tokenizer *tokenizer, TokenSpan *token) {
+    while (tokenizer->block < tokenizer->end) {
+        // Within a block starts and ends alternate, so the lowest set bit of
+        // the union tells which one comes next
+        uint64_t events = tokenizer->pending == NULL ? tokenizer->starts : tokenizer->ends;
+        if (events != 0) {
+            int index = lowest_bit(events);
+            const char *position = tokenizer->block + index;
+            if (tokenizer->pending == NULL) {
+                tokenizer->pending = position;
+                tokenizer->starts &= tokenizer->starts - 1;
+                continue;
+            }
+
+            tokenizer->ends &= tokenizer->ends - 1;
+            token->start = tokenizer->pending;
+            token->length = (size_t)(position - tokenizer->pending);
+            token->ends_sentence = position[-1] == '.';
+            tokenizer->pending = NULL;
+            return true;
+        }
+
+        tokenizer->block += BLOCK_SIZE;
+        if (tokenizer->block < tokenizer->end) {
+            load_block(tokenizer);
+        }
+    }
+
+    // A word running into the end of a block-aligned text
+    if (tokenizer->pending != NULL) {
+        token->start = tokenizer->pending;
+        token->length = (size_t)(tokenizer->end - tokenizer->pending);
+        token->ends_sentence = tokenizer->end[-1] == '.';
+        tokenizer->pending = NULL;
+        return true;
+    }
+    return false;
+}
+
+size_t tokenize(const char *text, size_t length, TokenSpan *tokens, size_t max_tokens) {
+    Tokenizer tokenizer;
+    init_tokenizer(&tokenizer, text, length);
+
+    size_t count = 0;
+    while (count < max_tokens && next_token(&tokenizer, &tokens[count])) {
+        count++;
+    }
+    return count;
+}
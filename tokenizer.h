@@ -0,0 +1,63 @@
+#ifndef _TOKENIZER_H
+#define _TOKENIZER_H
+
+#include <stdbool.h> // for bool
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for uint64_t
+
+/**
+ * One word of the text: the bytes between delimiters (' ', '\n', '\t', '\r'
+ * - the corpus DELIMITERS - and '\0').
+ */
+typedef struct TokenSpan {
+    const char *start;
+    size_t length;
+    // the word ends with '.', i.e. it is the last word of a sentence
+    bool ends_sentence;
+} TokenSpan;
+
+/**
+ * Reentrant word scanner over a buffer. Unlike strtok it keeps all of its
+ * state here and never writes to the text, so any number of threads can
+ * scan their own buffers at once. The text is classified 64 bytes at a time
+ * with SSE2/AVX2 when available, and a scalar loop otherwise.
+ * Tokens are reported once their end is seen, so the caller may overwrite
+ * the delimiter right after a token (e.g. with '\0') before asking for the
+ * next one.
+ */
+typedef struct Tokenizer {
+    const char *block;     // start of the classified 64-byte block
+    const char *end;       // end of the text
+    uint64_t starts;       // bit i: a word starts at block[i]
+    uint64_t ends;         // bit i: a word ends right before block[i]
+    const char *pending;   // start of a word whose end is not seen yet
+    bool after_delimiter;  // the byte before the block is a delimiter
+} Tokenizer;
+
+/**
+ * Start scanning a buffer.
+ * @param tokenizer scanner to set up
+ * @param text text to scan, need not be NUL-terminated
+ * @param length number of bytes of text
+ */
+void init_tokenizer(Tokenizer *tokenizer, const char *text, size_t length);
+
+/**
+ * Get the next word of the text.
+ * @param tokenizer scanner
+ * @param token output span of the word
+ * @return true if a word was found, false at the end of the text
+ */
+bool next_token(Tokenizer *tokenizer, TokenSpan *token);
+
+/**
+ * Split a whole buffer at once.
+ * @param text text to scan
+ * @param length number of bytes of text
+ * @param tokens output array
+ * @param max_tokens capacity of tokens
+ * @return number of words written, at most max_tokens
+ */
+size_t tokenize(const char *text, size_t length, TokenSpan *tokens, size_t max_tokens);
+
+#endif /* _TOKENIZER_H */
@@ -0,0 +1,352 @@
+#include "tweets_corpus.h"
+#include "tokenizer.h"
+
+#include <string.h>
+
+/**
+ * Print function for strings
+ * @param data pointer to string data
+ */
+void print_string(void *data) {
+    if (data != NULL) {
+        printf("%s", (char*)data);
+    }
+}
+
+/**
+ * Comparison function for strings
+ * @param first_data pointer to first string
+ * @param second_data pointer to second string
+ * @return comparison result like strcmp
+ */
+int comp_strings(void *first_data, void *second_data) {
+    if (first_data == NULL || second_data == NULL) {
+        return 0; // Consider NULL values as equal
+    }
+    return strcmp((char*)first_data, (char*)second_data);
+}
+
+/**
+ * Free function for strings
+ * @param data pointer to string data to free
+ */
+void free_string(void *data) {
+    markov_data_free(data);
+}
+
+/**
+ * Copy function for strings
+ * @param data pointer to string data to copy
+ * @return pointer to newly allocated copy
+ */
+void* copy_string(void *data) {
+    if (data == NULL) {
+        return NULL;
+    }
+
+    char *str = (char*)data;
+    char *copy = markov_data_alloc(strlen(str) + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    strcpy(copy, str);
+    return copy;
+}
+
+/**
+ * Check if string should be last in sequence (ends with period)
+ * @param data pointer to string data
+ * @return true if string ends with period, false otherwise
+ */
+bool is_last_string(void *data) {
+    if (data == NULL) {
+        return false;
+    }
+
+    char *str = (char*)data;
+    int length = strlen(str);
+    return (length > 0 && str[length - 1] == '.');
+}
+
+/**
+ * Hash a word that is not NUL-terminated, equal to hash_string() of the
+ * same characters
+ * @param word first character of the word
+ * @param length number of characters
+ * @return hash of the word
+ */
+uint64_t hash_word(const char *word, size_t length) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)word[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/**
+ * Hash function for strings (FNV-1a), consistent with comp_strings
+ * @param data pointer to string data
+ * @return hash of the string
+ */
+uint64_t hash_string(void *data) {
+    return hash_word((char*)data, strlen((char*)data));
+}
+
+/**
+ * Serialize a string as a 32-bit length followed by its bytes.
+ * @param data pointer to string data
+ * @param fp file to write to
+ * @return 0 on success, 1 on write error
+ */
+int write_string(void *data, FILE *fp) {
+    size_t length = strlen((char*)data);
+    unsigned char header[4];
+    for (int i = 0; i < 4; i++) {
+        header[i] = (unsigned char)(length >> (8 * i));
+    }
+    if (fwrite(header, 1, 4, fp) != 4 || fwrite(data, 1, length, fp) != length) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Read back a string written by write_string().
+ * @param fp file to read from
+ * @return newly allocated string, NULL on read or allocation error
+ */
+void* read_string(FILE *fp) {
+    unsigned char header[4];
+    if (fread(header, 1, 4, fp) != 4) {
+        return NULL;
+    }
+    size_t length = 0;
+    for (int i = 0; i < 4; i++) {
+        length |= (size_t)header[i] << (8 * i);
+    }
+
+    char *str = markov_data_alloc(length + 1);
+    if (str == NULL) {
+        return NULL;
+    }
+    if (fread(str, 1, length, fp) != length) {
+        markov_data_free(str);
+        return NULL;
+    }
+    str[length] = '\0';
+    return str;
+}
+
+/**
+ * Allocate an empty markov chain over words, using the string functions
+ * above.
+ * @return the new chain, NULL in case of allocation error
+ */
+MarkovChain* create_tweets_chain(void) {
+    return create_markov_chain(print_string, comp_strings, free_string,
+                               copy_string, is_last_string);
+}
+
+/**
+ * Reads lines from the specified file, adds words to the markov chain, and builds the connections
+ * between them according to the text.
+ * @param fp File pointer to the corpus file
+ * @param words_to_read Maximum number of words to read, or -1 for unlimited
+ * @param markov_chain The markov chain to update
+ * @return 0 on success, 1 on failure (memory allocation error)
+ */
+int fill_database(FILE *fp, int words_to_read, MarkovChain *markov_chain) {
+    char line[MAX_LINE_LENGTH];
+    int words_read = 0;
+    MarkovNode *prev_node = NULL;
+
+    while (fgets(line, MAX_LINE_LENGTH, fp) != NULL) {
+        Tokenizer tokenizer;
+        TokenSpan token;
+        init_tokenizer(&tokenizer, line, strlen(line));
+
+        while (next_token(&tokenizer, &token)) {
+            // Check if we reached the word limit
+            if (words_to_read != -1 && words_read >= words_to_read) {
+                return 0; // Successfully read the required number of words
+            }
+
+            // Terminate the word in place, like strtok would
+            char *word = line + (token.start - line);
+            word[token.length] = '\0';
+
+            // Add the current word to the database
+            Node *word_node = add_to_database(markov_chain, word);
+            if (word_node == NULL) {
+                return 1; // Memory allocation error
+            }
+
+            // Get the MarkovNode for this word
+            MarkovNode *current_node = word_node->data;
+            words_read++;
+
+            // If there was a previous word, connect it to the current word
+            if (prev_node != NULL) {
+                if (add_node_to_frequency_list(markov_chain, prev_node, current_node) != 0) {
+                    return 1; // Memory allocation error
+                }
+            }
+
+            // Check if this word ends with a period (end of sentence)
+            if (token.ends_sentence) {
+                // This is the end of a sentence
+                prev_node = NULL; // Reset for the next sentence
+            } else {
+                // Move to the next word
+                prev_node = current_node;
+            }
+        }
+    }
+
+    return 0; // Success
+}
+
+/**
+ * Receives one sentence of a streamed corpus.
+ * @param target what the sentence is added to
+ * @param words the sentence's words
+ * @param length number of words
+ * @return 0 on success, 1 on failure
+ */
+typedef int (*add_sentence)(void *target, void **words, int length);
+
+/**
+ * Free the words of a sentence and the array holding them.
+ * @param words copies of the sentence's words
+ * @param length number of words
+ */
+static void free_words(char **words, int length) {
+    for (int i = 0; i < length; i++) {
+        free(words[i]);
+    }
+    free(words);
+}
+
+/**
+ * Add the pending sentence and free its words.
+ * @param add how to add the sentence
+ * @param target what the sentence is added to
+ * @param words copies of the sentence's words
+ * @param length number of words, reset to 0
+ * @return 0 on success, 1 on failure
+ */
+static int flush_sentence(add_sentence add, void *target, char **words, int *length) {
+    if (*length == 0) {
+        return 0;
+    }
+    int result = add(target, (void **)words, *length);
+    for (int i = 0; i < *length; i++) {
+        free(words[i]);
+    }
+    *length = 0;
+    return result;
+}
+
+/**
+ * Stream a corpus one sentence at a time, split exactly like
+ * fill_database() splits it.
+ * @param fp File pointer to the corpus file
+ * @param words_to_read Maximum number of words to read, or -1 for unlimited
+ * @param add how to add a sentence
+ * @param target what the sentences are added to
+ * @return 0 on success, 1 on failure
+ */
+static int read_sentences(FILE *fp, int words_to_read, add_sentence add, void *target) {
+    char line[MAX_LINE_LENGTH];
+    int words_read = 0;
+    // A sentence may span lines, so its words are copied out of the line
+    char **words = NULL;
+    int length = 0, capacity = 0;
+
+    while ((words_to_read == -1 || words_read < words_to_read) &&
+           fgets(line, MAX_LINE_LENGTH, fp) != NULL) {
+        Tokenizer tokenizer;
+        TokenSpan token;
+        init_tokenizer(&tokenizer, line, strlen(line));
+
+        while ((words_to_read == -1 || words_read < words_to_read) &&
+               next_token(&tokenizer, &token)) {
+            if (length == capacity) {
+                int new_capacity = capacity > 0 ? capacity * 2 : 16;
+                char **new_words = realloc(words, (size_t)new_capacity * sizeof(char *));
+                if (new_words == NULL) {
+                    fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+                    // The sentence is cut short: drop it rather than add a part
+                    free_words(words, length);
+                    return 1;
+                }
+                words = new_words;
+                capacity = new_capacity;
+            }
+
+            words[length] = malloc(token.length + 1);
+            if (words[length] == NULL) {
+                fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+                free_words(words, length);
+                return 1;
+            }
+            memcpy(words[length], token.start, token.length);
+            words[length++][token.length] = '\0';
+            words_read++;
+
+            if (token.ends_sentence && flush_sentence(add, target, words, &length) != 0) {
+                free(words);
+                return 1;
+            }
+        }
+    }
+
+    int result = flush_sentence(add, target, words, &length);
+    free(words);
+    return result;
+}
+
+/**
+ * add_sentence for a ChainWindow.
+ */
+static int add_to_window(void *target, void **words, int length) {
+    return window_add_sentence(target, words, length);
+}
+
+/**
+ * add_sentence for an ExternalBuilder.
+ */
+static int add_to_external(void *target, void **words, int length) {
+    return external_add_sentence(target, words, length);
+}
+
+/**
+ * add_sentence for a SketchChain.
+ */
+static int add_to_sketch(void *target, void **words, int length) {
+    return sketch_add_sentence(target, words, length);
+}
+
+/**
+ * add_sentence for a SharedChain.
+ */
+static int add_to_shared(void *target, void **words, int length) {
+    return shared_add_sentence(target, words, length);
+}
+
+int fill_window(FILE *fp, int words_to_read, ChainWindow *window) {
+    return read_sentences(fp, words_to_read, add_to_window, window);
+}
+
+int fill_external(FILE *fp, int words_to_read, ExternalBuilder *builder) {
+    return read_sentences(fp, words_to_read, add_to_external, builder);
+}
+
+int fill_sketch(FILE *fp, int words_to_read, SketchChain *sketch_chain) {
+    return read_sentences(fp, words_to_read, add_to_sketch, sketch_chain);
+}
+
+int fill_shared(FILE *fp, int words_to_read, SharedChain *shared_chain) {
+    return read_sentences(fp, words_to_read, add_to_shared, shared_chain);
+}
@@ -0,0 +1,138 @@
+#ifndef _TWEETS_CORPUS_H
+#define _TWEETS_CORPUS_H
+
+#include "markov_chain.h"
+#include "markov_window.h"
+#include "markov_external.h"
+#include "markov_sketch.h"
+#include "markov_vocabulary.h"
+
+#define MAX_LINE_LENGTH 1000
+
+#define DELIMITERS " \n\t\r"
+
+/**
+ * Print function for strings
+ * @param data pointer to string data
+ */
+void print_string(void *data);
+
+/**
+ * Comparison function for strings
+ * @param first_data pointer to first string
+ * @param second_data pointer to second string
+ * @return comparison result like strcmp
+ */
+int comp_strings(void *first_data, void *second_data);
+
+/**
+ * Free function for strings made by copy_string() or read_string()
+ * @param data pointer to string data to free
+ */
+void free_string(void *data);
+
+/**
+ * Copy function for strings
+ * @param data pointer to string data to copy
+ * @return pointer to newly allocated copy, from markov_data_alloc()
+ */
+void *copy_string(void *data);
+
+/**
+ * Check if string should be last in sequence (ends with period)
+ * @param data pointer to string data
+ * @return true if string ends with period, false otherwise
+ */
+bool is_last_string(void *data);
+
+/**
+ * Hash function for strings (FNV-1a), consistent with comp_strings
+ * @param data pointer to string data
+ * @return hash of the string
+ */
+uint64_t hash_string(void *data);
+
+/**
+ * Hash a word that is not NUL-terminated, equal to hash_string() of the
+ * same characters
+ * @param word first character of the word
+ * @param length number of characters
+ * @return hash of the word
+ */
+uint64_t hash_word(const char *word, size_t length);
+
+/**
+ * Serialize a string as a 32-bit length followed by its bytes.
+ * @param data pointer to string data
+ * @param fp file to write to
+ * @return 0 on success, 1 on write error
+ */
+int write_string(void *data, FILE *fp);
+
+/**
+ * Read back a string written by write_string().
+ * @param fp file to read from
+ * @return newly allocated string, from markov_data_alloc(); NULL on read or
+ * allocation error
+ */
+void *read_string(FILE *fp);
+
+/**
+ * Allocate an empty markov chain over words, using the string functions
+ * above.
+ * @return the new chain, NULL in case of allocation error
+ */
+MarkovChain *create_tweets_chain(void);
+
+/**
+ * Reads lines from the specified file, adds words to the markov chain, and builds the connections
+ * between them according to the text.
+ * @param fp File pointer to the corpus file
+ * @param words_to_read Maximum number of words to read, or -1 for unlimited
+ * @param markov_chain The markov chain to update
+ * @return 0 on success, 1 on failure (memory allocation error)
+ */
+int fill_database(FILE *fp, int words_to_read, MarkovChain *markov_chain);
+
+/**
+ * Stream a corpus into a windowed chain, one sentence at a time. Words and
+ * sentences are split exactly like fill_database() splits them; a sentence
+ * still open at the end of the input is added as is.
+ * @param fp File pointer to the corpus file
+ * @param words_to_read Maximum number of words to read, or -1 for unlimited
+ * @param window The window feeding the markov chain
+ * @return 0 on success, 1 on failure (memory allocation error)
+ */
+int fill_window(FILE *fp, int words_to_read, ChainWindow *window);
+
+/**
+ * Stream a corpus into an external build, one sentence at a time, split
+ * like fill_window() splits it.
+ * @param fp File pointer to the corpus file
+ * @param words_to_read Maximum number of words to read, or -1 for unlimited
+ * @param builder The builder collecting the transitions
+ * @return 0 on success, 1 on failure (allocation or spill error)
+ */
+int fill_external(FILE *fp, int words_to_read, ExternalBuilder *builder);
+
+/**
+ * Stream a corpus into an approximate chain, one sentence at a time, split
+ * like fill_window() splits it.
+ * @param fp File pointer to the corpus file
+ * @param words_to_read Maximum number of words to read, or -1 for unlimited
+ * @param sketch_chain The sketch counting the transitions
+ * @return 0 on success, 1 on failure (memory allocation error)
+ */
+int fill_sketch(FILE *fp, int words_to_read, SketchChain *sketch_chain);
+
+/**
+ * Stream a corpus into a chain over a shared vocabulary, one sentence at a
+ * time, split like fill_window() splits it.
+ * @param fp File pointer to the corpus file
+ * @param words_to_read Maximum number of words to read, or -1 for unlimited
+ * @param shared_chain The chain to train
+ * @return 0 on success, 1 on failure (memory allocation error)
+ */
+int fill_shared(FILE *fp, int words_to_read, SharedChain *shared_chain);
+
+#endif /* _TWEETS_CORPUS_H */
@@ -1,275 +1,84 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "markov_chain.h"
-#include <stdbool.h>
+#include "tweets_corpus.h"
+#include "markov_batch.h"
+#include "markov_reverse.h"
 
-#define MAX_LINE_LENGTH 1000
 #define MAX_TWEET_LENGTH 20
 
 //Don't change the macros!
 #define FILE_PATH_ERROR "Error: incorrect file path"
 #define NUM_ARGS_ERROR "Usage: invalid number of arguments"
 
-#define DELIMITERS " \n\t\r"
-
-/**
- * Print function for strings
- * @param data pointer to string data
- */
-void print_string(void *data) {
-    if (data != NULL) {
-        printf("%s", (char*)data);
-    }
-}
-
-/**
- * Comparison function for strings
- * @param first_data pointer to first string
- * @param second_data pointer to second string
- * @return comparison result like strcmp
- */
-int comp_strings(void *first_data, void *second_data) {
-    if (first_data == NULL || second_data == NULL) {
-        return 0; // Consider NULL values as equal
-    }
-    return strcmp((char*)first_data, (char*)second_data);
-}
-
-/**
- * Free function for strings
- * @param data pointer to string data to free
- */
-void free_string(void *data) {
-    if (data != NULL) {
-        free(data);
-    }
-}
-
 /**
- * Copy function for strings
- * @param data pointer to string data to copy
- * @return pointer to newly allocated copy
+ * Print tweets that all go through one word: each grows backward from the
+ * word to a sentence start, then forward to a sentence end.
+ * @param markov_chain trained chain
+ * @param word word every tweet contains
+ * @param seed seed of the random stream
+ * @param num_tweets number of tweets to print
+ * @return EXIT_SUCCESS or EXIT_FAILURE
  */
-void* copy_string(void *data) {
-    if (data == NULL) {
-        return NULL;
-    }
-
-    char *str = (char*)data;
-    char *copy = malloc(strlen(str) + 1);
-    if (copy == NULL) {
-        return NULL;
-    }
-
-    strcpy(copy, str);
-    return copy;
-}
-
-/**
- * Check if string should be last in sequence (ends with period)
- * @param data pointer to string data
- * @return true if string ends with period, false otherwise
- */
-bool is_last_string(void *data) {
-    if (data == NULL) {
-        return false;
+static int print_tweets_through(MarkovChain *markov_chain, const char *word,
+                                unsigned int seed, int num_tweets) {
+    Node *word_node = get_node_from_database(markov_chain, (void *)word);
+    if (word_node == NULL) {
+        fprintf(stdout, "Error: \"%s\" is not in the corpus.\n", word);
+        return EXIT_FAILURE;
     }
 
-    char *str = (char*)data;
-    int length = strlen(str);
-    return (length > 0 && str[length - 1] == '.');
-}
-
-int get_random_number(int max_number);
-
-/**
- * Reads lines from the specified file, adds words to the markov chain, and builds the connections
- * between them according to the text.
- * @param fp File pointer to the corpus file
- * @param words_to_read Maximum number of words to read, or -1 for unlimited
- * @param markov_chain The markov chain to update
- * @return 0 on success, 1 on failure (memory allocation error)
- */
-int fill_database(FILE *fp, int words_to_read, MarkovChain *markov_chain) {
-    char line[MAX_LINE_LENGTH];
-    int words_read = 0;
-    MarkovNode *prev_node = NULL;
-
-    while (fgets(line, MAX_LINE_LENGTH, fp) != NULL) {
-        char *word = strtok(line, DELIMITERS);
-
-        while (word != NULL) {
-            // Check if we reached the word limit
-            if (words_to_read != -1 && words_read >= words_to_read) {
-                return 0; // Successfully read the required number of words
-            }
-
-            // Add the current word to the database
-            Node *word_node = add_to_database(markov_chain, word);
-            if (word_node == NULL) {
-                return 1; // Memory allocation error
-            }
-
-            // Get the MarkovNode for this word
-            MarkovNode *current_node = word_node->data;
-            words_read++;
-
-            // If there was a previous word, connect it to the current word
-            if (prev_node != NULL) {
-                if (add_node_to_frequency_list(prev_node, current_node) != 0) {
-                    return 1; // Memory allocation error
-                }
-            }
-
-            // Check if this word ends with a period (end of sentence)
-            int length = strlen(word);
-            if (length > 0 && word[length - 1] == '.') {
-                // This is the end of a sentence
-                prev_node = NULL; // Reset for the next sentence
-            } else {
-                // Move to the next word
-                prev_node = current_node;
-            }
-
-            // Get the next word
-            word = strtok(NULL, DELIMITERS);
-        }
+    PredecessorIndex *index = build_predecessor_index(markov_chain);
+    MarkovNode *tweet[MAX_TWEET_LENGTH];
+    if (index == NULL) {
+        fprintf(stderr, "Error: Could not generate tweets.\n");
+        return EXIT_FAILURE;
     }
 
-    return 0; // Success
-}
-
-
-/**
- * Returns a random first node from the database that isn't a sentence-ending word
- * @param markov_chain The markov chain
- * @return A random MarkovNode that isn't a sentence-ending word
- */
-MarkovNode* get_first_random_node(MarkovChain *markov_chain) {
-    if (markov_chain == NULL || markov_chain->database == NULL ||
-        markov_chain->database->size == 0) {
-        return NULL;
-        }
-
-    // Get a random node from the database
-    Node *current = NULL;
-    MarkovNode *random_node = NULL;
-    int random_index;
-
-    // Keep selecting random nodes until we find one that doesn't end with a period
-    do {
-        // Generate a random index between 0 and size-1
-        random_index = get_random_number(markov_chain->database->size);
-
-        // Get the node at the random index
-        current = markov_chain->database->first;
-        for (int i = 0; i < random_index && current != NULL; i++) {
-            current = current->next;
-        }
-
-        // Get the MarkovNode from the current node
-        if (current != NULL) {
-            MarkovNode *markov_node = (MarkovNode *)current->data;
-            // Check if this node should be last in sequence
-            if (markov_node != NULL && markov_node->data != NULL) {
-                if (!markov_chain->is_last(markov_node->data)) {
-                    return markov_node;
-                }
+    MarkovRandom random;
+    seed_random(&random, seed);
+    for (int i = 0; i < num_tweets; i++) {
+        int length = generate_through_sequence(index, markov_chain, word_node->data,
+                                               MAX_TWEET_LENGTH, &random, tweet, NULL);
+        printf("Tweet %d: ", i + 1);
+        for (int j = 0; j < length; j++) {
+            if (j > 0) {
+                printf(" ");
             }
-        } else {
-            // This should never happen if the database is properly set up
-            return NULL;
-        }
-
-
-        // If we're here, the selected node was a sentence-ending word
-        // We'll try again with a new random index
-    } while (1); // Keep trying until we find a suitable node
-
-    // This line should never be reached
-    return NULL;
-}
-
-/**
- * Returns a random next node from the given node's frequency list
- * The random selection is weighted by the frequencies of each following word
- * @param cur_markov_node Current MarkovNode to find a successor for
- * @return A random MarkovNode from the frequency list
- */
-MarkovNode* get_next_random_node(MarkovNode *cur_markov_node) {
-    // Check for NULL input or empty frequency list
-    if (cur_markov_node == NULL ||
-        cur_markov_node->frequency_list == NULL ||
-        cur_markov_node->frequency_list_size == 0) {
-        return NULL;
-        }
-
-    // Calculate the total frequency of all words that follow the current word
-    int total_frequency = 0;
-    for (int i = 0; i < cur_markov_node->frequency_list_size; i++) {
-        total_frequency += cur_markov_node->frequency_list[i].frequency;
-    }
-
-    // Generate a random number between 0 and total_frequency - 1
-    int random_num = get_random_number(total_frequency);
-
-    // Select a word based on weighted probabilities
-    int cumulative_frequency = 0;
-    for (int i = 0; i < cur_markov_node->frequency_list_size; i++) {
-        cumulative_frequency += cur_markov_node->frequency_list[i].frequency;
-        if (random_num < cumulative_frequency) {
-            return cur_markov_node->frequency_list[i].markov_node;
+            markov_chain->print_func(tweet[j]->data);
         }
+        printf("\n");
     }
 
-    // This should never happen if the frequency list is properly set up
-    return NULL;
+    free_predecessor_index(&index);
+    return EXIT_SUCCESS;
 }
 
-
-
 /**
- * Generates a tweet starting from the given first_node
- * Continues to select random next words based on the Markov chain probabilities
- * until reaching a sentence-ending word or max_length
- * @param markov_chain The markov chain
- * @param first_node The first word in the tweet
- * @param max_length Maximum number of words to include in the tweet
+ * @param argc num of arguments
+ * @param argv 1) Optional -u, only print distinct tweets, or -w and a word
+ *                every tweet goes through
+ *             2) Seed
+ *             3) Number of tweets to generate
+ *             4) Corpus file
+ *             5) Optional number of words to read
+ * @return EXIT_SUCCESS or EXIT_FAILURE
  */
-void generate_random_sequence(MarkovChain *markov_chain, MarkovNode *first_node, int max_length) {
-    if (markov_chain == NULL || first_node == NULL || max_length <= 0) {
-        return;
+int main(int argc, char *argv[]) {
+    // Distinct tweets only, filtered while generating
+    bool unique = argc >= 2 && strcmp(argv[1], "-u") == 0;
+    if (unique) {
+        argc--;
+        argv++;
     }
-
-    MarkovNode *current_node = first_node;
-    int word_count = 0;
-
-    // Generate and print the sequence
-    while (word_count < max_length) {
-        // Print the current node's data
-        markov_chain->print_func(current_node->data);
-        word_count++;
-
-        // Check if this should be the last node in the sequence
-        if (markov_chain->is_last(current_node->data)) {
-            break;
-        }
-
-        // Get the next node
-        current_node = get_next_random_node(current_node);
-        if (current_node == NULL) {
-            break; // No next node available
-        }
-
-        // Print a space separator before the next word
-        printf(" ");
+    // A word every tweet must contain, generated outward from it
+    const char *through_word = NULL;
+    if (!unique && argc >= 3 && strcmp(argv[1], "-w") == 0) {
+        through_word = argv[2];
+        argc -= 2;
+        argv += 2;
     }
-}
 
-
-
-int main(int argc, char *argv[]) {
     // Check if the correct number of arguments was provided
     if (argc != 4 && argc != 5) {
         fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
@@ -319,35 +128,14 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // Create and initialize the markov chain
-    MarkovChain *markov_chain = malloc(sizeof(MarkovChain));
+    // Create the markov chain with the string operations
+    MarkovChain *markov_chain = create_tweets_chain();
     if (markov_chain == NULL) {
         fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
         fclose(fp);
         return EXIT_FAILURE;
     }
 
-    // Initialize the database (linked list)
-    markov_chain->database = malloc(sizeof(LinkedList));
-    if (markov_chain->database == NULL) {
-        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
-        free(markov_chain);
-        fclose(fp);
-        return EXIT_FAILURE;
-    }
-
-    // Initialize the linked list fields
-    markov_chain->database->first = NULL;
-    markov_chain->database->last = NULL;
-    markov_chain->database->size = 0;
-
-    // Set up the function pointers for string operations
-    markov_chain->print_func = print_string;
-    markov_chain->comp_func = comp_strings;
-    markov_chain->free_data = free_string;
-    markov_chain->copy_func = copy_string;
-    markov_chain->is_last = is_last_string;
-
     // Fill the markov chain from the file
     if (fill_database(fp, words_to_read, markov_chain) != 0) {
         // Memory allocation error occurred
@@ -360,25 +148,42 @@ int main(int argc, char *argv[]) {
     // Close the file
     fclose(fp);
 
-    // Generate and print the random tweets
-    for (int i = 0; i < num_tweets; i++) {
-        // Print the tweet header
-        printf("Tweet %d: ", i + 1);
-
-        // Get a random first node to start the tweet
-        MarkovNode *first_node = get_first_random_node(markov_chain);
-        if (first_node == NULL) {
-            fprintf(stderr, "Error: Could not get a random starting node.\n");
-            free_database(&markov_chain);
-            return EXIT_FAILURE;
-        }
-
-        // Get a random first node to start the tweet and generate the sequence
-        generate_random_sequence(markov_chain, first_node, MAX_TWEET_LENGTH);
+    if (through_word != NULL) {
+        int result = print_tweets_through(markov_chain, through_word, seed, num_tweets);
+        free_database(&markov_chain);
+        return result;
+    }
+
+    // Generate all tweets into one arena, then print them
+    SequenceBatch tweets = {NULL, NULL, 0, 0, 0, 0};
+    SequenceFilter filter = {NULL, 0, 0, 0, 0};
+    int result;
+    if (unique) {
+        result = init_sequence_filter(&filter, (size_t)num_tweets) != 0 ||
+                 generate_unique_batch(markov_chain, NULL, MAX_TWEET_LENGTH,
+                                       (size_t)num_tweets, &tweets, &filter) != 0;
+        free_sequence_filter(&filter);
+    } else {
+        result = generate_sequence_batch(markov_chain, NULL, MAX_TWEET_LENGTH,
+                                         (size_t)num_tweets, &tweets);
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error: Could not generate tweets.\n");
+        free_sequence_batch(&tweets);
+        free_database(&markov_chain);
+        return EXIT_FAILURE;
+    }
+    if (tweets.num_sequences < (size_t)num_tweets) {
+        fprintf(stderr, "Only %zu distinct tweets could be generated.\n",
+                tweets.num_sequences);
+    }
 
-        // Add a newline after each tweet
+    for (size_t i = 0; i < tweets.num_sequences; i++) {
+        printf("Tweet %zu: ", i + 1);
+        print_sequence(markov_chain, &tweets, i);
         printf("\n");
     }
+    free_sequence_batch(&tweets);
 
     // Free the allocated memory
     free_database(&markov_chain);
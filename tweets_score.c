@@ -0,0 +1,320 @@
+#include "tweets_score.h"
+#include "tweets_corpus.h"
+#include "tokenizer.h"
+
+#include <math.h>    // for log(), exp()
+#include <pthread.h> // for pthread_create(), pthread_join()
+#include <string.h>  // for memcpy()
+#include <unistd.h>  // for sysconf()
+
+// Words resolved per index_lookup_batch() call
+#define SCORE_CHUNK_WORDS 64
+
+/**
+ * Texts of one thread and the shared read-only context.
+ */
+typedef struct ScoringWorker {
+    const TweetScorer *scorer;
+    const ScoringOptions *options;
+    const char *const *texts;
+    SequenceScore *scores;
+    size_t first_text;
+    size_t end_text;
+    // copy of the text being scored, its words NUL-terminated in place
+    char *buffer;
+    size_t buffer_capacity;
+    bool failed;
+} ScoringWorker;
+
+ScoringOptions default_scoring_options(void) {
+    return (ScoringOptions) {0.1, -13.815510557964274, 0};
+}
+
+/**
+ * Slot of a transition key in the edge table.
+ * @param key transition key
+ * @param capacity table capacity, a power of two
+ * @return first slot to probe
+ */
+static size_t edge_slot(uint64_t key, size_t capacity) {
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+/**
+ * Build the transition count table.
+ * @param scorer scorer with totals and capacity set
+ * @param markov_chain word chain with fresh ids
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int build_edge_table(TweetScorer *scorer, MarkovChain *markov_chain) {
+    scorer->edge_keys = calloc(scorer->edge_capacity, sizeof(uint64_t));
+    scorer->edge_counts = malloc(scorer->edge_capacity * sizeof(uint64_t));
+    if (scorer->edge_keys == NULL || scorer->edge_counts == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return 1;
+    }
+
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        MarkovNode *markov_node = current->data;
+        scorer->totals[markov_node->id] = markov_node->total_frequency;
+        for (int i = 0; i < markov_node->frequency_list_size; i++) {
+            uint64_t key = (((uint64_t)markov_node->id << 32) |
+                            (uint64_t)markov_node->frequency_list[i]->id) + 1;
+            size_t slot = edge_slot(key, scorer->edge_capacity);
+            while (scorer->edge_keys[slot] != 0) {
+                slot = (slot + 1) & (scorer->edge_capacity - 1);
+            }
+            scorer->edge_keys[slot] = key;
+            scorer->edge_counts[slot] = get_frequency(markov_node, i);
+        }
+    }
+    return 0;
+}
+
+TweetScorer *create_tweet_scorer(MarkovChain *markov_chain) {
+    if (markov_chain == NULL || markov_chain->database == NULL) {
+        return NULL;
+    }
+
+    TweetScorer *scorer = calloc(1, sizeof(TweetScorer));
+    if (scorer == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        return NULL;
+    }
+
+    // Fresh ids, and the edge table sized for a load factor of at most 1/2
+    size_t num_edges = 0;
+    int id = 0;
+    for (Node *current = markov_chain->database->first; current != NULL;
+         current = current->next) {
+        current->data->id = id++;
+        num_edges += (size_t)current->data->frequency_list_size;
+    }
+    scorer->num_states = id;
+    scorer->edge_capacity = 16;
+    while (scorer->edge_capacity < 2 * num_edges) {
+        scorer->edge_capacity *= 2;
+    }
+
+    scorer->totals = malloc(((size_t)id + 1) * sizeof(uint64_t));
+    scorer->index = build_state_index(markov_chain, hash_string);
+    if (scorer->totals == NULL || scorer->index == NULL ||
+        build_edge_table(scorer, markov_chain) != 0) {
+        if (scorer->totals == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        }
+        free_tweet_scorer(&scorer);
+        return NULL;
+    }
+    return scorer;
+}
+
+/**
+ * Count of a transition.
+ * @param scorer scoring tables
+ * @param from state id of the word
+ * @param to state id of the next word
+ * @return the count, 0 if never seen
+ */
+static uint64_t transition_count(const TweetScorer *scorer, int from, int to) {
+    uint64_t key = (((uint64_t)from << 32) | (uint64_t)to) + 1;
+    size_t mask = scorer->edge_capacity - 1;
+    for (size_t slot = edge_slot(key, scorer->edge_capacity); scorer->edge_keys[slot] != 0;
+         slot = (slot + 1) & mask) {
+        if (scorer->edge_keys[slot] == key) {
+            return scorer->edge_counts[slot];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Log-probability of a transition under the smoothing options.
+ * @param scorer scoring tables
+ * @param options smoothing options
+ * @param from state id of the word, -1 for unknown words
+ * @param to state id of the next word, -1 for unknown words
+ * @return the log-probability
+ */
+static double transition_log_probability(const TweetScorer *scorer,
+                                         const ScoringOptions *options,
+                                         int from, int to) {
+    uint64_t total = from >= 0 ? scorer->totals[from] : 0;
+    uint64_t count = from >= 0 && to >= 0 ? transition_count(scorer, from, to) : 0;
+    if (options->alpha > 0) {
+        double vocabulary = (double)scorer->num_states + 1;
+        return log(((double)count + options->alpha) /
+                   ((double)total + options->alpha * vocabulary));
+    }
+    return count > 0 ? log((double)count / (double)total) : options->unseen_log_probability;
+}
+
+/**
+ * Score a chunk of words whose states were just resolved.
+ * @param worker worker scoring the text
+ * @param states state of every word, NULL for unknown words
+ * @param ends_sentence whether each word ends a sentence
+ * @param count number of words
+ * @param in_sentence whether the word before the chunk continues a sentence
+ * @param previous state id of the word before the chunk, -1 if unknown
+ * @param score score to add to
+ */
+static void score_chunk(const ScoringWorker *worker, MarkovNode *const *states,
+                        const bool *ends_sentence, size_t count, bool *in_sentence,
+                        int *previous, SequenceScore *score) {
+    for (size_t i = 0; i < count; i++) {
+        int current = states[i] != NULL ? states[i]->id : -1;
+        score->num_words++;
+        score->num_unknown_words += current < 0;
+
+        if (*in_sentence) {
+            score->log_likelihood += transition_log_probability(worker->scorer,
+                                                                worker->options,
+                                                                *previous, current);
+            score->num_transitions++;
+        }
+
+        // Same sentence split as fill_database()
+        *in_sentence = !ends_sentence[i];
+        *previous = current;
+    }
+}
+
+/**
+ * Score one text, resolving its words SCORE_CHUNK_WORDS at a time.
+ * @param worker worker scoring the text
+ * @param text NUL-terminated text
+ * @param score output
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int score_text(ScoringWorker *worker, const char *text, SequenceScore *score) {
+    *score = (SequenceScore) {0, 1, 0, 0, 0};
+
+    size_t length = strlen(text);
+    if (length + 1 > worker->buffer_capacity) {
+        char *buffer = realloc(worker->buffer, length + 1);
+        if (buffer == NULL) {
+            fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+            return 1;
+        }
+        worker->buffer = buffer;
+        worker->buffer_capacity = length + 1;
+    }
+    memcpy(worker->buffer, text, length + 1);
+
+    void *words[SCORE_CHUNK_WORDS];
+    MarkovNode *states[SCORE_CHUNK_WORDS];
+    bool ends_sentence[SCORE_CHUNK_WORDS];
+    size_t count = 0;
+    bool in_sentence = false;
+    int previous = -1;
+
+    Tokenizer tokenizer;
+    TokenSpan token;
+    init_tokenizer(&tokenizer, worker->buffer, length);
+    while (next_token(&tokenizer, &token)) {
+        // Terminate the word in place, like fill_database() does
+        char *word = worker->buffer + (token.start - worker->buffer);
+        word[token.length] = '\0';
+        words[count] = word;
+        ends_sentence[count++] = token.ends_sentence;
+
+        if (count == SCORE_CHUNK_WORDS) {
+            index_lookup_batch(worker->scorer->index, words, count, states);
+            score_chunk(worker, states, ends_sentence, count, &in_sentence, &previous, score);
+            count = 0;
+        }
+    }
+    index_lookup_batch(worker->scorer->index, words, count, states);
+    score_chunk(worker, states, ends_sentence, count, &in_sentence, &previous, score);
+
+    if (score->num_transitions > 0) {
+        score->perplexity = exp(-score->log_likelihood / score->num_transitions);
+    }
+    return 0;
+}
+
+/**
+ * Score the texts of one thread.
+ * @param arg ScoringWorker of this thread
+ * @return NULL
+ */
+static void *score_range(void *arg) {
+    ScoringWorker *worker = arg;
+    for (size_t i = worker->first_text; i < worker->end_text && !worker->failed; i++) {
+        worker->failed = score_text(worker, worker->texts[i], &worker->scores[i]) != 0;
+    }
+    return NULL;
+}
+
+int score_tweets(const TweetScorer *scorer, const char *const *texts, size_t num_texts,
+                 const ScoringOptions *options, SequenceScore *scores) {
+    ScoringOptions settings = options != NULL ? *options : default_scoring_options();
+    if (scorer == NULL || texts == NULL || scores == NULL || settings.alpha < 0) {
+        return 1;
+    }
+
+    size_t num_threads = settings.num_threads > 0 ? (size_t)settings.num_threads : 0;
+    if (num_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = online > 0 ? (size_t)online : 1;
+    }
+    if (num_threads > num_texts) {
+        num_threads = num_texts > 0 ? num_texts : 1;
+    }
+
+    ScoringWorker *workers = malloc(num_threads * sizeof(ScoringWorker));
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    if (workers == NULL || threads == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        free(workers);
+        free(threads);
+        return 1;
+    }
+
+    for (size_t w = 0; w < num_threads; w++) {
+        workers[w] = (ScoringWorker) {scorer, &settings, texts, scores,
+                                      num_texts * w / num_threads,
+                                      num_texts * (w + 1) / num_threads,
+                                      NULL, 0, false};
+    }
+
+    // The calling thread takes the first range itself
+    size_t started = 1;
+    for (; started < num_threads; started++) {
+        if (pthread_create(&threads[started], NULL, score_range, &workers[started]) != 0) {
+            break;
+        }
+    }
+    score_range(&workers[0]);
+    for (size_t w = 1; w < num_threads; w++) {
+        if (w < started) {
+            pthread_join(threads[w], NULL);
+        } else {
+            score_range(&workers[w]);
+        }
+    }
+
+    int result = 0;
+    for (size_t w = 0; w < num_threads; w++) {
+        result |= workers[w].failed;
+        free(workers[w].buffer);
+    }
+    free(workers);
+    free(threads);
+    return result;
+}
+
+void free_tweet_scorer(TweetScorer **scorer_ptr) {
+    if (scorer_ptr == NULL || *scorer_ptr == NULL) {
+        return;
+    }
+    TweetScorer *scorer = *scorer_ptr;
+    free_state_index(&scorer->index);
+    free(scorer->totals);
+    free(scorer->edge_keys);
+    free(scorer->edge_counts);
+    free(scorer);
+    *scorer_ptr = NULL;
+}
@@ -0,0 +1,87 @@
+#ifndef _TWEETS_SCORE_H
+#define _TWEETS_SCORE_H
+
+#include "markov_index.h"
+#include <stddef.h> // for size_t
+
+/**
+ * How score_tweets() handles transitions the chain never saw.
+ */
+typedef struct ScoringOptions {
+    // additive (Lidstone) smoothing: P(next | word) = (count + alpha) /
+    // (total + alpha * (num_states + 1)), the +1 standing for unknown words.
+    // 0 disables smoothing.
+    double alpha;
+    // log-probability charged for an unseen transition when alpha is 0
+    double unseen_log_probability;
+    // worker threads, values below 1 mean one per online CPU
+    int num_threads;
+} ScoringOptions;
+
+/**
+ * Score of one text.
+ */
+typedef struct SequenceScore {
+    // sum of the log-probabilities of all in-sentence transitions
+    double log_likelihood;
+    // exp(-log_likelihood / num_transitions), 1 without transitions
+    double perplexity;
+    int num_words;
+    int num_transitions;
+    int num_unknown_words;
+} SequenceScore;
+
+/**
+ * Read-only scoring tables of a word chain: a hash index from word to
+ * state, per state transition totals, and a hash table of transition
+ * counts keyed by (state, successor), so each word costs O(1).
+ */
+typedef struct TweetScorer {
+    StateIndex *index;
+    int num_states;
+    // total transition count of each state, by state id
+    uint64_t *totals;
+    // open addressing table of ((from << 32 | to) + 1) -> count, 0 = empty
+    uint64_t *edge_keys;
+    uint64_t *edge_counts;
+    size_t edge_capacity;
+} TweetScorer;
+
+/**
+ * Get the default options: alpha 0.1, unseen log-probability log(1e-6),
+ * one thread per CPU.
+ * @return the default options
+ */
+ScoringOptions default_scoring_options(void);
+
+/**
+ * Build the scoring tables of a chain built by fill_database(). State ids
+ * of the chain are refreshed; the chain must not change while the scorer
+ * is in use.
+ * @param markov_chain word chain
+ * @return the scorer, NULL in case of allocation error
+ */
+TweetScorer *create_tweet_scorer(MarkovChain *markov_chain);
+
+/**
+ * Score a batch of texts against the chain. Each text is split into words
+ * and sentences exactly like fill_database() splits a corpus, and only
+ * transitions inside a sentence are scored. The batch is split across
+ * threads; the scorer is shared read-only.
+ * @param scorer scoring tables
+ * @param texts NUL-terminated texts to score
+ * @param num_texts number of texts
+ * @param options scoring options, NULL for the defaults
+ * @param scores output array of num_texts scores
+ * @return 0 on success, 1 on invalid arguments or allocation error
+ */
+int score_tweets(const TweetScorer *scorer, const char *const *texts, size_t num_texts,
+                 const ScoringOptions *options, SequenceScore *scores);
+
+/**
+ * Free the scorer and set the pointer to NULL. The chain is not touched.
+ * @param scorer_ptr scorer to free
+ */
+void free_tweet_scorer(TweetScorer **scorer_ptr);
+
+#endif /* _TWEETS_SCORE_H */
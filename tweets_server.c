@@ -0,0 +1,400 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "tweets_corpus.h"
+#include "markov_batch.h"
+#include "markov_index.h"
+#include "markov_io.h"
+
+#define NUM_ARGS_ERROR "Usage: tweets_server <socket_path> <corpus_or_chain> [num_workers]"
+#define FILE_PATH_ERROR "Error: incorrect file path"
+
+#define DEFAULT_NUM_WORKERS 4
+#define MAX_WORKERS 256
+#define LISTEN_BACKLOG 64
+#define MAX_REQUEST_LENGTH 1024
+#define MAX_REQUEST_COUNT 100000
+#define MAX_REQUEST_WORDS 1000
+// States generated per batch call; bigger requests are answered in chunks
+#define MAX_CHUNK_STATES 65536
+// Seconds a client may stay silent (or not read its answer) before it is
+// dropped, so idle connections cannot hold on to workers
+#define CLIENT_IDLE_SECONDS 30
+
+/**
+ * What every worker shares. The chain, the start states and the index are
+ * never modified after loading, so workers read them without locking.
+ */
+typedef struct ServerState {
+    MarkovChain *markov_chain;
+    MarkovNode **start_states;
+    int num_start_states;
+    StateIndex *index;
+    int listen_fd;
+    // per worker: connection it is serving, -1 for none; guarded by
+    // clients_lock, so shutting down never hits a reused descriptor
+    int client_fds[MAX_WORKERS];
+    pthread_mutex_t clients_lock;
+    int stopping;
+} ServerState;
+
+/**
+ * One worker thread of the pool.
+ */
+typedef struct Worker {
+    pthread_t thread;
+    ServerState *server;
+    int id;
+} Worker;
+
+/**
+ * Load the chain from a chain file or train it from a text corpus, and
+ * index its states.
+ * @param path input file path
+ * @param index_ptr output, index of the chain's states
+ * @return the chain, NULL on error (already reported)
+ */
+static MarkovChain *load_server_chain(const char *path, StateIndex **index_ptr) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stdout, "%s\n", FILE_PATH_ERROR);
+        return NULL;
+    }
+
+    MarkovChain *markov_chain = create_tweets_chain();
+    if (markov_chain == NULL) {
+        fprintf(stderr, ALLOCATION_ERROR_MESSAGE);
+        fclose(fp);
+        return NULL;
+    }
+
+    // A chain file is matched against the index while loading, a corpus is
+    // indexed once trained
+    int result;
+    if (is_chain_file(fp)) {
+        *index_ptr = build_state_index(markov_chain, hash_string);
+        result = *index_ptr != NULL ? load_chain(markov_chain, *index_ptr, fp, read_string) : 1;
+    } else {
+        result = fill_database(fp, -1, markov_chain);
+        if (result == 0) {
+            *index_ptr = build_state_index(markov_chain, hash_string);
+            result = *index_ptr != NULL ? 0 : 1;
+        }
+    }
+    fclose(fp);
+    if (result != 0) {
+        fprintf(stdout, "Error: could not load %s\n", path);
+        free_state_index(index_ptr);
+        free_database(&markov_chain);
+        return NULL;
+    }
+    return markov_chain;
+}
+
+/**
+ * Write the sequences of a batch, one per line.
+ * @param batch generated batch
+ * @param out connection to write to
+ */
+static void write_batch(const SequenceBatch *batch, FILE *out) {
+    for (size_t i = 0; i < batch->num_sequences; i++) {
+        for (size_t j = batch->offsets[i]; j < batch->offsets[i + 1]; j++) {
+            if (j != batch->offsets[i]) {
+                fputc(' ', out);
+            }
+            fputs((char *)batch->states[j]->data, out);
+        }
+        fputc('\n', out);
+    }
+}
+
+/**
+ * Answer one request line.
+ * Request: <count> <max_length> <rng_seed> [first_word]
+ * Response: one generated sequence per line, then an empty line, or
+ * "ERROR <reason>" and an empty line.
+ * @param server shared server state
+ * @param request request line
+ * @param batch this worker's reusable batch
+ * @param out connection to answer on
+ */
+static void answer_request(const ServerState *server, const char *request,
+                           SequenceBatch *batch, FILE *out) {
+    long count, max_length;
+    unsigned long long seed;
+    char word[MAX_REQUEST_LENGTH];
+    int fields = sscanf(request, "%ld %ld %llu %1023s", &count, &max_length, &seed, word);
+    if (fields < 3 || count <= 0 || count > MAX_REQUEST_COUNT ||
+        max_length <= 0 || max_length > MAX_REQUEST_WORDS) {
+        fprintf(out, "ERROR invalid request\n\n");
+        return;
+    }
+
+    MarkovNode *const *start_states = server->start_states;
+    int num_start_states = server->num_start_states;
+    MarkovNode *first_node = NULL;
+    if (fields == 4) {
+        first_node = index_lookup(server->index, word);
+        if (first_node == NULL) {
+            fprintf(out, "ERROR unknown word\n\n");
+            return;
+        }
+        start_states = &first_node;
+        num_start_states = 1;
+    }
+
+    // The stream carries over from chunk to chunk, so the answer is the same
+    // as that of one batch of count sequences, without its memory
+    MarkovRandom random;
+    seed_random(&random, (uint64_t)seed);
+    long chunk_size = MAX_CHUNK_STATES / max_length;
+    for (long done = 0; done < count; done += chunk_size) {
+        long num_sequences = count - done < chunk_size ? count - done : chunk_size;
+        if (generate_sequence_batch_r(server->markov_chain, start_states, num_start_states,
+                                      (int)max_length, (size_t)num_sequences, batch,
+                                      &random) != 0) {
+            fprintf(out, "ERROR generation failed\n\n");
+            return;
+        }
+        write_batch(batch, out);
+    }
+    fputc('\n', out);
+}
+
+/**
+ * Serve one client connection until it closes, stays idle for too long or
+ * the server shuts it down.
+ * @param server shared server state
+ * @param fd connected socket, left open for the caller to close
+ * @param batch this worker's reusable batch
+ */
+static void serve_connection(const ServerState *server, int fd, SequenceBatch *batch) {
+    struct timeval timeout = {CLIENT_IDLE_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Both streams use copies of fd, so fd itself stays registered and open
+    // until the caller unregisters it
+    int in_fd = dup(fd);
+    int out_fd = dup(fd);
+    FILE *in = in_fd >= 0 ? fdopen(in_fd, "r") : NULL;
+    FILE *out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+    if (in == NULL || out == NULL) {
+        if (in != NULL) {
+            fclose(in);
+        } else if (in_fd >= 0) {
+            close(in_fd);
+        }
+        if (out != NULL) {
+            fclose(out);
+        } else if (out_fd >= 0) {
+            close(out_fd);
+        }
+        return;
+    }
+
+    char request[MAX_REQUEST_LENGTH];
+    while (fgets(request, MAX_REQUEST_LENGTH, in) != NULL) {
+        answer_request(server, request, batch, out);
+        if (fflush(out) != 0) {
+            break; // Client went away
+        }
+    }
+
+    fclose(in);
+    fclose(out);
+}
+
+/**
+ * Make fd the connection a worker is serving, unless the server is stopping.
+ * @param server shared server state
+ * @param id worker id
+ * @param fd connected socket, -1 to unregister
+ * @return 0 on success, 1 if the server is stopping
+ */
+static int register_client(ServerState *server, int id, int fd) {
+    pthread_mutex_lock(&server->clients_lock);
+    int stopping = server->stopping;
+    server->client_fds[id] = stopping && fd >= 0 ? -1 : fd;
+    pthread_mutex_unlock(&server->clients_lock);
+    return stopping && fd >= 0;
+}
+
+/**
+ * Stop accepting and end every connection being served: shutting a socket
+ * down wakes up the worker reading from it.
+ * @param server shared server state
+ */
+static void stop_server(ServerState *server) {
+    pthread_mutex_lock(&server->clients_lock);
+    server->stopping = 1;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        if (server->client_fds[i] >= 0) {
+            shutdown(server->client_fds[i], SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&server->clients_lock);
+    // Wakes up every worker blocked in accept()
+    shutdown(server->listen_fd, SHUT_RDWR);
+}
+
+/**
+ * Worker loop: accept connections until the server stops.
+ * @param arg the Worker
+ * @return NULL
+ */
+static void *worker_main(void *arg) {
+    Worker *worker = arg;
+    ServerState *server = worker->server;
+    SequenceBatch batch = {NULL, NULL, 0, 0, 0, 0};
+
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break; // Shut down
+        }
+        if (register_client(server, worker->id, fd) != 0) {
+            close(fd);
+            break;
+        }
+        serve_connection(server, fd, &batch);
+        register_client(server, worker->id, -1);
+        close(fd);
+    }
+
+    free_sequence_batch(&batch);
+    return NULL;
+}
+
+/**
+ * Create the listening Unix socket.
+ * @param path socket path, replaced if it exists
+ * @return listening socket, -1 on error (already reported)
+ */
+static int open_listen_socket(const char *path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stdout, "Error: socket path too long\n");
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, LISTEN_BACKLOG) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Load or train the chain once, then answer generation requests over a
+ * Unix socket with a pool of workers until SIGINT or SIGTERM.
+ * @param argc num of arguments
+ * @param argv 1) Socket path
+ *             2) Chain file or text corpus
+ *             3) Optional number of workers
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char *argv[]) {
+    if (argc != 3 && argc != 4) {
+        fprintf(stdout, "%s\n", NUM_ARGS_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    int num_workers = DEFAULT_NUM_WORKERS;
+    if (argc == 4) {
+        char *endptr;
+        num_workers = (int)strtol(argv[3], &endptr, 10);
+        if (*endptr != '\0' || num_workers <= 0 || num_workers > MAX_WORKERS) {
+            fprintf(stdout, "Error: Invalid number of workers.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    ServerState server = {0};
+    server.listen_fd = -1;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        server.client_fds[i] = -1;
+    }
+    pthread_mutex_init(&server.clients_lock, NULL);
+    server.markov_chain = load_server_chain(argv[2], &server.index);
+    if (server.markov_chain == NULL) {
+        return EXIT_FAILURE;
+    }
+    if (collect_start_states(server.markov_chain, &server.start_states,
+                             &server.num_start_states) != 0 ||
+        server.num_start_states == 0) {
+        fprintf(stdout, "Error: Could not get a random starting node.\n");
+        free(server.start_states);
+        free_state_index(&server.index);
+        free_database(&server.markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    server.listen_fd = open_listen_socket(argv[1]);
+    if (server.listen_fd < 0) {
+        free_state_index(&server.index);
+        free(server.start_states);
+        free_database(&server.markov_chain);
+        return EXIT_FAILURE;
+    }
+
+    // Workers inherit the blocked mask, only the main thread takes signals
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Worker workers[MAX_WORKERS];
+    int started = 0;
+    for (; started < num_workers; started++) {
+        workers[started].server = &server;
+        workers[started].id = started;
+        if (pthread_create(&workers[started].thread, NULL, worker_main,
+                           &workers[started]) != 0) {
+            break;
+        }
+    }
+
+    if (started > 0) {
+        int signal_number;
+        sigwait(&stop_signals, &signal_number);
+    } else {
+        fprintf(stdout, "Error: Could not start workers.\n");
+    }
+
+    stop_server(&server);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    close(server.listen_fd);
+    unlink(argv[1]);
+    pthread_mutex_destroy(&server.clients_lock);
+
+    free_state_index(&server.index);
+    free(server.start_states);
+    free_database(&server.markov_chain);
+    return started > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}